@@ -175,7 +175,7 @@ protected:
     void ApplyAlgorithm(Function3Parameters& f, bool Gray, int p1, int p2);
     void ApplyAlgorithm(Function4Parameters& f, bool Gray, int kernel_size, double p1, double p2);
     void ApplyAlgorithm(Function5Parameters& f, bool Gray, int kernel_size, int p1, int p2, int p3);
-    void ApplyAlgorithm(FunctionSobelParameters& f, bool Gray, int, int, int, double, int);
+    void ApplyAlgorithm(FunctionSobelParameters& f, bool Gray, double delta, int kernel_size);
     void ApplyAlgorithm(Function2Slider& f, bool Gray, double t);   
 
     template<typename F, typename...Args>
@@ -272,6 +272,9 @@ protected:
     FunctionSobelParameters
         getAlgoSobel(wxString key);
 
+    // shape (morphology::Shape) and size of the element of Erosion+ and Dilate+
+    bool chooseStructuringElement(int& shape, int& size);
+
     bool shouldQuit = false;
     bool DoFunctionBasedOnNameAlgo(wxString& _algorithm);
     bool DoFunctionBasedOnFunctor(wxString& _algorithm);
@@ -439,6 +442,25 @@ public:
     virtual void doProcess() override;
 };
 
+class CApplyStitching : public CLoadImageSetBase
+{
+public:
+    // at most max_images images in total: the 8 boxes of the base dialog and the ones added with "Add Images"
+    CApplyStitching(wxWindow* parent,
+        CWriteLogs* outxt,
+        wxWindowID id = wxID_ANY,
+        const wxString& title = wxEmptyString,
+        int inputs = 8,
+        int max_images = 64);
+
+    virtual void doProcess() override;
+
+private:
+    wxButton* m_buttonAddImages = nullptr;
+    std::vector<std::string> _more_files;
+    int max_images = 64;
+};
+
 class CMatchTemplate : public CLoadImageSetBase
 {
 public:
@@ -480,6 +502,26 @@ public:
     std::string getInfo() { return os.str(); };
 };
 
+/*
+*   Finds the shapes of a descriptors file (Hu moments) closest to the
+*   selected image
+*/
+class CSearchHuMomments : public CLoadImageSetBase
+{
+private:
+    std::stringstream os;
+public:
+    CSearchHuMomments(wxWindow* parent,
+        CWriteLogs* outxt,
+        wxWindowID id = wxID_ANY,
+        const wxString& title = wxEmptyString,
+        int inputs = 1);
+
+    virtual void doProcess() override;
+
+    std::string getInfo() { return os.str(); };
+};
+
 
 struct template_info
 {
@@ -520,6 +562,7 @@ public:
 };
 
 void ShowPCA(std::vector<std::vector<Point> >& contours);
+void ShowPCA(eigenSpace& _espace);
 
 
 
@@ -26,6 +26,11 @@ namespace image_constants
 		"Invert Image",
 		"Convert to Binary",
 		"Threshold",
+		"Adaptive Threshold (Sauvola)",
+		"Adaptive Threshold (Niblack)",
+		"Adaptive Threshold (Bradley)",
+		"Multi-level Otsu",
+		"Hysteresis Threshold",
 		"Adjust Contrast",
 		"Adjust Brightness",
 		"Gamma Correction",
@@ -39,10 +44,18 @@ namespace image_constants
 		"Segmentation Erode",
 		"Morpholgical Gradient",
 		"Morphological Top Hat",
+		"Morphological Black Hat",
+		"Opening by Reconstruction",
+		"Fill Holes",
+		"Regional Maxima",
+		"Granulometry",
 		"Apply custom algo",
 		"Gaussian Extended",
 		"Gaussian Difference",
 		"Median",
+		"Weighted Median",
+		"Bilateral Filter",
+		"Guided Filter",
 		"Laplacian Extended",
 		"Sobel",
 		"Canny Extended",
@@ -50,8 +63,11 @@ namespace image_constants
 		"Hough Transform Circles",
 		"Find Contourns ( Threshold )",
 		"Find Contourns ( Canny )",
+		"Connected Components",
+		"Filter Objects",
 		"Find Sift Descriptors",
 		"Show Sift Descriptors",
+		"Find Blobs (DoG)",
 		"Create PCA file",
 		"Apply Custom Kernel",
 		"Find Faces"
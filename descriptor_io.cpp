@@ -0,0 +1,910 @@
+#include "descriptor_io.h"
+#include "filesys.h"
+#include <charconv>
+#include <cstring>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+#ifdef _WIN32
+#include <wx/msw/wrapwin.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace descriptor_io
+{
+    bool seekFile(FILE* file, uint64_t offset)
+    {
+#ifdef _WIN32
+        return _fseeki64(file, static_cast<__int64>(offset), SEEK_SET) == 0;
+#else
+        return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+    }
+
+    uint64_t alignOffset(uint64_t offset)
+    {
+        return (offset + COLUMNAR_ALIGNMENT - 1) / COLUMNAR_ALIGNMENT * COLUMNAR_ALIGNMENT;
+    }
+
+    size_t getTypeSize(uint32_t type)
+    {
+        switch (type)
+        {
+        case COL_FLOAT32: return sizeof(float);
+        case COL_FLOAT64: return sizeof(double);
+        case COL_INT32: return sizeof(int32_t);
+        case COL_UINT8: return sizeof(uint8_t);
+        default: return 0;
+        }
+    }
+
+    bool isBinaryFile(const std::string& path)
+    {
+        std::string ext = getExtension(path);
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+        return ext == ".dvgc";
+    }
+
+    /*-------------------------------------------------------------------------------------------
+    *   CMappedFile
+    ---------------------------------------------------------------------------------------------*/
+    bool CMappedFile::open(const std::string& path)
+    {
+        close();
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                  OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+
+        LARGE_INTEGER size;
+        if (GetFileSizeEx(file, &size) == FALSE)
+        {
+            CloseHandle(file);
+            return false;
+        }
+
+        _file = file;
+        _size = static_cast<size_t>(size.QuadPart);
+        _opened = true;
+
+        if (_size == 0)
+        {
+            return true;
+        }
+
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping == nullptr)
+        {
+            close();
+            return false;
+        }
+        _mapping = mapping;
+
+        _data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        if (_data == nullptr)
+        {
+            close();
+            return false;
+        }
+#else
+        _fd = ::open(path.c_str(), O_RDONLY);
+        if (_fd < 0)
+        {
+            return false;
+        }
+
+        struct stat st;
+        if (fstat(_fd, &st) != 0)
+        {
+            close();
+            return false;
+        }
+
+        _size = static_cast<size_t>(st.st_size);
+        _opened = true;
+
+        if (_size == 0)
+        {
+            return true;
+        }
+
+        void* p = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+        if (p == MAP_FAILED)
+        {
+            close();
+            return false;
+        }
+        madvise(p, _size, MADV_SEQUENTIAL);
+        _data = static_cast<const char*>(p);
+#endif
+        return true;
+    }
+
+    void CMappedFile::close()
+    {
+#ifdef _WIN32
+        if (_data != nullptr)
+        {
+            UnmapViewOfFile(_data);
+        }
+        if (_mapping != nullptr)
+        {
+            CloseHandle(static_cast<HANDLE>(_mapping));
+        }
+        if (_file != nullptr)
+        {
+            CloseHandle(static_cast<HANDLE>(_file));
+        }
+        _mapping = nullptr;
+        _file = nullptr;
+#else
+        if (_data != nullptr)
+        {
+            munmap(const_cast<char*>(_data), _size);
+        }
+        if (_fd >= 0)
+        {
+            ::close(_fd);
+        }
+        _fd = -1;
+#endif
+        _data = nullptr;
+        _size = 0;
+        _opened = false;
+    }
+
+    /*-------------------------------------------------------------------------------------------
+    *   CColumnarWriter
+    ---------------------------------------------------------------------------------------------*/
+    bool CColumnarWriter::open(const std::string& path, uint64_t _rows, const std::vector<Field>& fields)
+    {
+        close();
+
+        file = fopen(path.c_str(), "wb");
+        if (file == nullptr)
+        {
+            return false;
+        }
+
+        rows = _rows;
+        columns.clear();
+
+        ColumnarHeader header{};
+        memcpy(header.magic, COLUMNAR_MAGIC, sizeof(header.magic));
+        header.version = COLUMNAR_VERSION;
+        header.rows = rows;
+        header.columns = static_cast<uint32_t>(fields.size());
+
+        uint64_t offset = alignOffset(sizeof(ColumnarHeader) + fields.size() * sizeof(ColumnInfo));
+        for (const auto& f : fields)
+        {
+            ColumnInfo info{};
+            strncpy(info.name, f.name.c_str(), sizeof(info.name) - 1);
+            info.type = f.type;
+            info.offset = offset;
+            columns.push_back(info);
+            offset = alignOffset(offset + rows * getTypeSize(f.type));
+        }
+
+        bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+        if (columns.empty() == false)
+        {
+            ok = ok && fwrite(columns.data(), sizeof(ColumnInfo), columns.size(), file) == columns.size();
+        }
+
+        // reserve the whole file so the columns can be written in any order
+        if (ok && offset > sizeof(ColumnarHeader))
+        {
+            char zero = 0;
+            ok = seekFile(file, offset - 1) && fwrite(&zero, 1, 1, file) == 1;
+        }
+
+        if (ok == false)
+        {
+            close();
+        }
+        return ok;
+    }
+
+    bool CColumnarWriter::write(int column, uint64_t first_row, const void* values, uint64_t count)
+    {
+        if (file == nullptr || column < 0 || column >= static_cast<int>(columns.size()) ||
+            first_row + count > rows)
+        {
+            return false;
+        }
+
+        if (count == 0)
+        {
+            return true;
+        }
+
+        const ColumnInfo& info = columns[column];
+        size_t size = getTypeSize(info.type);
+
+        if (seekFile(file, info.offset + first_row * size) == false)
+        {
+            return false;
+        }
+        return fwrite(values, size, static_cast<size_t>(count), file) == count;
+    }
+
+    bool CColumnarWriter::close()
+    {
+        bool ok = true;
+        if (file != nullptr)
+        {
+            ok = fclose(file) == 0;
+        }
+        file = nullptr;
+        return ok;
+    }
+
+    /*-------------------------------------------------------------------------------------------
+    *   CColumnarAppender
+    ---------------------------------------------------------------------------------------------*/
+    std::string CColumnarAppender::temporaryPath(size_t c) const
+    {
+        return _path + "." + std::to_string(c) + ".tmp";
+    }
+
+    void CColumnarAppender::removeTemporary()
+    {
+        for (size_t c = 0; c < temporary.size(); c++)
+        {
+            if (temporary[c] != nullptr)
+            {
+                fclose(temporary[c]);
+            }
+            std::remove(temporaryPath(c).c_str());
+        }
+        temporary.clear();
+    }
+
+    bool CColumnarAppender::open(const std::string& path, const std::vector<std::string>& names)
+    {
+        discard();
+
+        _path = path;
+        _names = names;
+        _rows = 0;
+        for (size_t c = 0; c < names.size(); c++)
+        {
+            temporary.push_back(fopen(temporaryPath(c).c_str(), "w+b"));
+            if (temporary.back() == nullptr)
+            {
+                discard();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool CColumnarAppender::append(const double* values, uint64_t count)
+    {
+        const size_t cols = temporary.size();
+        if (cols == 0)
+        {
+            return false;
+        }
+
+        column.resize(static_cast<size_t>(count));
+        for (size_t c = 0; c < cols; c++)
+        {
+            for (uint64_t r = 0; r < count; r++)
+            {
+                column[r] = values[r * cols + c];
+            }
+            if (fwrite(column.data(), sizeof(double), static_cast<size_t>(count), temporary[c]) != count)
+            {
+                return false;
+            }
+        }
+        _rows += count;
+        return true;
+    }
+
+    bool CColumnarAppender::close()
+    {
+        if (temporary.empty())
+        {
+            return false;
+        }
+
+        std::vector<Field> fields;
+        for (const auto& n : _names)
+        {
+            fields.push_back({ n, COL_FLOAT64 });
+        }
+
+        CColumnarWriter writer;
+        bool ok = writer.open(_path, _rows, fields);
+
+        // one chunk of each column at a time
+        const uint64_t chunk = 1 << 16;
+        column.resize(static_cast<size_t>(std::min(chunk, _rows)));
+        for (size_t c = 0; c < temporary.size() && ok; c++)
+        {
+            ok = seekFile(temporary[c], 0);
+            for (uint64_t r0 = 0; r0 < _rows && ok; r0 += chunk)
+            {
+                const uint64_t n = std::min(chunk, _rows - r0);
+                ok = fread(column.data(), sizeof(double), static_cast<size_t>(n), temporary[c]) == n &&
+                     writer.write(static_cast<int>(c), r0, column.data(), n);
+            }
+        }
+        ok = writer.close() && ok;
+
+        if (ok == false)
+        {
+            discard();
+            return false;
+        }
+
+        removeTemporary();
+        _path.clear();
+        column = std::vector<double>();
+        return true;
+    }
+
+    void CColumnarAppender::discard()
+    {
+        if (temporary.empty() == false)
+        {
+            removeTemporary();
+            std::remove(_path.c_str());
+        }
+        _path.clear();
+        _rows = 0;
+    }
+
+    /*-------------------------------------------------------------------------------------------
+    *   CColumnarReader
+    ---------------------------------------------------------------------------------------------*/
+    bool CColumnarReader::open(const std::string& path)
+    {
+        info = nullptr;
+
+        if (mapped.open(path) == false || mapped.size() < sizeof(ColumnarHeader))
+        {
+            return false;
+        }
+
+        memcpy(&header, mapped.data(), sizeof(header));
+        if (memcmp(header.magic, COLUMNAR_MAGIC, sizeof(header.magic)) != 0 ||
+            header.version != COLUMNAR_VERSION)
+        {
+            return false;
+        }
+
+        if (mapped.size() < sizeof(ColumnarHeader) + header.columns * sizeof(ColumnInfo))
+        {
+            return false;
+        }
+
+        const ColumnInfo* columns = reinterpret_cast<const ColumnInfo*>(mapped.data() + sizeof(ColumnarHeader));
+        for (uint32_t c = 0; c < header.columns; c++)
+        {
+            size_t size = getTypeSize(columns[c].type);
+            if (size == 0 || columns[c].offset + header.rows * size > mapped.size())
+            {
+                return false;
+            }
+        }
+
+        info = columns;
+        return true;
+    }
+
+    std::string CColumnarReader::columnName(int column) const
+    {
+        if (info == nullptr || column < 0 || column >= columns())
+        {
+            return "";
+        }
+        return std::string(info[column].name, strnlen(info[column].name, sizeof(info[column].name)));
+    }
+
+    uint32_t CColumnarReader::columnType(int column) const
+    {
+        if (info == nullptr || column < 0 || column >= columns())
+        {
+            return 0;
+        }
+        return info[column].type;
+    }
+
+    int CColumnarReader::findColumn(const std::string& name) const
+    {
+        for (int c = 0; c < columns(); c++)
+        {
+            if (columnName(c) == name)
+            {
+                return c;
+            }
+        }
+        return -1;
+    }
+
+    /*-------------------------------------------------------------------------------------------
+    *   Record writers
+    ---------------------------------------------------------------------------------------------*/
+    bool writeTable(    const std::string& path,
+                        const std::vector<std::string>& names,
+                        const double* values,
+                        uint64_t rows)
+    {
+        std::vector<Field> fields;
+        for (const auto& n : names)
+        {
+            fields.push_back({ n, COL_FLOAT64 });
+        }
+
+        CColumnarWriter writer;
+        if (writer.open(path, rows, fields) == false)
+        {
+            return false;
+        }
+
+        // transpose one chunk of each column at a time
+        const uint64_t chunk = 1 << 16;
+        const size_t cols = names.size();
+        std::vector<double> column(static_cast<size_t>(std::min(chunk, rows)));
+
+        for (size_t c = 0; c < cols; c++)
+        {
+            for (uint64_t r0 = 0; r0 < rows; r0 += chunk)
+            {
+                uint64_t n = std::min(chunk, rows - r0);
+                for (uint64_t r = 0; r < n; r++)
+                {
+                    column[r] = values[(r0 + r) * cols + c];
+                }
+                if (writer.write(static_cast<int>(c), r0, column.data(), n) == false)
+                {
+                    return false;
+                }
+            }
+        }
+
+        return writer.close();
+    }
+
+    bool writeKeypoints(    const std::vector<cv::KeyPoint>& keypoints,
+                            const Mat& descriptors,
+                            const std::string& path)
+    {
+        std::vector<Field> fields = {   { "x", COL_FLOAT32 },
+                                        { "y", COL_FLOAT32 },
+                                        { "size", COL_FLOAT32 },
+                                        { "angle", COL_FLOAT32 },
+                                        { "response", COL_FLOAT32 },
+                                        { "octave", COL_INT32 },
+                                        { "class_id", COL_INT32 } };
+
+        const size_t rows = keypoints.size();
+        bool has_descriptors = descriptors.empty() == false && static_cast<size_t>(descriptors.rows) == rows;
+
+        Mat desc;
+        if (has_descriptors)
+        {
+            descriptors.convertTo(desc, CV_32F);
+            for (int d = 0; d < desc.cols; d++)
+            {
+                fields.push_back({ "d" + std::to_string(d), COL_FLOAT32 });
+            }
+        }
+
+        CColumnarWriter writer;
+        if (writer.open(path, rows, fields) == false)
+        {
+            return false;
+        }
+
+        std::vector<float> fcol(rows);
+        std::vector<int32_t> icol(rows);
+        bool ok = true;
+
+        auto writeFloat = [&](int c, auto get)
+        {
+            for (size_t i = 0; i < rows; i++)
+            {
+                fcol[i] = get(keypoints[i]);
+            }
+            ok = ok && writer.write(c, 0, fcol.data(), rows);
+        };
+
+        writeFloat(0, [](const cv::KeyPoint& k) { return k.pt.x; });
+        writeFloat(1, [](const cv::KeyPoint& k) { return k.pt.y; });
+        writeFloat(2, [](const cv::KeyPoint& k) { return k.size; });
+        writeFloat(3, [](const cv::KeyPoint& k) { return k.angle; });
+        writeFloat(4, [](const cv::KeyPoint& k) { return k.response; });
+
+        for (size_t i = 0; i < rows; i++)
+        {
+            icol[i] = keypoints[i].octave;
+        }
+        ok = ok && writer.write(5, 0, icol.data(), rows);
+
+        for (size_t i = 0; i < rows; i++)
+        {
+            icol[i] = keypoints[i].class_id;
+        }
+        ok = ok && writer.write(6, 0, icol.data(), rows);
+
+        if (has_descriptors)
+        {
+            for (int d = 0; d < desc.cols; d++)
+            {
+                for (size_t i = 0; i < rows; i++)
+                {
+                    fcol[i] = desc.at<float>(static_cast<int>(i), d);
+                }
+                ok = ok && writer.write(7 + d, 0, fcol.data(), rows);
+            }
+        }
+
+        return writer.close() && ok;
+    }
+
+    bool writeHuMoments(const std::vector<double>& huh, const std::string& path)
+    {
+        std::vector<std::string> names = { "h1", "h2", "h3", "h4", "h5", "h6", "h7" };
+        return writeTable(path, names, huh.data(), huh.size() / 7);
+    }
+
+    bool writePCA(  const eigenSpace& _espace,
+                    const centers& _centers,
+                    const std::string& path)
+    {
+        std::vector<std::string> names = { "eg1x", "eg1y", "eg2x", "eg2y", "evalue1", "evalue2", "centerx", "centery" };
+
+        const eigenvectors& evectors = _espace.first;
+        const eigenvalues& evalues = _espace.second;
+
+        std::vector<double> values;
+        values.reserve(evectors.size() * names.size());
+        for (size_t i = 0; i < evectors.size(); i++)
+        {
+            values.push_back(evectors[i][0].x);
+            values.push_back(evectors[i][0].y);
+            values.push_back(evectors[i][1].x);
+            values.push_back(evectors[i][1].y);
+            values.push_back(evalues[i][0]);
+            values.push_back(evalues[i][1]);
+            values.push_back(_centers[i].first);
+            values.push_back(_centers[i].second);
+        }
+
+        return writeTable(path, names, values.data(), evectors.size());
+    }
+
+    /*-------------------------------------------------------------------------------------------
+    *   CCsvBuffer
+    ---------------------------------------------------------------------------------------------*/
+    CCsvBuffer::CCsvBuffer(size_t capacity)
+    {
+        buffer.resize(std::max(capacity, 2 * max_number));
+    }
+
+    bool CCsvBuffer::open(const std::string& path, bool append)
+    {
+        close();
+        used = 0;
+        file = fopen(path.c_str(), append ? "ab" : "wb");
+        return file != nullptr;
+    }
+
+    bool CCsvBuffer::flush()
+    {
+        if (file == nullptr || used == 0)
+        {
+            return true;
+        }
+        bool ok = fwrite(buffer.data(), 1, used, file) == used;
+        used = 0;
+        return ok;
+    }
+
+    bool CCsvBuffer::close()
+    {
+        bool ok = true;
+        if (file != nullptr)
+        {
+            ok = flush();
+            ok = fclose(file) == 0 && ok;
+        }
+        file = nullptr;
+        return ok;
+    }
+
+    void CCsvBuffer::reserve(size_t n)
+    {
+        if (used + n <= buffer.size())
+        {
+            return;
+        }
+
+        if (file != nullptr)
+        {
+            flush();
+        }
+
+        // no file behind the buffer (or a huge string): grow it
+        if (used + n > buffer.size())
+        {
+            buffer.resize(std::max(buffer.size() * 2, used + n));
+        }
+    }
+
+    CCsvBuffer& CCsvBuffer::add(double v)
+    {
+        reserve(max_number);
+        auto r = std::to_chars(buffer.data() + used, buffer.data() + buffer.size(), v);
+        used = r.ptr - buffer.data();
+        return *this;
+    }
+
+    CCsvBuffer& CCsvBuffer::add(float v)
+    {
+        reserve(max_number);
+        auto r = std::to_chars(buffer.data() + used, buffer.data() + buffer.size(), v);
+        used = r.ptr - buffer.data();
+        return *this;
+    }
+
+    CCsvBuffer& CCsvBuffer::add(int v)
+    {
+        reserve(max_number);
+        auto r = std::to_chars(buffer.data() + used, buffer.data() + buffer.size(), v);
+        used = r.ptr - buffer.data();
+        return *this;
+    }
+
+    CCsvBuffer& CCsvBuffer::add(const char* s)
+    {
+        size_t n = strlen(s);
+        reserve(n);
+        memcpy(buffer.data() + used, s, n);
+        used += n;
+        return *this;
+    }
+    /*-------------------------------------------------------------------------------------------
+    *   CCsvParser
+    ---------------------------------------------------------------------------------------------*/
+
+    // text parsed by one task of parse()
+    constexpr size_t csv_chunk_size = 1 << 20;
+
+    // largest field count accepted from the header of a kernel file
+    constexpr double max_fields = 1 << 16;
+
+    // end of the line that starts at p, without '\r'
+    const char* lineEnd(const char* p, const char* end, const char*& next)
+    {
+        const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (eol == nullptr)
+        {
+            eol = end;
+            next = end;
+        }
+        else
+        {
+            next = eol + 1;
+        }
+        if (eol > p && eol[-1] == '\r')
+        {
+            eol--;
+        }
+        return eol;
+    }
+
+    int countFields(const char* p, const char* eol)
+    {
+        if (p == eol)
+        {
+            return 0;
+        }
+        int n = 1 + static_cast<int>(std::count(p, eol, ','));
+        // the Hu moments lines end with a comma
+        if (eol[-1] == ',')
+        {
+            n--;
+        }
+        return n;
+    }
+
+    double parseField(const char*& p, const char* eol)
+    {
+        while (p < eol && (*p == ' ' || *p == '\t'))
+        {
+            p++;
+        }
+        if (p < eol && *p == '+')
+        {
+            p++;
+        }
+
+        double v = std::numeric_limits<double>::quiet_NaN();
+        auto r = std::from_chars(p, eol, v);
+        if (r.ec != std::errc())
+        {
+            v = std::numeric_limits<double>::quiet_NaN();
+        }
+
+        const char* comma = static_cast<const char*>(memchr(r.ptr, ',', eol - r.ptr));
+        p = (comma == nullptr) ? eol : comma + 1;
+        return v;
+    }
+
+    // a first line whose first field is not a number is a header (column names)
+    bool isHeader(const char* p, const char* eol)
+    {
+        while (p < eol && (*p == ' ' || *p == '\t' || *p == '+'))
+        {
+            p++;
+        }
+        if (p == eol || *p == ',')
+        {
+            return false;
+        }
+        double v = 0;
+        return std::from_chars(p, eol, v).ec != std::errc();
+    }
+
+    bool CCsvParser::open(const std::string& path, int nfields, bool ignoreheader)
+    {
+        if (!mapped.open(path))
+        {
+            return false;
+        }
+        return scan(mapped.data(), mapped.data() + mapped.size(), nfields, ignoreheader);
+    }
+
+    bool CCsvParser::openWithFieldsHeader(const std::string& path)
+    {
+        if (!mapped.open(path))
+        {
+            return false;
+        }
+
+        const char* begin = mapped.data();
+        const char* end = begin + mapped.size();
+        if (begin == end)
+        {
+            return false;
+        }
+
+        const char* next = nullptr;
+        const char* eol = lineEnd(begin, end, next);
+        const char* p = begin;
+        const double n = parseField(p, eol);
+        // NaN (a bad field) or a count out of range would not convert to int
+        if (!std::isfinite(n) || n < 1 || n > max_fields)
+        {
+            return false;
+        }
+        return scan(next, end, static_cast<int>(n), false);
+    }
+
+    bool CCsvParser::scan(const char* begin, const char* end, int nfields, bool ignoreheader)
+    {
+        chunks.clear();
+        _rows = 0;
+        _fields = nfields;
+
+        Chunk current{ nullptr, nullptr, 0 };
+        const char* p = begin;
+        bool first = true;
+        while (p < end)
+        {
+            const char* next = nullptr;
+            const char* eol = lineEnd(p, end, next);
+
+            if (p == eol)
+            {
+                break;
+            }
+
+            if (*p != '#')
+            {
+                if (ignoreheader || (first && isHeader(p, eol)))
+                {
+                    ignoreheader = false;
+                }
+                else
+                {
+                    if (_fields <= 0)
+                    {
+                        _fields = countFields(p, eol);
+                    }
+                    if (current.begin == nullptr)
+                    {
+                        current = Chunk{ p, nullptr, _rows };
+                    }
+                    _rows++;
+                }
+                first = false;
+            }
+
+            p = next;
+
+            if (current.begin != nullptr && static_cast<size_t>(p - current.begin) >= csv_chunk_size)
+            {
+                current.end = p;
+                chunks.push_back(current);
+                current.begin = nullptr;
+            }
+        }
+
+        if (current.begin != nullptr)
+        {
+            current.end = p;
+            chunks.push_back(current);
+        }
+
+        return _fields > 0 || _rows == 0;
+    }
+
+    void CCsvParser::parse(double* out) const
+    {
+        const int nfields = _fields;
+        cv::parallel_for_(cv::Range(0, static_cast<int>(chunks.size())), [&](const cv::Range& range)
+        {
+            for (int c = range.start; c < range.end; c++)
+            {
+                double* row = out + chunks[c].first_row * nfields;
+                const char* p = chunks[c].begin;
+                const char* end = chunks[c].end;
+                while (p < end)
+                {
+                    const char* next = nullptr;
+                    const char* eol = lineEnd(p, end, next);
+                    if (p == eol)
+                    {
+                        break;
+                    }
+                    if (*p != '#')
+                    {
+                        for (int f = 0; f < nfields; f++)
+                        {
+                            row[f] = (p < eol) ? parseField(p, eol) : std::numeric_limits<double>::quiet_NaN();
+                        }
+                        row += nfields;
+                    }
+                    p = next;
+                }
+            }
+        });
+    }
+
+    void CCsvParser::parse(std::vector<double>& out) const
+    {
+        out.resize(_rows * _fields);
+        parse(out.data());
+    }
+
+    int parseCSV(   const std::string& path,
+                    int nfields,
+                    bool ignoreheader,
+                    std::vector<double>& values,
+                    size_t& rows)
+    {
+        CCsvParser parser;
+        if (!parser.open(path, nfields, ignoreheader))
+        {
+            return -1;
+        }
+        parser.parse(values);
+        rows = parser.rows();
+        return 0;
+    }
+}
@@ -0,0 +1,320 @@
+//--------------------------------------------------------------------------------------------------
+// Fast writers and readers for descriptor files (keypoints, sift, Hu moments, PCA records)
+// Binary files are columnar and can be memory mapped, CSV files are formatted with std::to_chars
+// author: Daniel Vasconcelos Gomes 2023
+// if an external code has been used I indicate the sources
+//--------------------------------------------------------------------------------------------------
+#ifndef _DESCRIPTOR_IO_
+#define _DESCRIPTOR_IO_
+
+#include "pca.h"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace descriptor_io
+{
+	/*
+	*	Read only memory mapping of a whole file
+	*/
+	class CMappedFile final
+	{
+	public:
+
+		CMappedFile() = default;
+		~CMappedFile() { close(); };
+
+		bool open(const std::string& path);
+		void close();
+
+		const char* data() const { return _data; };
+		size_t size() const { return _size; };
+		bool isOpen() const { return _opened; };
+
+	private:
+		CMappedFile(CMappedFile&) = delete;
+		CMappedFile& operator=(CMappedFile&) = delete;
+
+		const char* _data = nullptr;
+		size_t _size = 0;
+		bool _opened = false;
+#ifdef _WIN32
+		void* _file = nullptr;
+		void* _mapping = nullptr;
+#else
+		int _fd = -1;
+#endif
+	};
+
+	/*
+	*	Binary columnar file:
+	*
+	*		ColumnarHeader
+	*		ColumnInfo[columns]
+	*		column 0 data (rows values), 64 bytes aligned
+	*		column 1 data ...
+	*
+	*	Every column is contiguous, so one field of millions of rows can be
+	*	used straight from the mapped file.
+	*/
+	enum ColumnType : uint32_t
+	{
+		COL_FLOAT32 = 1,
+		COL_FLOAT64 = 2,
+		COL_INT32 = 3,
+		COL_UINT8 = 4
+	};
+
+	constexpr char COLUMNAR_MAGIC[4] = { 'D', 'V', 'G', 'C' };
+	constexpr uint32_t COLUMNAR_VERSION = 1;
+	constexpr uint64_t COLUMNAR_ALIGNMENT = 64;
+
+	struct ColumnarHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint64_t rows;
+		uint32_t columns;
+		uint32_t reserved;
+	};
+
+	struct ColumnInfo
+	{
+		char name[32];
+		uint32_t type;
+		uint32_t reserved;
+		uint64_t offset;
+	};
+
+	struct Field
+	{
+		std::string name;
+		ColumnType type;
+	};
+
+	size_t getTypeSize(uint32_t type);
+
+	/*
+	*	Writes a columnar file whose number of rows is known up front.
+	*	Columns can be written in any order and in chunks.
+	*/
+	class CColumnarWriter final
+	{
+	public:
+
+		CColumnarWriter() = default;
+		~CColumnarWriter() { close(); };
+
+		bool open(const std::string& path, uint64_t rows, const std::vector<Field>& fields);
+		bool write(int column, uint64_t first_row, const void* values, uint64_t count);
+		bool close();
+
+	private:
+		CColumnarWriter(CColumnarWriter&) = delete;
+		CColumnarWriter& operator=(CColumnarWriter&) = delete;
+
+		FILE* file = nullptr;
+		uint64_t rows = 0;
+		std::vector<ColumnInfo> columns;
+	};
+
+	/*
+	*	Columnar file of double columns whose number of rows is not known up
+	*	front. Rows are appended in row major chunks and every column is
+	*	streamed to its own temporary file next to path; close() copies them
+	*	into the columnar file. Only the appended chunk is in memory.
+	*	discard() (or the destructor before close) removes everything.
+	*/
+	class CColumnarAppender final
+	{
+	public:
+
+		CColumnarAppender() = default;
+		~CColumnarAppender() { discard(); };
+
+		bool open(const std::string& path, const std::vector<std::string>& names);
+
+		// count rows of names.size() values each
+		bool append(const double* values, uint64_t count);
+		bool close();
+		void discard();
+
+		uint64_t rows() const { return _rows; };
+
+	private:
+		CColumnarAppender(CColumnarAppender&) = delete;
+		CColumnarAppender& operator=(CColumnarAppender&) = delete;
+
+		std::string temporaryPath(size_t column) const;
+		void removeTemporary();
+
+		std::string _path;
+		std::vector<std::string> _names;
+		std::vector<FILE*> temporary;
+		std::vector<double> column;
+		uint64_t _rows = 0;
+	};
+
+	/*
+	*	Memory maps a columnar file, no data is copied
+	*/
+	class CColumnarReader final
+	{
+	public:
+
+		CColumnarReader() = default;
+
+		bool open(const std::string& path);
+
+		uint64_t rows() const { return header.rows; };
+		int columns() const { return static_cast<int>(header.columns); };
+		std::string columnName(int column) const;
+		uint32_t columnType(int column) const;
+		int findColumn(const std::string& name) const;
+
+		template<typename T>
+		const T* column(int c) const
+		{
+			if (c < 0 || c >= columns() || getTypeSize(info[c].type) != sizeof(T))
+			{
+				return nullptr;
+			}
+			return reinterpret_cast<const T*>(mapped.data() + info[c].offset);
+		}
+
+	private:
+		CColumnarReader(CColumnarReader&) = delete;
+		CColumnarReader& operator=(CColumnarReader&) = delete;
+
+		CMappedFile mapped;
+		ColumnarHeader header{};
+		const ColumnInfo* info = nullptr;
+	};
+
+	/*
+	*	Writes a row major double table as a columnar file
+	*/
+	bool writeTable(	const std::string& path,
+						const std::vector<std::string>& names,
+						const double* values,
+						uint64_t rows);
+
+	bool writeKeypoints(	const std::vector<cv::KeyPoint>& keypoints,
+							const Mat& descriptors,
+							const std::string& path);
+
+	bool writeHuMoments(const std::vector<double>& huh, const std::string& path);
+
+	bool writePCA(	const eigenSpace& _espace,
+					const centers& _centers,
+					const std::string& path);
+
+	/*
+	*	Text buffer used by the CSV writers. Numbers are formatted with
+	*	std::to_chars into one preallocated buffer that is flushed to the
+	*	file when it fills up. Without a file it just keeps the text.
+	*/
+	class CCsvBuffer final
+	{
+	public:
+
+		explicit CCsvBuffer(size_t capacity = 1 << 20);
+		~CCsvBuffer() { close(); };
+
+		bool open(const std::string& path, bool append = false);
+		bool close();
+		bool flush();
+
+		CCsvBuffer& add(double v);
+		CCsvBuffer& add(float v);
+		CCsvBuffer& add(int v);
+		CCsvBuffer& add(const char* s);
+		CCsvBuffer& comma() { put(','); return *this; };
+		CCsvBuffer& newline() { put('\n'); return *this; };
+
+		std::string str() const { return std::string(buffer.data(), used); };
+
+	private:
+		CCsvBuffer(CCsvBuffer&) = delete;
+		CCsvBuffer& operator=(CCsvBuffer&) = delete;
+
+		// longest number that to_chars can produce for a double
+		static constexpr size_t max_number = 32;
+
+		void reserve(size_t n);
+		void put(char c) { reserve(1); buffer[used++] = c; };
+
+		std::vector<char> buffer;
+		size_t used = 0;
+		FILE* file = nullptr;
+	};
+
+	/*
+	*	CSV reader that parses the mapped file straight into a row major
+	*	double buffer, no strings or per line vectors are created.
+	*
+	*	open() scans the lines once: '#' lines are skipped, the first data
+	*	line is skipped when ignoreheader is set or when its first field is
+	*	not a number (a header of column names, as data::Load detected) and
+	*	reading stops at the first empty line (same rules of the old readers). Each row has
+	*	nfields values, missing or invalid ones are NaN. With nfields <= 0
+	*	the count is taken from the first data line. parse() then converts
+	*	the text in parallel chunks with std::from_chars in full precision.
+	*/
+	class CCsvParser final
+	{
+	public:
+
+		CCsvParser() = default;
+
+		bool open(const std::string& path, int nfields, bool ignoreheader);
+
+		/*
+		*	the first line is "n,..." and n is the number of fields,
+		*	this is the format of the kernel files
+		*/
+		bool openWithFieldsHeader(const std::string& path);
+
+		size_t rows() const { return _rows; };
+		int fields() const { return _fields; };
+
+		// out must hold rows() * fields() values
+		void parse(double* out) const;
+		void parse(std::vector<double>& out) const;
+
+	private:
+		CCsvParser(CCsvParser&) = delete;
+		CCsvParser& operator=(CCsvParser&) = delete;
+
+		struct Chunk
+		{
+			const char* begin;
+			const char* end;
+			size_t first_row;
+		};
+
+		bool scan(const char* begin, const char* end, int nfields, bool ignoreheader);
+
+		CMappedFile mapped;
+		std::vector<Chunk> chunks;
+		size_t _rows = 0;
+		int _fields = 0;
+	};
+
+	/*
+	*	Convenience wrapper: returns -1 when the file cannot be read
+	*/
+	int parseCSV(	const std::string& path,
+					int nfields,
+					bool ignoreheader,
+					std::vector<double>& values,
+					size_t& rows);
+
+	/*
+	*	true when the file name has the .dvgc extension of the columnar format
+	*/
+	bool isBinaryFile(const std::string& path);
+}
+
+#endif
@@ -0,0 +1,291 @@
+#include "descriptor_query.h"
+#include "preprocess_cache.h"
+#include <algorithm>
+#include <numeric>
+#include <limits>
+
+namespace descriptor_query
+{
+    double huDistanceI2(const double* h1, const double* h2)
+    {
+        double d = 0;
+        for (int i = 0; i < 7; i++)
+        {
+            if (std::isfinite(h1[i]) && std::isfinite(h2[i]))
+            {
+                d += std::abs(h1[i] - h2[i]);
+            }
+        }
+        return d;
+    }
+
+    /*-------------------------------------------------------------------------------------------
+    *   CCentroidGrid
+    ---------------------------------------------------------------------------------------------*/
+    void CCentroidGrid::build(const DescriptorTable& table, int cell_size)
+    {
+        start.clear();
+        items.clear();
+
+        const int n = static_cast<int>(table.size());
+        if (n == 0)
+        {
+            return;
+        }
+
+        const auto xs = std::minmax_element(table.centroid_x.begin(), table.centroid_x.end());
+        const auto ys = std::minmax_element(table.centroid_y.begin(), table.centroid_y.end());
+        x0 = *xs.first;
+        y0 = *ys.first;
+        const int width = *xs.second - x0 + 1;
+        const int height = *ys.second - y0 + 1;
+
+        if (cell_size <= 0)
+        {
+            // about 4 objects per cell
+            cell_size = static_cast<int>(2 * sqrt(static_cast<double>(width) * height / n));
+        }
+        cell = std::max(1, cell_size);
+        cols = (width + cell - 1) / cell;
+        rows = (height + cell - 1) / cell;
+
+        // counting sort of the objects by cell
+        start.assign(static_cast<size_t>(cols) * rows + 1, 0);
+        for (int i = 0; i < n; i++)
+        {
+            int c = (table.centroid_x[i] - x0) / cell + cols * ((table.centroid_y[i] - y0) / cell);
+            start[c + 1]++;
+        }
+        std::partial_sum(start.begin(), start.end(), start.begin());
+
+        items.resize(n);
+        std::vector<int> next(start.begin(), start.end() - 1);
+        for (int i = 0; i < n; i++)
+        {
+            int c = (table.centroid_x[i] - x0) / cell + cols * ((table.centroid_y[i] - y0) / cell);
+            items[next[c]++] = i;
+        }
+    }
+
+    template<typename F>
+    void CCentroidGrid::visit(const cv::Rect& r, F f) const
+    {
+        if (items.empty() || r.width <= 0 || r.height <= 0 ||
+            r.x + r.width - 1 < x0 || r.y + r.height - 1 < y0)
+        {
+            return;
+        }
+
+        int cx0 = std::max(0, (r.x - x0) / cell);
+        int cy0 = std::max(0, (r.y - y0) / cell);
+        int cx1 = std::min(cols - 1, (r.x + r.width - 1 - x0) / cell);
+        int cy1 = std::min(rows - 1, (r.y + r.height - 1 - y0) / cell);
+
+        for (int cy = cy0; cy <= cy1; cy++)
+        {
+            for (int cx = cx0; cx <= cx1; cx++)
+            {
+                const int c = cx + cols * cy;
+                for (int k = start[c]; k < start[c + 1]; k++)
+                {
+                    f(items[k]);
+                }
+            }
+        }
+    }
+
+    void CCentroidGrid::inRect(const DescriptorTable& table, const cv::Rect& r, std::vector<int>& found) const
+    {
+        found.clear();
+        visit(r, [&](int i)
+        {
+            if (r.contains(Point(table.centroid_x[i], table.centroid_y[i])))
+            {
+                found.push_back(i);
+            }
+        });
+    }
+
+    void CCentroidGrid::inRadius(const DescriptorTable& table, const Point2d& c, double radius, std::vector<int>& found) const
+    {
+        found.clear();
+        const int x = static_cast<int>(floor(c.x - radius));
+        const int y = static_cast<int>(floor(c.y - radius));
+        const int side = static_cast<int>(ceil(2 * radius)) + 2;
+        const double r2 = radius * radius;
+
+        visit(cv::Rect(x, y, side, side), [&](int i)
+        {
+            const double dx = table.centroid_x[i] - c.x;
+            const double dy = table.centroid_y[i] - c.y;
+            if (dx * dx + dy * dy <= r2)
+            {
+                found.push_back(i);
+            }
+        });
+    }
+
+    /*-------------------------------------------------------------------------------------------
+    *   CDescriptorQuery
+    ---------------------------------------------------------------------------------------------*/
+    CDescriptorQuery::CDescriptorQuery(const DescriptorTable& _table) :table(_table)
+    {
+        selected.resize(table.size());
+        std::iota(selected.begin(), selected.end(), 0);
+    }
+
+    const std::vector<double>& CDescriptorQuery::getColumn(Column c) const
+    {
+        switch (c)
+        {
+        case Column::Perimeter: return table.perimeter;
+        case Column::Roundness: return table.roundness;
+        case Column::Orientation: return table.orientation;
+        default: return table.area;
+        }
+    }
+
+    CDescriptorQuery& CDescriptorQuery::range(const std::vector<double>& column, double min, double max)
+    {
+        selected.erase(std::remove_if(selected.begin(), selected.end(), [&](int i)
+        {
+            return !(column[i] >= min && column[i] <= max);
+        }), selected.end());
+        return *this;
+    }
+
+    CDescriptorQuery& CDescriptorQuery::area(double min, double max)
+    {
+        return range(table.area, min, max);
+    }
+
+    CDescriptorQuery& CDescriptorQuery::perimeter(double min, double max)
+    {
+        return range(table.perimeter, min, max);
+    }
+
+    CDescriptorQuery& CDescriptorQuery::roundness(double min, double max)
+    {
+        return range(table.roundness, min, max);
+    }
+
+    CDescriptorQuery& CDescriptorQuery::orientation(double min, double max)
+    {
+        return range(table.orientation, min, max);
+    }
+
+    CDescriptorQuery& CDescriptorQuery::convex(bool is_convex)
+    {
+        const uint8_t flag = is_convex ? 1 : 0;
+        selected.erase(std::remove_if(selected.begin(), selected.end(), [&](int i)
+        {
+            return table.convex[i] != flag;
+        }), selected.end());
+        return *this;
+    }
+
+    CDescriptorQuery& CDescriptorQuery::huDistance(const double* huh, double max)
+    {
+        selected.erase(std::remove_if(selected.begin(), selected.end(), [&](int i)
+        {
+            return huDistanceI2(table.huMoments(i), huh) > max;
+        }), selected.end());
+        return *this;
+    }
+
+    CDescriptorQuery& CDescriptorQuery::keep()
+    {
+        // the mask is all 0 between calls, only the found objects are set and reset
+        if (mask.size() != table.size())
+        {
+            mask.assign(table.size(), 0);
+        }
+        for (int i : found)
+        {
+            mask[i] = 1;
+        }
+        selected.erase(std::remove_if(selected.begin(), selected.end(), [&](int i)
+        {
+            return mask[i] == 0;
+        }), selected.end());
+        for (int i : found)
+        {
+            mask[i] = 0;
+        }
+        return *this;
+    }
+
+    CDescriptorQuery& CDescriptorQuery::inRect(const cv::Rect& r)
+    {
+        if (grid.empty())
+        {
+            grid.build(table);
+        }
+        grid.inRect(table, r, found);
+        return keep();
+    }
+
+    CDescriptorQuery& CDescriptorQuery::inRadius(const Point2d& c, double radius)
+    {
+        if (grid.empty())
+        {
+            grid.build(table);
+        }
+        grid.inRadius(table, c, radius, found);
+        return keep();
+    }
+
+    CDescriptorQuery& CDescriptorQuery::sortBy(Column c, bool descending)
+    {
+        const std::vector<double>& column = getColumn(c);
+        std::stable_sort(selected.begin(), selected.end(), [&](int a, int b)
+        {
+            return descending ? column[a] > column[b] : column[a] < column[b];
+        });
+        return *this;
+    }
+
+    CDescriptorQuery& CDescriptorQuery::top(Column c, size_t k, bool descending)
+    {
+        const std::vector<double>& column = getColumn(c);
+        k = std::min(k, selected.size());
+        std::partial_sort(selected.begin(), selected.begin() + k, selected.end(), [&](int a, int b)
+        {
+            return descending ? column[a] > column[b] : column[a] < column[b];
+        });
+        selected.resize(k);
+        return *this;
+    }
+
+    Mat filterObjects(const Mat& img, double min_area, double max_area, double min_roundness)
+    {
+        if (img.empty())
+        {
+            return Mat();
+        }
+
+        const std::shared_ptr<const preprocess::ContourList> contours = preprocess::cache().otsuContours(img, RETR_LIST, CHAIN_APPROX_NONE);
+        DescriptorTable table;
+        image_info::fillDescriptorTable(*contours, table);
+
+        CDescriptorQuery query(table);
+        query.area(min_area, max_area).roundness(min_roundness, std::numeric_limits<double>::max());
+
+        Mat out;
+        if (img.channels() == 1)
+        {
+            cvtColor(img, out, COLOR_GRAY2BGR);
+        }
+        else
+        {
+            out = img.clone();
+        }
+
+        drawContours(out, *contours, -1, Scalar(80, 80, 80), 1);
+        for (int i : query.indices())
+        {
+            drawContours(out, *contours, i, Scalar(0, 255, 0), 2);
+        }
+        return out;
+    }
+}
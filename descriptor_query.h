@@ -0,0 +1,117 @@
+//--------------------------------------------------------------------------------------------------
+// Queries over a DescriptorTable: range predicates, Hu distance, sorting, top K and
+// rectangle / radius searches on the centroids backed by a uniform grid
+// author: Daniel Vasconcelos Gomes 2023
+// if an external code has been used I indicate the sources
+//--------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "image_interest_points.h"
+#include <vector>
+
+namespace descriptor_query
+{
+	enum class Column
+	{
+		Area,
+		Perimeter,
+		Roundness,
+		Orientation
+	};
+
+	/*
+	*	Uniform grid over the centroids of a table, stored as one array of
+	*	object indices sorted by cell plus the start of every cell (CSR).
+	*	cell_size <= 0 picks a size that gives a few objects per cell.
+	*/
+	class CCentroidGrid final
+	{
+	public:
+
+		CCentroidGrid() = default;
+
+		void build(const DescriptorTable& table, int cell_size = 0);
+		bool empty() const { return items.empty(); };
+
+		// found is cleared and filled, its memory is reused between queries
+		void inRect(const DescriptorTable& table, const cv::Rect& r, std::vector<int>& found) const;
+		void inRadius(const DescriptorTable& table, const Point2d& c, double radius, std::vector<int>& found) const;
+
+	private:
+
+		template<typename F>
+		void visit(const cv::Rect& r, F f) const;
+
+		int cell = 1;
+		int x0 = 0;
+		int y0 = 0;
+		int cols = 0;
+		int rows = 0;
+		std::vector<int> start;
+		std::vector<int> items;
+	};
+
+	/*
+	*	Selection of objects of a table. It starts with every object and each
+	*	call keeps only the ones that pass, scanning just the column involved:
+	*
+	*		CDescriptorQuery q(table);
+	*		q.area(100, 1e5).roundness(0.6, 1.0).top(Column::Area, 10);
+	*		for (int i : q.indices()) ...
+	*
+	*	The table must outlive the query.
+	*/
+	class CDescriptorQuery final
+	{
+	public:
+
+		explicit CDescriptorQuery(const DescriptorTable& table);
+
+		CDescriptorQuery& area(double min, double max);
+		CDescriptorQuery& perimeter(double min, double max);
+		CDescriptorQuery& roundness(double min, double max);
+		CDescriptorQuery& orientation(double min, double max);
+		CDescriptorQuery& convex(bool is_convex);
+
+		/*
+		*	L1 distance between the log scaled Hu moments, the same measure of
+		*	matchShapes with CONTOURS_MATCH_I2. Non finite moments are ignored.
+		*/
+		CDescriptorQuery& huDistance(const double* huh, double max);
+
+		CDescriptorQuery& inRect(const cv::Rect& r);
+		CDescriptorQuery& inRadius(const Point2d& c, double radius);
+
+		CDescriptorQuery& sortBy(Column c, bool descending = true);
+		CDescriptorQuery& top(Column c, size_t k, bool descending = true);
+
+		const std::vector<int>& indices() const { return selected; };
+		size_t size() const { return selected.size(); };
+
+	private:
+		CDescriptorQuery(CDescriptorQuery&) = delete;
+		CDescriptorQuery& operator=(CDescriptorQuery&) = delete;
+
+		CDescriptorQuery& range(const std::vector<double>& column, double min, double max);
+		// keeps the selected objects that are in found
+		CDescriptorQuery& keep();
+		const std::vector<double>& getColumn(Column c) const;
+
+		const DescriptorTable& table;
+		std::vector<int> selected;
+		CCentroidGrid grid;
+
+		// results of the grid and one flag per object, allocated once per query
+		std::vector<int> found;
+		std::vector<uint8_t> mask;
+	};
+
+	double huDistanceI2(const double* h1, const double* h2);
+
+	/*
+	*	The objects of the Otsu binary image (contours from the preprocessing
+	*	cache) with area in [min_area, max_area] and roundness >= min_roundness
+	*	drawn over a copy of img, the others in a dim color
+	*/
+	Mat filterObjects(const Mat& img, double min_area, double max_area, double min_roundness);
+}
@@ -0,0 +1,441 @@
+#include "edge_preserving.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace edge_preserving
+{
+    // cells added around the grid for the blur taps
+    constexpr int grid_pad = 2;
+
+    // [1 4 6 4 1] / 16, a Gaussian of about one cell
+    constexpr float grid_taps[5] = { 1.0f / 16, 4.0f / 16, 6.0f / 16, 4.0f / 16, 1.0f / 16 };
+
+    /*
+    *   Cells of [gy][gx][gz] holding the sums of the channels and the weight
+    */
+    struct Grid
+    {
+        int height;
+        int width;
+        int depth;
+        int values;     // channels + 1
+        std::vector<float> data;
+
+        size_t index(int gy, int gx, int gz) const
+        {
+            return ((static_cast<size_t>(gy) * width + gx) * depth + gz) * values;
+        }
+    };
+
+    /*
+    *   Blur of the lines of the grid along one axis, line i starts at
+    *   first(i) and has n cells stride floats apart. Cells outside are 0.
+    */
+    template<typename First>
+    void blurLines(Grid& grid, int lines, First first, int n, size_t stride)
+    {
+        const int values = grid.values;
+        cv::parallel_for_(cv::Range(0, lines), [&](const cv::Range& range)
+        {
+            std::vector<float> line(static_cast<size_t>(n + 4) * values);
+            for (int i = range.start; i < range.end; i++)
+            {
+                float* start = grid.data.data() + first(i);
+                std::fill(line.begin(), line.end(), 0.0f);
+                for (int k = 0; k < n; k++)
+                {
+                    std::copy(start + k * stride, start + k * stride + values, line.begin() + (k + 2) * values);
+                }
+                for (int k = 0; k < n; k++)
+                {
+                    float* out = start + k * stride;
+                    const float* in = line.data() + static_cast<size_t>(k) * values;
+                    for (int c = 0; c < values; c++)
+                    {
+                        out[c] =    grid_taps[0] * in[c] + grid_taps[1] * in[values + c] +
+                                    grid_taps[2] * in[2 * values + c] + grid_taps[3] * in[3 * values + c] +
+                                    grid_taps[4] * in[4 * values + c];
+                    }
+                }
+            }
+        });
+    }
+
+    /*
+    *   Gray version of a CV_32F image for the intensity axis and the guide
+    */
+    Mat grayOf(const Mat& img)
+    {
+        Mat gray;
+        if (img.channels() == 3)
+        {
+            cvtColor(img, gray, COLOR_BGR2GRAY);
+        }
+        else if (img.channels() == 4)
+        {
+            cvtColor(img, gray, COLOR_BGRA2GRAY);
+        }
+        else
+        {
+            extractChannel(img, gray, 0);
+        }
+        return gray;
+    }
+
+    /*
+    *   bilateralFilter for any depth and number of channels: 8U and 32F with
+    *   1 or 3 channels directly, the others through CV_32F. With 4 channels
+    *   the colour is filtered and the alpha kept, other counts channel by channel.
+    */
+    void exactBilateral(const Mat& src, Mat& dst, double sigma_space, double sigma_color)
+    {
+        const int cn = src.channels();
+        Mat out;
+        if ((src.depth() == CV_8U || src.depth() == CV_32F) && (cn == 1 || cn == 3))
+        {
+            bilateralFilter(src, out, -1, sigma_color, sigma_space);
+            dst = out;
+            return;
+        }
+
+        Mat values;
+        src.convertTo(values, CV_32F);
+        if (cn == 1 || cn == 3)
+        {
+            bilateralFilter(values, out, -1, sigma_color, sigma_space);
+        }
+        else
+        {
+            std::vector<Mat> planes;
+            split(values, planes);
+            if (cn == 4)
+            {
+                Mat bgr;
+                Mat filtered;
+                merge(planes.data(), 3, bgr);
+                bilateralFilter(bgr, filtered, -1, sigma_color, sigma_space);
+                std::vector<Mat> colour;
+                split(filtered, colour);
+                std::copy(colour.begin(), colour.end(), planes.begin());
+            }
+            else
+            {
+                for (auto& plane : planes)
+                {
+                    Mat filtered;
+                    bilateralFilter(plane, filtered, -1, sigma_color, sigma_space);
+                    plane = filtered;
+                }
+            }
+            merge(planes, out);
+        }
+        out.convertTo(dst, src.depth());
+    }
+
+    void bilateral(const Mat& src, Mat& dst, double sigma_space, double sigma_color)
+    {
+        if (src.empty() || sigma_space <= 0 || sigma_color <= 0)
+        {
+            src.copyTo(dst);
+            return;
+        }
+
+        const int cn = src.channels();
+        if (sigma_space < grid_min_sigma)
+        {
+            exactBilateral(src, dst, sigma_space, sigma_color);
+            return;
+        }
+
+        Mat values;
+        src.convertTo(values, CV_32F);
+        const Mat gray = (cn == 1) ? values : grayOf(values);
+
+        double lo = 0;
+        double hi = 0;
+        minMaxLoc(gray, &lo, &hi);
+
+        /*
+        *   A small sigma_color over a wide range of values gives more cells
+        *   than pixels (a 4K image with sigma_space 2 and sigma_color 1 would
+        *   take gigabytes): the grid saves nothing then, the exact filter is used.
+        */
+        const double height = std::floor((src.rows - 1) / sigma_space) + 1 + 2 * grid_pad;
+        const double width = std::floor((src.cols - 1) / sigma_space) + 1 + 2 * grid_pad;
+        const double depth = std::floor((hi - lo) / sigma_color) + 1 + 2 * grid_pad;
+        if (height * width * depth > static_cast<double>(src.total()) * grid_max_cells)
+        {
+            exactBilateral(src, dst, sigma_space, sigma_color);
+            return;
+        }
+
+        Grid grid;
+        grid.height = static_cast<int>(height);
+        grid.width = static_cast<int>(width);
+        grid.depth = static_cast<int>(depth);
+        grid.values = cn + 1;
+        grid.data.assign(static_cast<size_t>(grid.height) * grid.width * grid.depth * grid.values, 0.0f);
+
+        // splat: every pixel into its nearest cell, the rows of a grid row by one thread
+        std::vector<int> first_row(grid.height + 1, src.rows);
+        for (int y = src.rows - 1; y >= 0; y--)
+        {
+            first_row[cvRound(y / sigma_space) + grid_pad] = y;
+        }
+        for (int gy = grid.height - 1; gy > 0; gy--)
+        {
+            first_row[gy - 1] = std::min(first_row[gy - 1], first_row[gy]);
+        }
+
+        cv::parallel_for_(cv::Range(0, grid.height), [&](const cv::Range& range)
+        {
+            for (int gy = range.start; gy < range.end; gy++)
+            {
+                for (int y = first_row[gy]; y < first_row[gy + 1]; y++)
+                {
+                    const float* p = values.ptr<float>(y);
+                    const float* g = gray.ptr<float>(y);
+                    for (int x = 0; x < src.cols; x++)
+                    {
+                        const int gx = cvRound(x / sigma_space) + grid_pad;
+                        const int gz = cvRound((g[x] - lo) / sigma_color) + grid_pad;
+                        float* cell = grid.data.data() + grid.index(gy, gx, gz);
+                        for (int c = 0; c < cn; c++)
+                        {
+                            cell[c] += p[x * cn + c];
+                        }
+                        cell[cn] += 1.0f;
+                    }
+                }
+            }
+        });
+
+        // separable blur along z, x and y
+        const size_t z_stride = grid.values;
+        const size_t x_stride = static_cast<size_t>(grid.depth) * grid.values;
+        const size_t y_stride = static_cast<size_t>(grid.width) * x_stride;
+        blurLines(grid, grid.height * grid.width, [&](int i) { return i * x_stride; }, grid.depth, z_stride);
+        blurLines(grid, grid.height * grid.depth, [&](int i) { return (i / grid.depth) * y_stride + (i % grid.depth) * z_stride; }, grid.width, x_stride);
+        blurLines(grid, grid.width * grid.depth, [&](int i) { return (i / grid.depth) * x_stride + (i % grid.depth) * z_stride; }, grid.height, y_stride);
+
+        // slice: trilinear interpolation at every pixel, divided by the weight
+        Mat out(src.size(), CV_MAKETYPE(CV_32F, cn));
+        cv::parallel_for_(cv::Range(0, src.rows), [&](const cv::Range& range)
+        {
+            std::vector<float> acc(grid.values);
+            for (int y = range.start; y < range.end; y++)
+            {
+                const double fy = y / sigma_space + grid_pad;
+                const int y0 = std::min(cvFloor(fy), grid.height - 2);
+                const float wy = static_cast<float>(fy - y0);
+                const float* p = values.ptr<float>(y);
+                const float* g = gray.ptr<float>(y);
+                float* q = out.ptr<float>(y);
+
+                for (int x = 0; x < src.cols; x++)
+                {
+                    const double fx = x / sigma_space + grid_pad;
+                    const double fz = (g[x] - lo) / sigma_color + grid_pad;
+                    const int x0 = std::min(cvFloor(fx), grid.width - 2);
+                    const int z0 = std::min(cvFloor(fz), grid.depth - 2);
+                    const float wx = static_cast<float>(fx - x0);
+                    const float wz = static_cast<float>(fz - z0);
+
+                    std::fill(acc.begin(), acc.end(), 0.0f);
+                    for (int k = 0; k < 8; k++)
+                    {
+                        const int dy = k >> 2;
+                        const int dx = (k >> 1) & 1;
+                        const int dz = k & 1;
+                        const float w = (dy ? wy : 1 - wy) * (dx ? wx : 1 - wx) * (dz ? wz : 1 - wz);
+                        const float* cell = grid.data.data() + grid.index(y0 + dy, x0 + dx, z0 + dz);
+                        for (int c = 0; c < grid.values; c++)
+                        {
+                            acc[c] += w * cell[c];
+                        }
+                    }
+
+                    for (int c = 0; c < cn; c++)
+                    {
+                        q[x * cn + c] = (acc[cn] > 1e-6f) ? acc[c] / acc[cn] : p[x * cn + c];
+                    }
+                }
+            }
+        });
+
+        out.convertTo(dst, src.depth());
+    }
+
+    /*
+    *   Values of 8 and 16 bit images are mapped to [0, 1]
+    */
+    double unitScale(int depth)
+    {
+        switch (depth)
+        {
+        case CV_8U: return 1.0 / 255.0;
+        case CV_16U: return 1.0 / 65535.0;
+        default: return 1.0;
+        }
+    }
+
+    Mat boxMean(const Mat& img, int radius)
+    {
+        Mat mean;
+        boxFilter(img, mean, CV_32F, Size(2 * radius + 1, 2 * radius + 1), Point(-1, -1), true, BORDER_REFLECT);
+        return mean;
+    }
+
+    void guided(const Mat& src, const Mat& guide, Mat& dst, int radius, double eps, int subsample)
+    {
+        if (src.empty() || guide.size() != src.size() || radius < 1)
+        {
+            src.copyTo(dst);
+            return;
+        }
+
+        Mat I;
+        Mat p;
+        guide.convertTo(I, CV_32F, unitScale(guide.depth()));
+        src.convertTo(p, CV_32F, unitScale(src.depth()));
+        if (I.channels() != 1 && I.channels() != 3)
+        {
+            I = grayOf(I);
+        }
+
+        // the model is fitted on the small images and applied to the full guide
+        subsample = std::max(1, std::min(subsample, radius));
+        Mat I_small = I;
+        Mat p_small = p;
+        if (subsample > 1)
+        {
+            const Size small(std::max(1, src.cols / subsample), std::max(1, src.rows / subsample));
+            resize(I, I_small, small, 0, 0, INTER_AREA);
+            resize(p, p_small, small, 0, 0, INTER_AREA);
+        }
+        const int r = std::max(1, radius / subsample);
+        const float e = static_cast<float>(eps);
+
+        std::vector<Mat> guides;
+        split(I_small, guides);
+        std::vector<Mat> inputs;
+        split(p_small, inputs);
+
+        std::vector<Mat> mean_I(guides.size());
+        for (size_t k = 0; k < guides.size(); k++)
+        {
+            mean_I[k] = boxMean(guides[k], r);
+        }
+
+        // inverse of the covariance of the guide + eps, 6 values (symmetric) per pixel
+        std::vector<Mat> inverse;
+        if (guides.size() == 3)
+        {
+            Mat var[6];
+            const int pairs[6][2] = { { 0, 0 }, { 0, 1 }, { 0, 2 }, { 1, 1 }, { 1, 2 }, { 2, 2 } };
+            for (int k = 0; k < 6; k++)
+            {
+                const int i = pairs[k][0];
+                const int j = pairs[k][1];
+                var[k] = boxMean(guides[i].mul(guides[j]), r) - mean_I[i].mul(mean_I[j]);
+            }
+
+            inverse.assign(6, Mat());
+            for (Mat& m : inverse)
+            {
+                m.create(I_small.size(), CV_32F);
+            }
+            cv::parallel_for_(cv::Range(0, I_small.rows), [&](const cv::Range& range)
+            {
+                for (int y = range.start; y < range.end; y++)
+                {
+                    for (int x = 0; x < I_small.cols; x++)
+                    {
+                        const float a = var[0].at<float>(y, x) + e;
+                        const float b = var[1].at<float>(y, x);
+                        const float c = var[2].at<float>(y, x);
+                        const float d = var[3].at<float>(y, x) + e;
+                        const float f = var[4].at<float>(y, x);
+                        const float g = var[5].at<float>(y, x) + e;
+
+                        // adjugate over determinant
+                        const float i00 = d * g - f * f;
+                        const float i01 = c * f - b * g;
+                        const float i02 = b * f - c * d;
+                        const float det = a * i00 + b * i01 + c * i02;
+                        const float inv = (std::abs(det) > 1e-12f) ? 1.0f / det : 0.0f;
+                        inverse[0].at<float>(y, x) = i00 * inv;
+                        inverse[1].at<float>(y, x) = i01 * inv;
+                        inverse[2].at<float>(y, x) = i02 * inv;
+                        inverse[3].at<float>(y, x) = (a * g - c * c) * inv;
+                        inverse[4].at<float>(y, x) = (b * c - a * f) * inv;
+                        inverse[5].at<float>(y, x) = (a * d - b * b) * inv;
+                    }
+                }
+            });
+        }
+        else
+        {
+            const Mat var = boxMean(guides[0].mul(guides[0]), r) - mean_I[0].mul(mean_I[0]);
+            inverse.push_back(1.0 / (var + e));
+        }
+
+        std::vector<Mat> full_I;
+        split(I, full_I);
+        auto upscale = [&](const Mat& m)
+        {
+            Mat mean = boxMean(m, r);
+            if (subsample > 1)
+            {
+                Mat scaled;
+                resize(mean, scaled, src.size(), 0, 0, INTER_LINEAR);
+                return scaled;
+            }
+            return mean;
+        };
+
+        std::vector<Mat> outputs(inputs.size());
+        for (size_t ch = 0; ch < inputs.size(); ch++)
+        {
+            const Mat mean_p = boxMean(inputs[ch], r);
+
+            // a = inverse * cov(I, p), b = mean_p - a . mean_I
+            std::vector<Mat> cov(guides.size());
+            for (size_t k = 0; k < guides.size(); k++)
+            {
+                cov[k] = boxMean(guides[k].mul(inputs[ch]), r) - mean_I[k].mul(mean_p);
+            }
+
+            std::vector<Mat> a(guides.size());
+            if (guides.size() == 3)
+            {
+                a[0] = inverse[0].mul(cov[0]) + inverse[1].mul(cov[1]) + inverse[2].mul(cov[2]);
+                a[1] = inverse[1].mul(cov[0]) + inverse[3].mul(cov[1]) + inverse[4].mul(cov[2]);
+                a[2] = inverse[2].mul(cov[0]) + inverse[4].mul(cov[1]) + inverse[5].mul(cov[2]);
+            }
+            else
+            {
+                a[0] = cov[0].mul(inverse[0]);
+            }
+
+            Mat b = mean_p.clone();
+            for (size_t k = 0; k < guides.size(); k++)
+            {
+                b -= a[k].mul(mean_I[k]);
+            }
+
+            // q = mean(a) . I + mean(b), the means scaled back to the guide
+            Mat q = upscale(b);
+            for (size_t k = 0; k < guides.size(); k++)
+            {
+                q += upscale(a[k]).mul(full_I[k]);
+            }
+            outputs[ch] = q;
+        }
+
+        Mat out;
+        merge(outputs, out);
+        out.convertTo(dst, src.depth(), 1.0 / unitScale(src.depth()));
+    }
+}
@@ -0,0 +1,51 @@
+//--------------------------------------------------------------------------------------------------
+// Edge preserving smoothing with a cost per pixel that does not depend on the spatial radius:
+// bilateral filter on a bilateral grid and guided filter from box filters
+// S. Paris, F. Durand, "A fast approximation of the bilateral filter using a signal
+// processing approach", IJCV 81 (2009)
+// J. Chen, S. Paris, F. Durand, "Real-time edge-aware image processing with the bilateral
+// grid", ACM TOG 26 (2007)
+// K. He, J. Sun, X. Tang, "Guided image filtering", IEEE PAMI 35 (2013)
+// K. He, J. Sun, "Fast guided filter", arXiv:1505.00996 (2015)
+// author: Daniel Vasconcelos Gomes 2023
+// if an external code has been used I indicate the sources
+//--------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "image_util.h"
+
+namespace edge_preserving
+{
+	// below this spatial sigma the grid is not smaller than the image, bilateralFilter is used
+	constexpr double grid_min_sigma = 2.0;
+
+	// most cells of the grid per pixel of the image, above it bilateralFilter is used
+	constexpr double grid_max_cells = 1.0;
+
+	/*
+	*	Bilateral filter, sigma_space in pixels and sigma_color in the units
+	*	of the values (0..255 for 8 bit images), like bilateralFilter.
+	*	The pixels are accumulated (with a weight) in a 3D grid of cells of
+	*	sigma_space x sigma_space pixels by sigma_color of intensity, the grid
+	*	is smoothed by a Gaussian of one cell and read back with trilinear
+	*	interpolation at every pixel, so the cost per pixel is constant and
+	*	the grid is small for large sigmas. When the grid would have more
+	*	cells than grid_max_cells per pixel (small sigmas) bilateralFilter
+	*	is used instead, through CV_32F for the other depths.
+	*	Every channel is smoothed, with the intensity axis on the gray version
+	*	of the image (edges of luminance). dst may be src.
+	*/
+	void bilateral(const Mat& src, Mat& dst, double sigma_space, double sigma_color);
+
+	/*
+	*	Guided filter of src (any number of channels) with the edges of guide
+	*	(gray or BGR, same size), a local linear model of guide fitted in
+	*	windows of (2 radius + 1)^2 pixels by box filters. eps is the
+	*	regularization in squared intensity with 8 and 16 bit values mapped
+	*	to [0, 1] (0.01 ~ edges of 25 gray levels). A BGR guide uses its 3x3
+	*	covariance, so edges of colour are kept too.
+	*	subsample > 1 fits the model on images subsample times smaller and
+	*	scales the coefficients back (fast guided filter). dst may be src.
+	*/
+	void guided(const Mat& src, const Mat& guide, Mat& dst, int radius, double eps, int subsample = 1);
+}
@@ -1,4 +1,5 @@
 #include "filesys.h"
+#include <algorithm>
 namespace fs = std::filesystem;
 
 
@@ -98,3 +99,49 @@ bool create_dir(const std::string& _directory)
 {
 	return std::filesystem::create_directory(_directory);
 }
+
+std::vector<std::string> listFiles(  const std::string& _directory,
+                                     const std::vector<std::string>& extensions,
+                                     bool recursive)
+{
+	std::vector<std::string> files;
+
+	auto accept = [&](const fs::directory_entry& entry)
+	{
+		if (entry.is_regular_file() == false)
+		{
+			return;
+		}
+		std::string ext = entry.path().extension().string();
+		std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+		if (extensions.empty() || std::find(extensions.begin(), extensions.end(), ext) != extensions.end())
+		{
+			files.push_back(entry.path().string());
+		}
+	};
+
+	try
+	{
+		if (recursive)
+		{
+			for (const auto& entry : fs::recursive_directory_iterator(_directory))
+			{
+				accept(entry);
+			}
+		}
+		else
+		{
+			for (const auto& entry : fs::directory_iterator(_directory))
+			{
+				accept(entry);
+			}
+		}
+	}
+	catch (std::filesystem::filesystem_error&)
+	{
+		return files;
+	}
+
+	std::sort(files.begin(), files.end());
+	return files;
+}
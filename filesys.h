@@ -13,6 +13,7 @@
 #include <sstream>
 #include <chrono>
 #include <iomanip>
+#include <vector>
 #include "wx/filefn.h"
 #include <wx/stdpaths.h>
 
@@ -28,6 +29,14 @@ std::string getPathOfFile(const std::string& _file);
 std::string getOnlyNameNoExt(const std::string& _file);
 wxString getCurrentDir();
 
+/*
+*   Regular files of a directory whose extension (case insensitive, with the dot)
+*   is in extensions, sorted by name. An empty extensions list accepts any file.
+*/
+std::vector<std::string> listFiles(  const std::string& _directory,
+                                     const std::vector<std::string>& extensions,
+                                     bool recursive = false);
+
 std::string createFolderAtHomeUser(std::string folder_name);
 
 
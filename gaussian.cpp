@@ -0,0 +1,219 @@
+#include "gaussian.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace gaussian
+{
+    // columns (values) of the strips of the vertical recursion
+    constexpr int strip_width = 256;
+
+    /*
+    *   y[n] = x[n] + a1 y[n - 1] + a2 y[n - 2] + a3 y[n - 3], run forward and
+    *   backward, with gain B^2. M maps the last causal outputs to the first
+    *   anticausal ones for a signal that stays constant after its end.
+    */
+    struct Recursion
+    {
+        double B;
+        double a1;
+        double a2;
+        double a3;
+        double M[9];
+
+        explicit Recursion(double sigma)
+        {
+            const double m0 = 1.16680;
+            const double m1 = 1.10783;
+            const double m2 = 1.40586;
+            const double q = (sigma < 3.556) ?  -0.2568 + 0.5784 * sigma + 0.0561 * sigma * sigma :
+                                                2.5091 + 0.9804 * (sigma - 3.556);
+
+            const double scale = (m0 + q) * (m1 * m1 + m2 * m2 + 2 * m1 * q + q * q);
+            a1 = q * (2 * m0 * m1 + m1 * m1 + m2 * m2 + (2 * m0 + 4 * m1) * q + 3 * q * q) / scale;
+            a2 = -q * q * (m0 + 2 * m1 + 3 * q) / scale;
+            a3 = q * q * q / scale;
+            B = m0 * (m1 * m1 + m2 * m2) / scale;
+
+            const double s = 1.0 / ((1 + a1 - a2 + a3) * (1 - a1 - a2 - a3) * (1 + a2 + (a1 - a3) * a3));
+            M[0] = s * (-a3 * a1 + 1 - a3 * a3 - a2);
+            M[1] = s * (a3 + a1) * (a2 + a3 * a1);
+            M[2] = s * a3 * (a1 + a3 * a2);
+            M[3] = s * (a1 + a3 * a2);
+            M[4] = -s * (a2 - 1) * (a2 + a3 * a1);
+            M[5] = -s * a3 * (a3 * a1 + a3 * a3 + a2 - 1);
+            M[6] = s * (a3 * a1 + a2 + a1 * a1 - a2 * a2);
+            M[7] = s * (a1 * a2 + a3 * a2 * a2 - a1 * a3 * a3 - a3 * a3 * a3 - a3 * a2 + a3);
+            M[8] = s * a3 * (a1 + a3 * a2);
+        }
+    };
+
+    /*
+    *   The recursion over n samples of width values each (one sample is a
+    *   row of a strip, or one value of a line), sample(i) points to sample i.
+    *   The state of every value is kept in double.
+    */
+    template<typename Sample>
+    void recursiveLine(Sample sample, int n, int width, const Recursion& r, std::vector<double>& state)
+    {
+        state.resize(static_cast<size_t>(width) * 5);
+        double* last = state.data();            // input at the end
+        double* w1 = last + width;
+        double* w2 = w1 + width;
+        double* w3 = w2 + width;
+        double* y = w3 + width;
+
+        const double B2 = r.B * r.B;
+        const double gain = 1.0 - r.a1 - r.a2 - r.a3;
+
+        // causal, the signal before the start repeats the first sample
+        const float* first = sample(0);
+        std::copy(sample(n - 1), sample(n - 1) + width, last);
+        for (int c = 0; c < width; c++)
+        {
+            w1[c] = w2[c] = w3[c] = first[c] / gain;
+        }
+        for (int i = 0; i < n; i++)
+        {
+            float* p = sample(i);
+            for (int c = 0; c < width; c++)
+            {
+                const double v = p[c] + r.a1 * w1[c] + r.a2 * w2[c] + r.a3 * w3[c];
+                w3[c] = w2[c];
+                w2[c] = w1[c];
+                w1[c] = v;
+                p[c] = static_cast<float>(v);
+            }
+        }
+
+        // anticausal, Triggs-Sdika values for the end, w1..w3 are the last causal outputs
+        double* y1 = w1;
+        double* y2 = w2;
+        double* y3 = w3;
+        for (int c = 0; c < width; c++)
+        {
+            const double uplus = last[c] / gain;
+            const double vplus = uplus / gain;
+            const double u0 = w1[c] - uplus;
+            const double u1 = w2[c] - uplus;
+            const double u2 = w3[c] - uplus;
+            y[c] = (r.M[0] * u0 + r.M[1] * u1 + r.M[2] * u2 + vplus) * B2;
+            const double next1 = (r.M[3] * u0 + r.M[4] * u1 + r.M[5] * u2 + vplus) * B2;
+            const double next2 = (r.M[6] * u0 + r.M[7] * u1 + r.M[8] * u2 + vplus) * B2;
+            y1[c] = y[c];
+            y2[c] = next1;
+            y3[c] = next2;
+        }
+
+        float* end = sample(n - 1);
+        for (int c = 0; c < width; c++)
+        {
+            end[c] = static_cast<float>(y[c]);
+        }
+        for (int i = n - 2; i >= 0; i--)
+        {
+            float* p = sample(i);
+            for (int c = 0; c < width; c++)
+            {
+                const double v = B2 * p[c] + r.a1 * y1[c] + r.a2 * y2[c] + r.a3 * y3[c];
+                y3[c] = y2[c];
+                y2[c] = y1[c];
+                y1[c] = v;
+                p[c] = static_cast<float>(v);
+            }
+        }
+    }
+
+    void recursiveFilter(Mat& img, double sigma, int axis)
+    {
+        const Recursion r(sigma);
+        const int cn = img.channels();
+        const int values = img.cols * cn;
+
+        if (axis == 0)
+        {
+            cv::parallel_for_(cv::Range(0, img.rows), [&](const cv::Range& range)
+            {
+                std::vector<double> state;
+                for (int y = range.start; y < range.end; y++)
+                {
+                    float* row = img.ptr<float>(y);
+                    // the channels of a pixel are filtered together
+                    recursiveLine(  [&](int i) { return row + static_cast<size_t>(i) * cn; },
+                                    img.cols, cn, r, state);
+                }
+            });
+            return;
+        }
+
+        const int strips = (values + strip_width - 1) / strip_width;
+        cv::parallel_for_(cv::Range(0, strips), [&](const cv::Range& range)
+        {
+            std::vector<double> state;
+            for (int strip = range.start; strip < range.end; strip++)
+            {
+                const int c0 = strip * strip_width;
+                const int width = std::min(strip_width, values - c0);
+                // the rows of the strip are the samples
+                recursiveLine(  [&](int i) { return img.ptr<float>(i) + c0; },
+                                img.rows, width, r, state);
+            }
+        });
+    }
+
+    int kernelSize(double sigma, int depth)
+    {
+        const double taps = (depth == CV_8U) ? 3 : 4;
+        return cvRound(sigma * taps * 2 + 1) | 1;
+    }
+
+    void blur(const Mat& src, Mat& dst, double sigmaX, double sigmaY, int kernel_size)
+    {
+        if (sigmaY <= 0)
+        {
+            sigmaY = sigmaX;
+        }
+
+        if (src.empty() || kernel_size > 0 || sigmaX <= 0 ||
+            std::max(sigmaX, sigmaY) < recursive_min_sigma)
+        {
+            const Size size = (kernel_size > 0) ? Size(kernel_size, kernel_size) : Size(0, 0);
+            if (sigmaX <= 0 && kernel_size <= 0)
+            {
+                // nothing to smooth with
+                src.copyTo(dst);
+                return;
+            }
+            GaussianBlur(src, dst, size, sigmaX, sigmaY);
+            return;
+        }
+
+        Mat work;
+        src.convertTo(work, CV_32F);
+
+        const double sigmas[] = { sigmaX, sigmaY };
+        for (int axis = 0; axis < 2; axis++)
+        {
+            const double sigma = sigmas[axis];
+            if (sigma >= recursive_min_sigma)
+            {
+                recursiveFilter(work, sigma, axis);
+            }
+            else
+            {
+                const Mat kernel = getGaussianKernel(kernelSize(sigma, src.depth()), sigma, CV_32F);
+                const Mat one = Mat::ones(1, 1, CV_32F);
+                sepFilter2D(work,
+                            work,
+                            CV_32F,
+                            (axis == 0) ? kernel : one,
+                            (axis == 0) ? one : kernel,
+                            Point(-1, -1),
+                            0,
+                            BORDER_REPLICATE);
+            }
+        }
+
+        work.convertTo(dst, src.depth());
+    }
+}
@@ -0,0 +1,45 @@
+//--------------------------------------------------------------------------------------------------
+// Gaussian smoothing with the kernel size taken from sigma, and a recursive (IIR) filter
+// for the large sigmas with a cost per pixel that does not depend on sigma
+// I.T. Young, L.J. van Vliet, M. van Ginkel, "Recursive Gabor filtering",
+// IEEE Trans. Signal Processing 50 (2002)
+// B. Triggs, M. Sdika, "Boundary conditions for Young-van Vliet recursive filtering",
+// IEEE Trans. Signal Processing 54 (2006)
+// author: Daniel Vasconcelos Gomes 2023
+// if an external code has been used I indicate the sources
+//--------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "image_util.h"
+
+namespace gaussian
+{
+	/*
+	*	From this sigma on the recursive filter is used, below it
+	*	GaussianBlur (the FIR kernel has about 6 sigma taps)
+	*/
+	constexpr double recursive_min_sigma = 5.0;
+
+	/*
+	*	Odd kernel size that keeps +-3 sigma (+-4 sigma for float images),
+	*	the rule of GaussianBlur when the size is 0
+	*/
+	int kernelSize(double sigma, int depth = CV_8U);
+
+	/*
+	*	Gaussian smoothing of src. sigmaY = 0 means sigmaY = sigmaX.
+	*	kernel_size > 0 forces a FIR kernel of that size (the sigmas that are
+	*	0 are taken from it), otherwise every axis with a sigma of at least
+	*	recursive_min_sigma is filtered with the third order Young-van Vliet
+	*	recursion, forward and backward, with the Triggs-Sdika initial values
+	*	for a replicated border, and the others with a FIR kernel of size
+	*	kernelSize(sigma).
+	*/
+	void blur(const Mat& src, Mat& dst, double sigmaX, double sigmaY = 0, int kernel_size = 0);
+
+	/*
+	*	Recursive filter of the rows (axis 0) or the columns (axis 1) of a
+	*	CV_32F image, in place
+	*/
+	void recursiveFilter(Mat& img, double sigma, int axis);
+}
@@ -0,0 +1,161 @@
+#include "gradient.h"
+#include "preprocess_cache.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace gradient
+{
+    // rows of a band of the parallel pass
+    constexpr int min_band = 64;
+
+    Mat stretch8(const Mat& gray)
+    {
+        if (gray.depth() == CV_8U)
+        {
+            return gray;
+        }
+        Mat stretched;
+        normalize(gray, stretched, 0, 255, NORM_MINMAX, CV_8U);
+        return stretched;
+    }
+
+    // the gradient of an 8 bit gray image
+    void computeGray(const Mat& gray, Gradient& g, Norm norm, int bins, bool full)
+    {
+        const int rows = gray.rows;
+        const int cols = gray.cols;
+        bins = std::max(0, std::min(255, bins));
+        const float range = full ? 360.0f : 180.0f;
+
+        g.dx.create(gray.size(), CV_16S);
+        g.dy.create(gray.size(), CV_16S);
+        g.magnitude.create(gray.size(), CV_16U);
+        if (bins > 0)
+        {
+            g.orientation.create(gray.size(), CV_8U);
+        }
+        else
+        {
+            g.orientation = Mat();
+        }
+
+        const int bands = std::max(1, std::min(cv::getNumThreads(), rows / min_band));
+        cv::parallel_for_(cv::Range(0, bands), [&](const cv::Range& range_bands)
+        {
+            // vertical sums [1 2 1] and [-1 0 1] of the columns, one replicated column on each side
+            std::vector<short> smooth(cols + 2);
+            std::vector<short> diff(cols + 2);
+            short* v = smooth.data();
+            short* d = diff.data();
+
+            for (int band = range_bands.start; band < range_bands.end; band++)
+            {
+                const int y0 = static_cast<int>(static_cast<int64_t>(rows) * band / bands);
+                const int y1 = static_cast<int>(static_cast<int64_t>(rows) * (band + 1) / bands);
+                for (int y = y0; y < y1; y++)
+                {
+                    const uchar* above = gray.ptr<uchar>(std::max(0, y - 1));
+                    const uchar* center = gray.ptr<uchar>(y);
+                    const uchar* below = gray.ptr<uchar>(std::min(rows - 1, y + 1));
+                    for (int x = 0; x < cols; x++)
+                    {
+                        v[x + 1] = static_cast<short>(above[x] + 2 * center[x] + below[x]);
+                        d[x + 1] = static_cast<short>(below[x] - above[x]);
+                    }
+                    v[0] = v[1];
+                    d[0] = d[1];
+                    v[cols + 1] = v[cols];
+                    d[cols + 1] = d[cols];
+
+                    short* gx = g.dx.ptr<short>(y);
+                    short* gy = g.dy.ptr<short>(y);
+                    ushort* m = g.magnitude.ptr<ushort>(y);
+                    for (int x = 0; x < cols; x++)
+                    {
+                        gx[x] = static_cast<short>(v[x + 2] - v[x]);
+                        gy[x] = static_cast<short>(d[x] + 2 * d[x + 1] + d[x + 2]);
+                    }
+
+                    if (norm == Norm::L1)
+                    {
+                        for (int x = 0; x < cols; x++)
+                        {
+                            m[x] = static_cast<ushort>(std::abs(gx[x]) + std::abs(gy[x]));
+                        }
+                    }
+                    else
+                    {
+                        for (int x = 0; x < cols; x++)
+                        {
+                            const int sq = gx[x] * gx[x] + gy[x] * gy[x];
+                            m[x] = static_cast<ushort>(std::sqrt(static_cast<float>(sq)) + 0.5f);
+                        }
+                    }
+
+                    if (bins > 0)
+                    {
+                        uchar* o = g.orientation.ptr<uchar>(y);
+                        for (int x = 0; x < cols; x++)
+                        {
+                            float angle = fastAtan2(gy[x], gx[x]);
+                            if (angle >= range)
+                            {
+                                angle -= range;
+                            }
+                            o[x] = static_cast<uchar>(std::min(bins - 1, static_cast<int>(angle * bins / range)));
+                        }
+                    }
+                }
+            }
+        });
+    }
+
+    void compute(const Mat& img, Gradient& g, Norm norm, int bins, bool full)
+    {
+        if (img.empty())
+        {
+            g = Gradient();
+            return;
+        }
+        computeGray(stretch8(preprocess::cache().gray(img)), g, norm, bins, full);
+    }
+
+    std::shared_ptr<const Gradient> get(const Mat& img, Norm norm, int bins, bool full)
+    {
+        return get(img, preprocess::CPreprocessCache::getSourceKey(img), norm, bins, full);
+    }
+
+    std::shared_ptr<const Gradient> get(const Mat& img, const preprocess::CPreprocessCache::SourceKey& key, Norm norm, int bins, bool full)
+    {
+        const std::string operation =   "gradient:" + std::to_string(static_cast<int>(norm)) +
+                                        ":" + std::to_string(bins) +
+                                        ":" + std::to_string(full);
+        // dx, dy, magnitude and orientation
+        const size_t bytes = img.total() * (3 * sizeof(short) + ((bins > 0) ? 1 : 0));
+        return preprocess::cache().object<Gradient>(img, key, operation, bytes, [&](const Mat& src)
+        {
+            std::shared_ptr<Gradient> g = std::make_shared<Gradient>();
+            if (src.empty() == false)
+            {
+                // the gray image under the same key, not hashed again
+                computeGray(stretch8(preprocess::cache().gray(src, key)), *g, norm, bins, full);
+            }
+            return g;
+        });
+    }
+
+    void canny(const Mat& img, Mat& edges, double low, double high, bool l2)
+    {
+        if (img.empty())
+        {
+            edges = Mat();
+            return;
+        }
+        // only the derivatives are used, the L1 entry is the one Sobel shares
+        const std::shared_ptr<const Gradient> g = get(img);
+        Canny(g->dx, g->dy, edges, low, high, l2);
+    }
+}
@@ -0,0 +1,63 @@
+//--------------------------------------------------------------------------------------------------
+// Sobel gradient in one pass: 16 bit derivatives, magnitude and quantized orientation written
+// together by bands of rows in parallel, shared by Sobel, Canny and the Hough transforms through the
+// preprocessing cache
+// I. Sobel, G. Feldman, "A 3x3 isotropic gradient operator for image processing" (1968)
+// author: Daniel Vasconcelos Gomes 2023
+// if an external code has been used I indicate the sources
+//--------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "image_util.h"
+#include "preprocess_cache.h"
+#include <memory>
+
+namespace gradient
+{
+	enum class Norm
+	{
+		L1,		// |gx| + |gy|
+		L2		// sqrt(gx^2 + gy^2), rounded
+	};
+
+	/*
+	*	dx, dy: CV_16S, the 3x3 Sobel derivatives of Sobel(gray, CV_16S, ...)
+	*	with BORDER_REPLICATE, as Canny computes them
+	*	magnitude: CV_16U (at most 1020 for L1, 1443 for L2)
+	*	orientation: CV_8U, bin of the angle of (gx, gy), bin b holds the
+	*	angles [b, b + 1) x 180 / bins (360 / bins when full), empty if bins = 0
+	*/
+	struct Gradient
+	{
+		Mat dx;
+		Mat dy;
+		Mat magnitude;
+		Mat orientation;
+	};
+
+	/*
+	*	Gradient of the 8 bit gray version of img (from the preprocessing
+	*	cache, other depths are stretched to 0..255). Every row is read once:
+	*	the vertical sums of the two kernels are kept in two rows of shorts
+	*	and the horizontal ones give gx, gy, the magnitude and the bin
+	*	directly, in plain loops the compiler vectorizes.
+	*/
+	void compute(const Mat& img, Gradient& g, Norm norm = Norm::L1, int bins = 0, bool full = false);
+
+	/*
+	*	The gradient of img shared through the cache: Sobel (aperture 3),
+	*	Canny and the Canny edges of the Hough transforms on the same image
+	*	compute it once
+	*/
+	std::shared_ptr<const Gradient> get(const Mat& img, Norm norm = Norm::L1, int bins = 0, bool full = false);
+
+	// the same with the cache key of img, for callers that already hashed it
+	std::shared_ptr<const Gradient> get(const Mat& img, const preprocess::CPreprocessCache::SourceKey& key,
+										Norm norm = Norm::L1, int bins = 0, bool full = false);
+
+	/*
+	*	Canny of the gray image from the shared derivatives, the same edges
+	*	as Canny(gray, edges, low, high) with aperture 3
+	*/
+	void canny(const Mat& img, Mat& edges, double low, double high, bool l2 = false);
+}
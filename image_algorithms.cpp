@@ -3,10 +3,17 @@
 #include <chrono>
 #include <ctime>
 #include <wx/textdlg.h>
+#include <wx/progdlg.h>
 #include "wx/msgdlg.h"
 #include "image_interest_points.h"
 #include "filesys.h"
 #include "pca.h"
+#include "descriptor_io.h"
+#include "image_components.h"
+#include "morphology.h"
+#include "median.h"
+#include "thresholding.h"
+#include "descriptor_query.h"
 #include <fstream>
 #include <CvPlot/cvplot.h>
 #include <matplot/matplot.h>
@@ -157,14 +164,11 @@ void
 CInputDialog::ApplyAlgorithm(
                                 FunctionSobelParameters& f,
                                 bool Gray,
-                                int image_type,
-                                int depth,
-                                int type,
                                 double delta,
                                 int kernel_size
                             )
 {
-    return ApplyAlgorithmEffective(f, Gray, image_type, depth, type, delta, kernel_size);
+    return ApplyAlgorithmEffective(f, Gray, delta, kernel_size);
 }
 
 void CInputDialog::setSimpleMaps()
@@ -186,23 +190,37 @@ void CInputDialog::setSimpleMaps()
     fsimple["Opening"] = ApplyOpening;
     fsimple["Morpholgical Gradient"] = ApplyMorphGradient;
     fsimple["Morphological Top Hat"] = ApplyTopHatAlgo;
+    fsimple["Morphological Black Hat"] = ApplyBlackHatAlgo;
+    fsimple["Opening by Reconstruction"] = ApplyOpeningByReconstruction;
+    fsimple["Fill Holes"] = ApplyFillHoles;
+    fsimple["Regional Maxima"] = ApplyRegionalMaxima;
     fsimple["Segmentation Erode"] = segmentErode;
     fsimple["Find Contourns ( Threshold )"] = ApplyFindContournsThreshold;
     fsimple["Find Contourns ( Canny )"] = ApplyFindContournsCanny;
+    fsimple["Connected Components"] = components::ApplyConnectedComponents;
     fsimple["Gaussian Difference"] = ApplyDifferenceOfGaussian;
     fsimple["Show Sift Descriptors"] = ApplySiftToImage;
+    fsimple["Find Blobs (DoG)"] = ApplyFindBlobs;
     fsimple["Find Faces"] = FindFacesAndDrawRectangles;
 
 }
 
 void CInputDialog::setOtherMaps()
 {
-    fmore["Erosion+"] = ApplyErodeEx;
-    fmore["Dilate+"] = ApplyDilateEx;
     fmore["Blur Image"] = blurImageSmooth;
     fmore["Median"] = MedianImageSmooth;
+    fmore["Weighted Median"] = WeightedMedianImageSmooth;
+    fmore["Adaptive Threshold (Sauvola)"] = ApplySauvolaThreshold;
+    fmore["Adaptive Threshold (Niblack)"] = ApplyNiblackThreshold;
+    fmore["Adaptive Threshold (Bradley)"] = ApplyBradleyThreshold;
+    fmore["Multi-level Otsu"] = ApplyMultiOtsu;
+    fmore3["Erosion+"] = ApplyErodeEx;
+    fmore3["Dilate+"] = ApplyDilateEx;
     fmore3["Canny Extended"] = ApplyCannyAlgoFull;
+    fmore3["Hysteresis Threshold"] = ApplyHysteresisThreshold;
     fmorep["Gaussian Extended"] = GaussianImageSmoothExtended;
+    fmorep["Bilateral Filter"] = ApplyBilateralFilterExt;
+    fmorep["Guided Filter"] = ApplyGuidedFilter;
     fmorepp["Laplacian Extended"] = ApplyLaplacianExtended;
     fadjust["Adjust Contrast"] = adjustContrast;
     fadjust["Adjust Brightness"] = adjustBrightness;
@@ -356,9 +374,7 @@ bool CInputDialog::DoFunctionBasedOnNameAlgo(wxString& _algorithm)
         if (original.empty() == false)
         {
             eigenSpace _espace;
-            wxBusyInfo* wait = ProgramBusy();
-            std::stringstream os = getEingenSpaceInfo(original, _espace);
-            Stop(wait);
+            bool saved = false;
 
             if (wxYES == wxMessageBox(  wxT("Save file?"),
                                         wxT("Save file?"),
@@ -370,7 +386,7 @@ bool CInputDialog::DoFunctionBasedOnNameAlgo(wxString& _algorithm)
                                             wxEmptyString,
                                             wxEmptyString,
                                             "pca.csv",
-                                            "Text Files (*.csv)|*.csv|All Files (*.*)|*.*",
+                                            "Text Files (*.csv)|*.csv|Binary columnar (*.dvgc)|*.dvgc|All Files (*.*)|*.*",
                                             wxFD_SAVE);
 
                 if (saveFileDialog.ShowModal() == wxID_OK)
@@ -378,15 +394,43 @@ bool CInputDialog::DoFunctionBasedOnNameAlgo(wxString& _algorithm)
                     wxString spath = saveFileDialog.GetPath();
                     std::string path = convertWxStringToString(spath);
 
-                    std::ofstream myfile(path);
-                    if (myfile.is_open())
+                    // rows are written chunk by chunk while they are computed, only a sample is kept for the plot
+                    wxProgressDialog progress(  "PCA",
+                                                "Writing the eigen space...",
+                                                100,
+                                                this,
+                                                wxPD_APP_MODAL | wxPD_CAN_ABORT | wxPD_AUTO_HIDE | wxPD_ELAPSED_TIME);
+
+                    long long rows = exportEingenSpace( original,
+                                                        path,
+                                                        1e2,
+                                                        1e5,
+                                                        [&](size_t done, size_t total)
+                                                        {
+                                                            return progress.Update(static_cast<int>(100 * done / total));
+                                                        },
+                                                        &_espace.first);
+                    saved = true;
+                    if (rows == export_cancelled)
+                    {
+                        wxMessageBox("The PCA export was cancelled, no file was written", "PCA", wxOK | wxICON_INFORMATION);
+                        return true;
+                    }
+                    if (rows < 0)
                     {
-                        myfile << os.str();
+                        wxMessageBox("The PCA file was not written", "Error", wxOK | wxICON_ERROR);
+                        return true;
                     }
-                    myfile.close();
                 }
             }
 
+            if (saved == false)
+            {
+                wxBusyInfo* wait = ProgramBusy();
+                _espace.first = sampleEingenVectors(original);
+                Stop(wait);
+            }
+
             // let's show some graphics
             ShowPCA(_espace);
         } 
@@ -424,6 +468,51 @@ bool CInputDialog::DoFunctionBasedOnNameAlgo(wxString& _algorithm)
         return true;
     }
 
+    if (_algorithm == "Filter Objects")
+    {
+        if (original.empty() == false)
+        {
+            wxNumberEntryDialog dialogMin(this, "Smallest area (pixels)", "Min area", "Filter Objects", 100, 0, 100000000);
+            if (dialogMin.ShowModal() != wxID_OK)
+            {
+                return true;
+            }
+            wxNumberEntryDialog dialogMax(this, "Largest area (pixels)", "Max area", "Filter Objects", 100000, 0, 100000000);
+            if (dialogMax.ShowModal() != wxID_OK)
+            {
+                return true;
+            }
+            // 100 is a disc, a line is close to 0
+            wxNumberEntryDialog dialogRound(this, "Smallest roundness (%)", "Roundness", "Filter Objects", 0, 0, 100);
+            if (dialogRound.ShowModal() != wxID_OK)
+            {
+                return true;
+            }
+
+            wxBusyInfo* wait = ProgramBusy();
+            final_image = descriptor_query::filterObjects(  original,
+                                                            dialogMin.GetValue(),
+                                                            dialogMax.GetValue(),
+                                                            dialogRound.GetValue() / 100.0);
+            Stop(wait);
+            setOriginalImage();
+        }
+        return true;
+    }
+
+    if (_algorithm == "Granulometry")
+    {
+        if (original.empty() == false)
+        {
+            wxNumberEntryDialog dialog(this, "Largest radius", "Radius", "Granulometry", 10, 1, 100);
+            if (dialog.ShowModal() == wxID_OK)
+            {
+                plotGranulometry(original, dialog.GetValue());
+            }
+        }
+        return true;
+    }
+
     if (_algorithm == "Find Sift Descriptors")
     {
         if (original.empty() == false)
@@ -444,14 +533,14 @@ bool CInputDialog::DoFunctionBasedOnNameAlgo(wxString& _algorithm)
                     wxEmptyString,
                     wxEmptyString,
                     "sift.csv",
-                    "Text Files (*.csv)|*.csv|All Files (*.*)|*.*",
+                    "Text Files (*.csv)|*.csv|Binary columnar (*.dvgc)|*.dvgc|All Files (*.*)|*.*",
                     wxFD_SAVE);
 
                 if (saveFileDialog.ShowModal() == wxID_OK)
                 {
                     wxString spath = saveFileDialog.GetPath();
                     std::string path = convertWxStringToString(spath);
-                    sift_algo::createCSV(kp, path);
+                    sift_algo::saveDescriptors(kp, descriptors, path);
                 }
             }
         }
@@ -511,6 +600,46 @@ bool CInputDialog::DoFunctionBasedOnNameAlgo(wxString& _algorithm)
     return false;
 }
 
+bool CInputDialog::chooseStructuringElement(int& shape, int& size)
+{
+    std::vector<wxString> choices = {   "MORPH_RECT",
+                                        "MORPH_CROSS",
+                                        "MORPH_ELLIPSE",
+                                        "Horizontal Line",
+                                        "Vertical Line",
+                                        "Diamond",
+                                        "Octagon" };
+
+    std::vector<morphology::Shape> shapes = {   morphology::Shape::Rect,
+                                                morphology::Shape::Cross,
+                                                morphology::Shape::Ellipse,
+                                                morphology::Shape::HorizontalLine,
+                                                morphology::Shape::VerticalLine,
+                                                morphology::Shape::Diamond,
+                                                morphology::Shape::Octagon };
+
+    wxSingleChoiceDialog dialog(
+        this,
+        "Choose Basic Element",
+        "Choose Basic Element",
+        static_cast<int>(choices.size()), choices.data());
+
+    if (dialog.ShowModal() != wxID_OK)
+    {
+        return false;
+    }
+    shape = static_cast<int>(shapes[dialog.GetSelection()]);
+
+    // the cost of the rectangles, lines, diamonds and octagons does not depend on the size
+    wxNumberEntryDialog dialogSize(this, "Size of the element (odd)", "Size", "Element Size", 3, 1, 1001);
+    if (dialogSize.ShowModal() != wxID_OK)
+    {
+        return false;
+    }
+    size = dialogSize.GetValue() | 1;
+    return true;
+}
+
 bool CInputDialog::DoFunctionBasedOnFunctor(wxString& _algorithm)
 {
     Function1Parameter  function1P = getAlgoFunctionOnePar(_algorithm);
@@ -523,48 +652,73 @@ bool CInputDialog::DoFunctionBasedOnFunctor(wxString& _algorithm)
 
     Function2Parameter  function2P = getAlgoFunctionTwoPar(_algorithm);
 
-    if (function2P != nullptr)
+    if (function2P != nullptr && _algorithm == "Multi-level Otsu")
     {
-        int option = MORPH_CROSS;
-        if (_algorithm == "Erosion+" || _algorithm == "Dilate+")
+        wxNumberEntryDialog dialog(this, "Number of classes", "Classes", "Multi-level Otsu", 3, 2, thresholding::max_classes);
+        if (dialog.ShowModal() == wxID_OK)
         {
-            std::vector<wxString> choices = { "MORPH_RECT","MORPH_CROSS","MORPH_ELLIPSE" };
-            wxSingleChoiceDialog dialog(
-                this,
-                "Choose Basic Element",
-                "Choose Basic Element",
-                static_cast<int>(choices.size()), choices.data());
+            ApplyAlgorithm(function2P, true, dialog.GetValue());
+        }
+        shouldQuit = true;
+        return true;
+    }
 
-            dialog.ShowModal();
-            wxString structural_element = dialog.GetStringSelection();
-            if (structural_element == "MORPH_RECT")
-            {
-                option = MORPH_RECT;
-            }
-            else
-            if (structural_element == "MORPH_CROSS")
-            {
-                option = MORPH_CROSS;
-            }
-            else
-            if (structural_element == "MORPH_ELLIPSE")
-            {
-                option = MORPH_ELLIPSE;
-            }
-            else
-            {
-                shouldQuit = true;
-                return true;
-            }
+    if (function2P != nullptr && _algorithm.StartsWith("Adaptive Threshold"))
+    {
+        // the window should hold a few characters or the lighting changes
+        wxNumberEntryDialog dialog(this, "Size of the window", "Window", _algorithm, 31, 3, 1001);
+        if (dialog.ShowModal() == wxID_OK)
+        {
+            ApplyAlgorithm(function2P, true, dialog.GetValue());
+        }
+        shouldQuit = true;
+        return true;
+    }
 
+    if (function2P != nullptr)
+    {
+        // the medians take odd sizes, the weighted one costs size x size per pixel
+        const bool is_median = (_algorithm == "Median" || _algorithm == "Weighted Median");
+        const int max_size = (_algorithm == "Weighted Median") ? 31 : (is_median ? median::max_size : 1001);
+        wxNumberEntryDialog dialog(this, "Kernel size", "Kernel size", "Kernel size", 5, 1, max_size);
+        if (dialog.ShowModal() == wxID_OK)
+        {
+            const int size = is_median ? (dialog.GetValue() | 1) : dialog.GetValue();
+            ApplyAlgorithm(function2P, true, size);
         }
-        ApplyAlgorithm(function2P, true, option);
         shouldQuit = true;
         return true;
     }
 
     Function3Parameters function3P = getAlgoFunctionThreePar(_algorithm);
 
+    if (function3P != nullptr && (_algorithm == "Erosion+" || _algorithm == "Dilate+"))
+    {
+        int shape = 0;
+        int size = 0;
+        if (chooseStructuringElement(shape, size))
+        {
+            ApplyAlgorithm(function3P, true, shape, size);
+        }
+        shouldQuit = true;
+        return true;
+    }
+
+    if (function3P != nullptr && _algorithm == "Hysteresis Threshold")
+    {
+        wxNumberEntryDialog dialogLow(this, "Low threshold (gray levels)", "Low", "Hysteresis Threshold", 50, 0, 255);
+        if (dialogLow.ShowModal() == wxID_OK)
+        {
+            wxNumberEntryDialog dialogHigh(this, "High threshold (gray levels)", "High", "Hysteresis Threshold", 150, 0, 255);
+            if (dialogHigh.ShowModal() == wxID_OK)
+            {
+                ApplyAlgorithm(function3P, true, dialogLow.GetValue(), dialogHigh.GetValue());
+            }
+        }
+        shouldQuit = true;
+        return true;
+    }
+
     if (function3P != nullptr)
     {
         wxNumberEntryDialog* dialog2 = new wxNumberEntryDialog(this, "low threshold", "low threshold", "low threshold", 125, 1, 1000);
@@ -598,6 +752,39 @@ bool CInputDialog::DoFunctionBasedOnFunctor(wxString& _algorithm)
 
     Function4Parameters function4P = getAlgoFunctionFourPar(_algorithm);
 
+    if (function4P != nullptr && _algorithm == "Bilateral Filter")
+    {
+        wxNumberEntryDialog dialogSpace(this, "Sigma of the space (pixels)", "Sigma space", "Bilateral Filter", 8, 1, 500);
+        if (dialogSpace.ShowModal() == wxID_OK)
+        {
+            wxNumberEntryDialog dialogColor(this, "Sigma of the values (gray levels)", "Sigma color", "Bilateral Filter", 30, 1, 255);
+            if (dialogColor.ShowModal() == wxID_OK)
+            {
+                ApplyAlgorithm(function4P, true, 0, dialogColor.GetValue(), dialogSpace.GetValue());
+            }
+        }
+        shouldQuit = true;
+        return true;
+    }
+
+    if (function4P != nullptr && _algorithm == "Guided Filter")
+    {
+        wxNumberEntryDialog dialogRadius(this, "Radius of the window", "Radius", "Guided Filter", 8, 1, 500);
+        if (dialogRadius.ShowModal() == wxID_OK)
+        {
+            // eps in thousandths of the squared range
+            wxNumberEntryDialog dialogEps(this, "Regularization eps (x 0.001)", "eps", "Guided Filter", 10, 1, 1000);
+            if (dialogEps.ShowModal() == wxID_OK)
+            {
+                const int radius = dialogRadius.GetValue();
+                // the fast guided filter fits the model on images radius / 4 times smaller
+                ApplyAlgorithm(function4P, true, radius, dialogEps.GetValue() * 0.001, std::max(1, radius / 4));
+            }
+        }
+        shouldQuit = true;
+        return true;
+    }
+
     if (function4P != nullptr)
     {
 
@@ -617,7 +804,8 @@ bool CInputDialog::DoFunctionBasedOnFunctor(wxString& _algorithm)
             {
                 factor = 1.0;
             }
-            ApplyAlgorithm(function4P, true, 3, sigma / factor, sigma / factor);
+            // kernel size 0: taken from sigma
+            ApplyAlgorithm(function4P, true, 0, sigma / factor, sigma / factor);
         }
         shouldQuit = true;
 
@@ -763,36 +951,21 @@ bool CInputDialog::DoFunctionBasedOnFunctor(wxString& _algorithm)
     if (functionS != nullptr)
     {
         Mat out;
-        int depth = 10;
-        int image_type = CV_8U;
-        int type = 0;
         int max = 1000;
         int min = 1;
         double delta = 10.0;
-        int kernel_size = 5;
-        wxString tip = "Depth";
+        int kernel_size = 3;
+        wxString tip = "Delta";
 
         wxNumberEntryDialog* dialog = new wxNumberEntryDialog(this, _algorithm, tip, _algorithm, 10, min, max);
-
         if (dialog->ShowModal() == wxID_OK)
         {
-            depth = dialog->GetValue();
-        }
-
-        tip = "Type";
-        max = 10;
-        min = 1;
-
-        dialog = nullptr;
-        dialog = new wxNumberEntryDialog(this, _algorithm, tip, _algorithm, 10, min, max);
-        if (dialog->ShowModal() == wxID_OK)
-        {
-            type = dialog->GetValue();
+            delta = dialog->GetValue();
         }
 
-        tip = "Delta";
-        max = 1000;
-        min = 1;
+        tip = "Kernel Size";
+        max = 13;
+        min = 3;
 
         if (dialog != nullptr)
         {
@@ -800,22 +973,13 @@ bool CInputDialog::DoFunctionBasedOnFunctor(wxString& _algorithm)
         }
         dialog = nullptr;
 
-        dialog = new wxNumberEntryDialog(this, _algorithm, tip, _algorithm, 10, min, max);
-        if (dialog->ShowModal() == wxID_OK)
-        {
-            delta = dialog->GetValue();
-        }
-
-        tip = "Kernel Size";
-        max = 13;
-        min = 3;
-
         dialog = new wxNumberEntryDialog(this, _algorithm, tip, _algorithm, 3, min, max);
         if (dialog->ShowModal() == wxID_OK)
         {
-            type = dialog->GetValue();
+            // Sobel takes odd apertures, 3 is the gradient shared with Canny and Hough
+            kernel_size = dialog->GetValue() | 1;
         }
-        ApplyAlgorithm(functionS, true, image_type, depth, type, delta, kernel_size);
+        ApplyAlgorithm(functionS, true, delta, kernel_size);
         shouldQuit = true;
 
         if (dialog != nullptr)
@@ -0,0 +1,216 @@
+#include "image_components.h"
+
+namespace components
+{
+    // below this number of pixels the moments are accumulated in one stripe
+    constexpr int parallel_min_pixels = 1 << 18;
+
+    void ComponentStats::resize(size_t n)
+    {
+        area.resize(n);
+        bbox.resize(n);
+        cx.resize(n);
+        cy.resize(n);
+        mu20.resize(n);
+        mu11.resize(n);
+        mu02.resize(n);
+        orientation.resize(n);
+    }
+
+    CComponentAnalyzer::CComponentAnalyzer(const Mat& img, int connectivity)
+    {
+        Mat binary;
+        if (isGrayScaleImage(img) == false)
+        {
+            cvtColor(img, binary, COLOR_BGR2GRAY);
+        }
+        else
+        {
+            binary = img;
+        }
+
+        Mat cc_stats;
+        Mat cc_centroids;
+        int n = connectedComponentsWithStats(   binary,
+                                                labels,
+                                                cc_stats,
+                                                cc_centroids,
+                                                connectivity,
+                                                CV_32S,
+                                                CCL_DEFAULT);
+
+        // label 0 is the background
+        stats.resize(n > 0 ? n - 1 : 0);
+        for (int l = 1; l < n; l++)
+        {
+            const int* s = cc_stats.ptr<int>(l);
+            stats.area[l - 1] = s[CC_STAT_AREA];
+            stats.bbox[l - 1] = cv::Rect(s[CC_STAT_LEFT], s[CC_STAT_TOP], s[CC_STAT_WIDTH], s[CC_STAT_HEIGHT]);
+            stats.cx[l - 1] = cc_centroids.at<double>(l, 0);
+            stats.cy[l - 1] = cc_centroids.at<double>(l, 1);
+        }
+
+        accumulateMoments();
+    }
+
+    void CComponentAnalyzer::accumulateMoments()
+    {
+        const int n = count();
+        if (n == 0)
+        {
+            return;
+        }
+
+        // sums of (x-cx)^2, (x-cx)(y-cy), (y-cy)^2 per label, one set per stripe.
+        // Centering on the centroid keeps the sums small and exact enough.
+        const int stripes = (labels.total() < static_cast<size_t>(parallel_min_pixels)) ? 1 :
+                            std::max(1, std::min(labels.rows, cv::getNumThreads()));
+        std::vector<std::vector<double>> sums(stripes);
+
+        cv::parallel_for_(cv::Range(0, stripes), [&](const cv::Range& range)
+        {
+            for (int s = range.start; s < range.end; s++)
+            {
+                std::vector<double>& acc = sums[s];
+                acc.assign(3 * static_cast<size_t>(n), 0.0);
+
+                const int y0 = labels.rows * s / stripes;
+                const int y1 = labels.rows * (s + 1) / stripes;
+                for (int y = y0; y < y1; y++)
+                {
+                    const int* row = labels.ptr<int>(y);
+                    for (int x = 0; x < labels.cols; x++)
+                    {
+                        const int l = row[x] - 1;
+                        if (l < 0)
+                        {
+                            continue;
+                        }
+                        const double dx = x - stats.cx[l];
+                        const double dy = y - stats.cy[l];
+                        double* a = acc.data() + 3 * l;
+                        a[0] += dx * dx;
+                        a[1] += dx * dy;
+                        a[2] += dy * dy;
+                    }
+                }
+            }
+        }, stripes);
+
+        for (int l = 0; l < n; l++)
+        {
+            double s20 = 0;
+            double s11 = 0;
+            double s02 = 0;
+            for (const auto& acc : sums)
+            {
+                s20 += acc[3 * l];
+                s11 += acc[3 * l + 1];
+                s02 += acc[3 * l + 2];
+            }
+
+            const double a = stats.area[l];
+            stats.mu20[l] = s20 / a;
+            stats.mu11[l] = s11 / a;
+            stats.mu02[l] = s02 / a;
+
+            double degrees = 0.5 * atan2(2 * stats.mu11[l], stats.mu20[l] - stats.mu02[l]) * (180.0 / CV_PI);
+            if (degrees < 0)
+            {
+                degrees = 180 + degrees;
+            }
+            stats.orientation[l] = degrees;
+        }
+    }
+
+    const std::vector<Point>& CComponentAnalyzer::getContour(int i)
+    {
+        auto it = contours.find(i);
+        if (it != contours.end())
+        {
+            return it->second;
+        }
+
+        std::vector<Point>& contour = contours[i];
+        if (i < 0 || i >= count())
+        {
+            return contour;
+        }
+
+        // trace only inside the bounding box, with one pixel of border
+        cv::Rect roi = stats.bbox[i];
+        roi.x -= 1;
+        roi.y -= 1;
+        roi.width += 2;
+        roi.height += 2;
+        roi &= cv::Rect(0, 0, labels.cols, labels.rows);
+
+        Mat mask = (labels(roi) == (i + 1));
+
+        std::vector<std::vector<Point>> found;
+        findContours(mask, found, RETR_EXTERNAL, CHAIN_APPROX_NONE, roi.tl());
+
+        size_t best = 0;
+        for (size_t k = 1; k < found.size(); k++)
+        {
+            if (found[k].size() > found[best].size())
+            {
+                best = k;
+            }
+        }
+        if (found.empty() == false)
+        {
+            contour = std::move(found[best]);
+        }
+        return contour;
+    }
+
+    std::vector<int> CComponentAnalyzer::filterByArea(int min_area, int max_area) const
+    {
+        std::vector<int> selected;
+        for (int i = 0; i < count(); i++)
+        {
+            if (stats.area[i] >= min_area && stats.area[i] <= max_area)
+            {
+                selected.push_back(i);
+            }
+        }
+        return selected;
+    }
+
+    Mat drawComponents(const Mat& img, const CComponentAnalyzer& analyzer, int min_area)
+    {
+        Mat out;
+        if (isGrayScaleImage(img))
+        {
+            cvtColor(img, out, COLOR_GRAY2BGR);
+        }
+        else
+        {
+            out = img.clone();
+        }
+
+        const ComponentStats& stats = analyzer.getStats();
+        for (int i : analyzer.filterByArea(min_area))
+        {
+            rectangle(out, stats.bbox[i], Scalar(0, 255, 0), 1);
+
+            // major axis, its length is two standard deviations each side
+            const double t = stats.orientation[i] * CV_PI / 180.0;
+            const double common = sqrt(pow(stats.mu20[i] - stats.mu02[i], 2) / 4 + pow(stats.mu11[i], 2));
+            const double major = 2 * sqrt(std::max(0.0, (stats.mu20[i] + stats.mu02[i]) / 2 + common));
+            Point2d c(stats.cx[i], stats.cy[i]);
+            Point2d d(major * cos(t), major * sin(t));
+            line(out, c - d, c + d, Scalar(0, 0, 255), 1);
+            circle(out, c, 2, Scalar(255, 0, 0), FILLED);
+        }
+        return out;
+    }
+
+    Mat ApplyConnectedComponents(const Mat& img)
+    {
+        Mat binary = getBinaryImage(img);
+        CComponentAnalyzer analyzer(binary);
+        return drawComponents(img, analyzer, 10);
+    }
+}
@@ -0,0 +1,83 @@
+//--------------------------------------------------------------------------------------------------
+// Connected component statistics: area, bounding box, centroid, second order moments and
+// orientation of every component of a binary image in one labelling + one accumulation pass
+// author: Daniel Vasconcelos Gomes 2023
+// if an external code has been used I indicate the sources
+//--------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "opcvwrapper.h"
+#include <climits>
+#include <map>
+#include <vector>
+
+namespace components
+{
+	/*
+	*	Statistics of the components as a structure of arrays, index i is the
+	*	label i + 1 (the background is not stored).
+	*	mu20, mu11 and mu02 are the central moments divided by the area
+	*	(the covariance of the pixel coordinates), orientation is the angle of
+	*	the major axis in degrees [0, 180) like image_info::getOrientation.
+	*/
+	struct ComponentStats
+	{
+		std::vector<int> area;
+		std::vector<cv::Rect> bbox;
+		std::vector<double> cx;
+		std::vector<double> cy;
+		std::vector<double> mu20;
+		std::vector<double> mu11;
+		std::vector<double> mu02;
+		std::vector<double> orientation;
+
+		size_t size() const { return area.size(); };
+		void resize(size_t n);
+	};
+
+	/*
+	*	Labels a binary image (non zero pixels are foreground) with
+	*	connectedComponentsWithStats, which runs the parallel block based
+	*	algorithms of OpenCV, and accumulates the second order moments of all
+	*	components in one parallel pass over the labels (one set of sums per
+	*	stripe, merged at the end). Contours are traced only when asked for,
+	*	inside the bounding box of that component, and then cached.
+	*/
+	class CComponentAnalyzer final
+	{
+	public:
+
+		CComponentAnalyzer(const Mat& img, int connectivity = 8);
+
+		int count() const { return static_cast<int>(stats.size()); };
+		const ComponentStats& getStats() const { return stats; };
+		const Mat& getLabels() const { return labels; };
+
+		// label of component i is i + 1
+		const std::vector<Point>& getContour(int i);
+
+		// components with at least min_area pixels
+		std::vector<int> filterByArea(int min_area, int max_area = INT_MAX) const;
+
+	private:
+		CComponentAnalyzer(CComponentAnalyzer&) = delete;
+		CComponentAnalyzer& operator=(CComponentAnalyzer&) = delete;
+
+		void accumulateMoments();
+
+		Mat labels;
+		ComponentStats stats;
+		std::map<int, std::vector<Point>> contours;
+	};
+
+	/*
+	*	Draws the bounding boxes and major axes of the components on a copy
+	*	of img
+	*/
+	Mat drawComponents(const Mat& img, const CComponentAnalyzer& analyzer, int min_area = 1);
+
+	/*
+	*	Otsu binary image -> components with at least 10 pixels drawn on img
+	*/
+	Mat ApplyConnectedComponents(const Mat& img);
+}
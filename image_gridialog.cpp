@@ -123,9 +123,12 @@ CGridDialogInput::CGridDialogInput(   wxWindow* parent,
             {
                 wxString path = openFileDialog.GetPath();
                 std::string spath = convertWxStringToString(path);
-                std::vector<std::vector<double>> obs;
-                readCSV(obs, spath);
-                LoadDataFromFile(obs, grid);
+                std::vector<double> values;
+                int nfields = 0;
+                if (readCSV(values, nfields, spath) == 0)
+                {
+                    LoadDataFromFile(values, nfields, grid);
+                }
             }
 
         });
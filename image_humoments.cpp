@@ -1,5 +1,7 @@
 #include "childframes.h"
 #include "image_interest_points.h"
+#include "descriptor_io.h"
+#include "shape_retrieval.h"
 #include <iostream>
 #include <fstream>
 
@@ -21,7 +23,7 @@ void CMatchHuMomments::doProcess()
 		wxEmptyString,
 		wxEmptyString,
 		"descriptors.csv",
-		"Text Files (*.csv)|*.csv|All Files (*.*)|*.*",
+		"Text Files (*.csv)|*.csv|Binary columnar (*.dvgc)|*.dvgc|All Files (*.*)|*.*",
 		wxFD_SAVE);
 
 	std::string path;
@@ -34,6 +36,19 @@ void CMatchHuMomments::doProcess()
 	{
 		return;
 	}
+
+	if (descriptor_io::isBinaryFile(path))
+	{
+		// a columnar file has a fixed number of rows, it is rewritten
+		std::vector<double> huh(7 * _images.size());
+		for (size_t i = 0; i < _images.size(); i++)
+		{
+			image_info::getHuhMoments(_images[i], &huh[7 * i]);
+		}
+		descriptor_io::writeHuMoments(huh, path);
+		return;
+	}
+
 	std::ofstream outputFile;
 	outputFile.open(path, std::ios::app);
 	if (outputFile.is_open())
@@ -45,4 +60,72 @@ void CMatchHuMomments::doProcess()
 	}
 	outputFile.close();
 
-}
\ No newline at end of file
+}
+
+CSearchHuMomments::CSearchHuMomments(wxWindow* parent,
+	CWriteLogs* outxt,
+	wxWindowID id,
+	const wxString& title,
+	int inputs)
+	:CLoadImageSetBase(parent, outxt, wxID_ANY, title, inputs)
+{
+
+}
+
+void CSearchHuMomments::doProcess()
+{
+	setImageArray();
+
+	if (_images.empty())
+	{
+		return;
+	}
+
+	wxFileDialog openFileDialog(this,
+		wxEmptyString,
+		wxEmptyString,
+		"descriptors.csv",
+		"Text Files (*.csv)|*.csv|Binary columnar (*.dvgc)|*.dvgc|All Files (*.*)|*.*",
+		wxFD_OPEN | wxFD_FILE_MUST_EXIST);
+
+	if (openFileDialog.ShowModal() != wxID_OK)
+	{
+		return;
+	}
+
+	std::string path = convertWxStringToString(openFileDialog.GetPath());
+
+	shape_retrieval::CHuShapeIndex index;
+	if (index.load(path) == false)
+	{
+		wxMessageBox("Could not read the descriptors file", "Error", wxOK | wxICON_ERROR);
+		return;
+	}
+
+	double huh[7];
+	image_info::getHuhMoments(_images[0], huh);
+
+	const std::vector<std::pair<int, const char*>> methods =
+	{
+		{ CONTOURS_MATCH_I1, "I1" },
+		{ CONTOURS_MATCH_I2, "I2" },
+		{ CONTOURS_MATCH_I3, "I3" }
+	};
+
+	os << index.size() << " shapes in " << path << std::endl;
+	for (const auto& m : methods)
+	{
+		os << "Closest shapes (" << m.second << "): ";
+		for (const auto& match : index.search(huh, 10, m.first))
+		{
+			// the row and, when the file has it, the image it comes from
+			os << "[" << match.first;
+			if (index.image(match.first) >= 0)
+			{
+				os << " (image " << index.image(match.first) << ")";
+			}
+			os << ", " << match.second << "] ";
+		}
+		os << std::endl;
+	}
+}
@@ -2,75 +2,142 @@
 #include <wx/busyinfo.h>
 #include "wx/msgdlg.h"
 #include "filesys.h"
+#include "image_stitching.h"
+#include "descriptor_io.h"
+#include "pca.h"
+#include "preprocess_cache.h"
+#include "integral_image.h"
+#include <cstdio>
 #include <fstream>
 #include <matplot/matplot.h>
 
 void CImageComponentsDescriptorBase::detectRegions(int mode1, int mode2)
 {
-    Mat src = original_image.clone();
-    // Convert image to grayscale
-    Mat gray;
+    // gray image and edges are shared through the preprocessing cache
+    Mat canny_output = preprocess::cache().canny(original_image, 50, 255);
 
-    if (isGrayScaleImage(src) == false)
-    {
-        cvtColor(src, gray, COLOR_BGR2GRAY);
-    }
-    else
-    {
-        gray = src.clone();
-    }
+    // Find all the contours in the thresholded image
+    findContours(canny_output, raw_contourns, raw_hierarchy, mode1, mode2);
+}
 
-    Mat canny_output;
-    Canny(gray, canny_output, 50, 255);
+void CImageComponentsDescriptorBase::getContourHierarchy(ContourHierarchy& tree) const
+{
+    buildContourHierarchy(raw_contourns, raw_hierarchy, tree);
+}
 
-    // Find all the contours in the thresholded image
-    findContours(canny_output, raw_contourns, mode1, mode2);
+// one contour -> one descriptor, every variant writes only its own slot
+void describeNormal(const std::vector<Point>& c, ComponentsDescriptor& d)
+{
+    d.region = c;
+    d.momInertia = cv::moments(d.region);
+    d.convex = isContourConvex(d.region);
 }
 
-void CImageComponentsDescriptorNormal::getObjectsInfo()
+void describeHull(const std::vector<Point>& c, ComponentsDescriptor& d)
 {
-    for (const auto& c : raw_contourns)
-    {
-        // declare the region
-        std::vector<Point> original = c;
-        cv::Moments momInertia = cv::moments(cv::Mat(original));
-        ImageComponentsDescriptor.region = original;
-        ImageComponentsDescriptor.momInertia = momInertia;
-        ImageComponentsDescriptor.convex = isContourConvex(original);
-        Objects.push_back(ImageComponentsDescriptor);
-    }
+    convexHull(c, d.region);
+    d.momInertia = cv::moments(d.region);
+    d.convex = isContourConvex(d.region);
 }
 
-void CImageComponentsDescriptorHull::getObjectsInfo()
+void describeAprox(const std::vector<Point>& c, ComponentsDescriptor& d)
+{
+    double epsilon = 0.1 * arcLength(c, true);
+    approxPolyDP(c, d.region, epsilon, true);
+    d.momInertia = cv::moments(d.region);
+    d.convex = isContourConvex(d.region);
+}
+
+template<typename F>
+void describeAll(const RegionPoints& contourns, ObjectsCollection& objects, F describe)
 {
-    for (const auto& c : raw_contourns)
+    objects.clear();
+    objects.resize(contourns.size());
+    cv::parallel_for_(cv::Range(0, static_cast<int>(contourns.size())), [&](const cv::Range& range)
     {
-        // declare the region
-        std::vector<Point> hull;
-        convexHull(c, hull);
-        Moments momInertiaHull = cv::moments(cv::Mat(hull));
-        ImageComponentsDescriptor.region = hull;
-        ImageComponentsDescriptor.momInertia = momInertiaHull;
-        ImageComponentsDescriptor.convex = isContourConvex(hull);
-        Objects.push_back(ImageComponentsDescriptor);
-    }
+        for (int i = range.start; i < range.end; i++)
+        {
+            describe(contourns[i], objects[i]);
+        }
+    });
 }
 
+void CImageComponentsDescriptorNormal::getObjectsInfo()
+{
+    describeAll(raw_contourns, Objects, describeNormal);
+}
+
+void CImageComponentsDescriptorHull::getObjectsInfo()
+{
+    describeAll(raw_contourns, Objects, describeHull);
+}
 
 void CImageComponentsDescriptorAprox::getObjectsInfo()
 {
-    for (const auto& c : raw_contourns)
+    describeAll(raw_contourns, Objects, describeAprox);
+}
+
+void CImageComponentsDescriptorAll::getObjectsInfo()
+{
+    const size_t n = raw_contourns.size();
+    Objects.clear();
+    HullObjects.clear();
+    AproxObjects.clear();
+    Objects.resize(n);
+    HullObjects.resize(n);
+    AproxObjects.resize(n);
+
+    cv::parallel_for_(cv::Range(0, static_cast<int>(n)), [&](const cv::Range& range)
     {
-        // declare the region
-        std::vector<Point> Aprox;
-        double epsilon = 0.1 * arcLength(c, true);
-        approxPolyDP(c, Aprox, epsilon, true);
-        cv::Moments momInertiaAprox = cv::moments(cv::Mat(Aprox));
-        ImageComponentsDescriptor.region = Aprox;
-        ImageComponentsDescriptor.momInertia = momInertiaAprox;
-        ImageComponentsDescriptor.convex = isContourConvex(Aprox);
-        Objects.push_back(ImageComponentsDescriptor);
-    }
+        for (int i = range.start; i < range.end; i++)
+        {
+            const std::vector<Point>& c = raw_contourns[i];
+            describeNormal(c, Objects[i]);
+            describeHull(c, HullObjects[i]);
+            describeAprox(c, AproxObjects[i]);
+        }
+    });
+}
+
+void DescriptorTable::clear()
+{
+    area.clear();
+    perimeter.clear();
+    roundness.clear();
+    orientation.clear();
+    centroid_x.clear();
+    centroid_y.clear();
+    convex.clear();
+    hu.clear();
+    points.clear();
+    offsets.clear();
+}
+
+void DescriptorTable::resize(size_t objects, size_t total_points)
+{
+    area.resize(objects);
+    perimeter.resize(objects);
+    roundness.resize(objects);
+    orientation.resize(objects);
+    centroid_x.resize(objects);
+    centroid_y.resize(objects);
+    convex.resize(objects);
+    hu.resize(7 * objects);
+    points.resize(total_points);
+    offsets.resize(objects + 1);
+}
+
+ImageDescriptors DescriptorTable::get(size_t i) const
+{
+    ImageDescriptors d;
+    d.centroid = std::pair<int, int>(centroid_x[i], centroid_y[i]);
+    d.Area = area[i];
+    d.perimeter = perimeter[i];
+    d.r_factor = roundness[i];
+    d.orientation = orientation[i];
+    d.convex = convex[i] != 0;
+    std::copy(huMoments(i), huMoments(i) + 7, d.HuMoments);
+    return d;
 }
 
 namespace image_info
@@ -81,15 +148,101 @@ namespace image_info
 
         hull.detectRegions(CHAIN_APPROX_SIMPLE);
         hull.getObjectsInfo();
-        return hull.getImageFullInformation();
+        return hull.releaseImageFullInformation();
     }
 
-    std::pair<int, int> getCentroid(cv::Moments& momInertia)
+    void fillDescriptorTable(const RegionPoints& contours, DescriptorTable& table, RegionKind kind)
     {
-        int cx = momInertia.m10 / momInertia.m00;
-        int cy = momInertia.m01 / momInertia.m00;
-        std::pair<int, int> p(cx, cy);
-        return p;
+        const size_t n = contours.size();
+
+        // a hull or an approximation has at most the points of its contour: every
+        // region is written at the offset of its contour, then the buffer is compacted
+        size_t total = 0;
+        for (const auto& c : contours)
+        {
+            total += c.size();
+        }
+        table.resize(n, total);
+        total = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            table.offsets[i] = total;
+            total += contours[i].size();
+        }
+        table.offsets[n] = total;
+
+        std::vector<size_t> counts(n);
+        cv::parallel_for_(cv::Range(0, static_cast<int>(n)), [&](const cv::Range& range)
+        {
+            // reused by all the contours of the task
+            std::vector<Point> scratch;
+            for (int i = range.start; i < range.end; i++)
+            {
+                const std::vector<Point>& c = contours[i];
+                if (kind == RegionKind::Hull)
+                {
+                    convexHull(c, scratch);
+                }
+                else if (kind == RegionKind::Approx)
+                {
+                    approxPolyDP(c, scratch, 0.1 * arcLength(c, true), true);
+                }
+                const std::vector<Point>& region = (kind == RegionKind::Contour) ? c : scratch;
+
+                cv::Moments mom = cv::moments(region);
+                const double Area = contourArea(region);
+                const double Perimeter = arcLength(region, true);
+                const std::pair<int, int> center = getCentroid(mom, region);
+
+                table.area[i] = Area;
+                table.perimeter[i] = Perimeter;
+                table.roundness[i] = (Perimeter > 0) ? 4 * CV_PI * (Area / pow(Perimeter, 2)) : 0;
+                table.orientation[i] = getOrientation(mom);
+                table.centroid_x[i] = center.first;
+                table.centroid_y[i] = center.second;
+                table.convex[i] = isContourConvex(region) ? 1 : 0;
+                getHuMoments(mom, table.hu.data() + 7 * i);
+                std::copy(region.begin(), region.end(), table.points.begin() + table.offsets[i]);
+                counts[i] = region.size();
+            }
+        });
+
+        if (kind == RegionKind::Contour)
+        {
+            return;
+        }
+
+        // regions only move to the left, std::copy is safe
+        size_t used = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            const auto from = table.points.begin() + table.offsets[i];
+            std::copy(from, from + counts[i], table.points.begin() + used);
+            table.offsets[i] = used;
+            used += counts[i];
+        }
+        table.offsets[n] = used;
+        table.points.resize(used);
+    }
+
+    std::pair<int, int> getCentroid(const cv::Moments& momInertia, const std::vector<cv::Point>& region)
+    {
+        // a degenerate contour (a line, a point) has no area: the center of its box
+        if (momInertia.m00 != 0)
+        {
+            const double cx = momInertia.m10 / momInertia.m00;
+            const double cy = momInertia.m01 / momInertia.m00;
+            if (std::abs(cx) < INT_MAX && std::abs(cy) < INT_MAX)
+            {
+                return std::pair<int, int>(static_cast<int>(cx), static_cast<int>(cy));
+            }
+        }
+        if (region.empty())
+        {
+            return std::pair<int, int>(0, 0);
+        }
+        const Rect box = boundingRect(region);
+        return std::pair<int, int>(box.x + box.width / 2, box.y + box.height / 2);
     }
 
     double getArea(std::vector<cv::Point>& region)
@@ -142,100 +295,198 @@ namespace image_info
         }
     }
 
-    std::string getHuhMomentsLine(Mat& img)
+    void getHuMoments(const cv::Moments& momInertia, double* huh)
+    {
+        if (huh != nullptr)
+        {
+            HuMoments(momInertia, huh);
+
+            for (int i = 0; i < 7; i++)
+            {
+                huh[i] = -1 * copysign(1.0, huh[i]) * log10(abs(huh[i]));
+            }
+        }
+    }
+
+    void getHuhMoments(const Mat& img, double* huh)
     {
-        std::stringstream os;
         Mat clone = convertograyScale(img);
         // Calculate Moments 
         Moments moments = cv::moments(clone, false);
         // Calculate Hu Moments 
-        double huMoments[7];
-        HuMoments(moments, huMoments);
+        HuMoments(moments, huh);
 
         for (int i = 0; i < 7; i++)
         {
-            huMoments[i] = -1 * copysign(1.0, huMoments[i]) * log10(abs(huMoments[i]));
+            huh[i] = -1 * copysign(1.0, huh[i]) * log10(abs(huh[i]));
         }
+    }
 
-        for (const auto& h : huMoments)
+    long long createHuMomentsFile(  const std::vector<std::string>& files,
+                                    const std::string& path,
+                                    bool per_contour,
+                                    double min_area,
+                                    const std::function<bool(size_t, size_t)>& progress,
+                                    size_t* skipped)
+    {
+        const bool binary = descriptor_io::isBinaryFile(path);
+        // h1..h7, the image and with per_contour the contour
+        const size_t fields = per_contour ? 9 : 8;
+
+        std::vector<std::string> names = { "h1", "h2", "h3", "h4", "h5", "h6", "h7", "image" };
+        if (per_contour)
         {
-            os << h << ",";
+            names.push_back("contour");
         }
 
-        os << std::endl;
-        return os.str();
-    }
+        // both writers stream the rows, the columnar one through a temporary file per column
+        descriptor_io::CCsvBuffer os;
+        descriptor_io::CColumnarAppender columnar;
+        if (binary ? columnar.open(path, names) == false : os.open(path) == false)
+        {
+            return -1;
+        }
 
-    std::string convertWxStringToString(const wxString wsx)
-    {
-        std::stringstream s;
-        s << wsx;
-        return s.str();
-    }
+        bool ok = true;
+        long long rows = 0;
+        size_t unread = 0;
+        bool cancelled = false;
 
-    int readCSV2(  std::vector<std::vector<double>>& obs,
-                   int nfields,
-                   bool ignoreheader,
-                   std::string& filename)
-    {
-        std::ifstream myFile;
-        myFile.open(filename, std::ios_base::in);
+        const size_t batch = 4 * static_cast<size_t>(std::max(1, cv::getNumThreads()));
+        std::vector<std::vector<double>> slots(batch);
+        std::vector<uint8_t> loaded(batch);
 
-        if (myFile.is_open())
+        for (size_t first = 0; first < files.size() && ok && cancelled == false; first += batch)
         {
-            while (myFile.good())
+            const size_t n = std::min(batch, files.size() - first);
+
+            cv::parallel_for_(cv::Range(0, static_cast<int>(n)), [&](const cv::Range& range)
             {
+                for (int k = range.start; k < range.end; k++)
+                {
+                    std::vector<double>& out = slots[k];
+                    out.clear();
 
-                std::string Line;
-                getline(myFile, Line);
+                    Mat img;
+                    loaded[k] = loadImage(files[first + k], img) ? 1 : 0;
+                    if (loaded[k] == 0)
+                    {
+                        continue;
+                    }
 
-                if (Line[0] == '#')
-                {
-                   continue;
-                }
+                    const double image = static_cast<double>(first + k);
+                    if (per_contour == false)
+                    {
+                        out.resize(fields);
+                        getHuhMoments(img, out.data());
+                        out[7] = image;
+                        continue;
+                    }
 
-                if (ignoreheader == true)
-                {
-                    ignoreheader = false;
-                    continue;
+                    // a local Otsu image: the folder must not go through the shared cache
+                    Mat bw;
+                    threshold(convertograyScale(img), bw, 0, 255, THRESH_BINARY | THRESH_OTSU);
+                    std::vector<std::vector<Point> > contours;
+                    findContours(bw, contours, RETR_CCOMP, CHAIN_APPROX_NONE);
+                    for (size_t c = 0; c < contours.size(); c++)
+                    {
+                        cv::Moments mom = cv::moments(contours[c]);
+                        if (mom.m00 < min_area)
+                        {
+                            continue;
+                        }
+                        double huh[7];
+                        getHuMoments(mom, huh);
+                        out.insert(out.end(), huh, huh + 7);
+                        out.push_back(image);
+                        out.push_back(static_cast<double>(c));
+                    }
                 }
+            });
+
+            for (size_t k = 0; k < n; k++)
+            {
+                unread += (loaded[k] == 0) ? 1 : 0;
 
-                if (Line.length() == 0)
+                const std::vector<double>& out = slots[k];
+                rows += out.size() / fields;
+
+                if (binary)
                 {
-                    break;
+                    ok = ok && columnar.append(out.data(), out.size() / fields);
+                    continue;
                 }
 
-                int pos = 0;
-                int start = 0;
-                std::vector<double> ob;
-                int cnt = 0;
-                while (pos != -1)
+                for (size_t r = 0; r < out.size(); r += fields)
                 {
-                    if (cnt < nfields)
+                    for (size_t f = 0; f < 7; f++)
                     {
-                        pos = static_cast<int>(Line.find(',', start));
-                        std::string tmp = Line.substr(start, pos - start);
-                        start = pos + 1;
-                        double f = stof(tmp);
-                        ob.push_back(f);
-                        cnt++;
+                        os.add(out[r + f]).comma();
                     }
-                    else
+                    os.add(static_cast<int>(out[r + 7]));
+                    if (per_contour)
                     {
-                        break;
+                        os.comma().add(static_cast<int>(out[r + 8]));
                     }
+                    os.newline();
                 }
-                obs.push_back(ob);
             }
-            myFile.close();
+
+            if (progress && progress(first + n, files.size()) == false)
+            {
+                cancelled = true;
+            }
         }
-        else
+
+        if (skipped != nullptr)
         {
+            *skipped = unread;
+        }
+
+        // a cancelled or failed extraction leaves no truncated file behind
+        if (cancelled || ok == false)
+        {
+            if (binary)
+            {
+                columnar.discard();
+            }
+            else
+            {
+                os.close();
+                std::remove(path.c_str());
+            }
             return -1;
         }
 
-        return 0;
-    };
+        if (binary ? columnar.close() == false : os.close() == false)
+        {
+            std::remove(path.c_str());
+            return -1;
+        }
+        return rows;
+    }
+
+    std::string getHuhMomentsLine(Mat& img)
+    {
+        double huMoments[7];
+        getHuhMoments(img, huMoments);
+
+        descriptor_io::CCsvBuffer os(256);
+        for (const auto& h : huMoments)
+        {
+            os.add(h).comma();
+        }
+
+        os.newline();
+        return os.str();
+    }
+
+    std::string convertWxStringToString(const wxString wsx)
+    {
+        std::stringstream s;
+        s << wsx;
+        return s.str();
+    }
 
     std::string loadDescriptorFile()
     {
@@ -305,28 +556,39 @@ namespace sift_algo
 {
     void createCSV(std::vector < cv::KeyPoint >& descriptors, std::string fname)
     {
-        std::ofstream myfile(fname);
+        descriptor_io::CCsvBuffer myfile;
 
-        if (myfile.is_open())
+        if (myfile.open(fname))
         {
-            myfile << "x,y,size,angle,response,octave,class_id" << std::endl;
+            myfile.add("x,y,size,angle,response,octave,class_id").newline();
             for (const auto& descriptor : descriptors)
             {
-                // write fields to s
-                std::stringstream s;
-                s << descriptor.pt.x << ",";
-                s << descriptor.pt.y << ",";
-                s << descriptor.size << ",";
-                s << descriptor.angle << ",";
-                s << descriptor.response << ",";
-                s << descriptor.octave << ",";
-                s << descriptor.class_id << std::endl;
-                myfile << s.str();
+                myfile.add(descriptor.pt.x).comma();
+                myfile.add(descriptor.pt.y).comma();
+                myfile.add(descriptor.size).comma();
+                myfile.add(descriptor.angle).comma();
+                myfile.add(descriptor.response).comma();
+                myfile.add(descriptor.octave).comma();
+                myfile.add(descriptor.class_id).newline();
             }
             myfile.close();
         }
     }
 
+    void saveDescriptors(   std::vector < cv::KeyPoint >& kp,
+                            const Mat& descriptors,
+                            std::string fname)
+    {
+        if (descriptor_io::isBinaryFile(fname))
+        {
+            descriptor_io::writeKeypoints(kp, descriptors, fname);
+        }
+        else
+        {
+            createCSV(kp, fname);
+        }
+    }
+
     std::vector < cv::KeyPoint> ApplySift(const Mat& img, Mat& descriptors)
     {
         Mat gray = convertograyScale(img);
@@ -338,6 +600,81 @@ namespace sift_algo
         return keypoints;
     }
 
+    /*
+    *   L2 normalizes each row so that distances do not depend on the
+    *   magnitude of the descriptor
+    */
+    Mat normalizeDescriptors(const Mat& descriptors)
+    {
+        Mat normalized;
+        descriptors.convertTo(normalized, CV_32F);
+        for (int i = 0; i < normalized.rows; i++)
+        {
+            Mat row = normalized.row(i);
+            double n = norm(row, NORM_L2);
+            if (n > 0)
+            {
+                row *= 1.0 / n;
+            }
+        }
+        return normalized;
+    }
+
+    // https://docs.opencv.org/4.x/db/d18/classcv_1_1flann_1_1GenericIndex.html
+    std::vector<cv::DMatch> radiusMatchDescriptors( const Mat& descriptor1,
+                                                    const Mat& descriptor2,
+                                                    double maxDist,
+                                                    int maxNeighbours)
+    {
+        std::vector<cv::DMatch> matches;
+
+        if (descriptor1.empty() || descriptor2.empty())
+        {
+            return matches;
+        }
+
+        Mat query = normalizeDescriptors(descriptor1);
+        Mat train = normalizeDescriptors(descriptor2);
+
+        cv::flann::Index index(train, cv::flann::KDTreeIndexParams(4));
+        int neighbours = std::min(maxNeighbours, train.rows);
+
+        // the L2 index works with squared distances
+        double radius = maxDist * maxDist;
+
+        std::vector<std::vector<cv::DMatch>> matches2D(query.rows);
+        cv::parallel_for_(Range(0, query.rows), [&](const Range& r)
+            {
+                Mat indices(1, neighbours, CV_32S);
+                Mat dists(1, neighbours, CV_32F);
+                cv::flann::SearchParams params(64);
+
+                for (int q = r.start; q < r.end; q++)
+                {
+                    indices.setTo(Scalar::all(-1));
+                    int found = index.radiusSearch(query.row(q), indices, dists, radius, neighbours, params);
+                    found = std::min(found, neighbours);
+
+                    for (int k = 0; k < found; k++)
+                    {
+                        int t = indices.at<int>(0, k);
+                        if (t >= 0)
+                        {
+                            matches2D[q].push_back(cv::DMatch(q, t, std::sqrt(dists.at<float>(0, k))));
+                        }
+                    }
+                }
+            });
+
+        // flatten, keeping the query order
+        for (const auto& m : matches2D)
+        {
+            matches.insert(matches.end(), m.begin(), m.end());
+        }
+
+        return matches;
+    }
+
     Mat getMatchedImage(    Mat& descriptor1, 
                             Mat& descriptor2, 
                             std::vector < cv::KeyPoint >&  kp1,
@@ -390,16 +727,47 @@ namespace sift_algo
         else
         if (option == 2)
         {
-
+            // maximum acceptable distance between the 2 unit length descriptors
             double maxDist = 0.4;
+            matches = radiusMatchDescriptors(descriptor1, descriptor2, maxDist);
+        }
+        else
+        if (option == 3)
+        {
+            // ratio test, then keep only the matches that agree with the homography
+            std::vector<cv::DMatch> candidates = stitching::getRatioMatches(descriptor1, descriptor2);
+            std::vector<char> inliers;
+            Mat H = stitching::estimateHomography(kp1, kp2, candidates, inliers);
 
-            std::vector<std::vector<cv::DMatch>> matches2D;
-            cv::BFMatcher matcher(NORM_L2);
-            // maximum acceptable distance
-            // between the 2 descriptors
-            matcher.radiusMatch(descriptor1, descriptor2, matches2D, maxDist);
+            for (size_t i = 0; i < candidates.size(); i++)
+            {
+                if (inliers[i])
+                {
+                    matches.push_back(candidates[i]);
+                }
+            }
+
+            drawMatches(img1, kp1, img2, kp2, matches, result, 1);
 
-            matches = matches2D[1];
+            if (H.empty() == false)
+            {
+                // outline of img2 as seen in img1, img1 is on the left of result
+                float w = static_cast<float>(img2.cols);
+                float h = static_cast<float>(img2.rows);
+                std::vector<Point2f> corners = { {0, 0}, {w, 0}, {w, h}, {0, h} };
+                std::vector<Point2f> projected;
+                perspectiveTransform(corners, projected, H);
+
+                for (size_t i = 0; i < projected.size(); i++)
+                {
+                    line(   result,
+                            projected[i],
+                            projected[(i + 1) % projected.size()],
+                            Scalar(0, 255, 0),
+                            4);
+                }
+            }
+            return result;
         }
 
         drawMatches(
@@ -422,7 +790,7 @@ namespace sift_algo
         return s.str();
     }
 
-    void saveCSV(std::vector < cv::KeyPoint >&  kp1)
+    void saveCSV(std::vector < cv::KeyPoint >&  kp1, const Mat& descriptors)
     {
         if (wxYES == wxMessageBox(wxT("Save file?"),
             wxT("Save file?"),
@@ -434,7 +802,7 @@ namespace sift_algo
                 wxEmptyString,
                 wxEmptyString,
                 "sift.csv",
-                "Text Files (*.csv)|*.csv|All Files (*.*)|*.*",
+                "Text Files (*.csv)|*.csv|Binary columnar (*.dvgc)|*.dvgc|All Files (*.*)|*.*",
                 wxFD_SAVE);
 
             if (saveFileDialog.ShowModal() == wxID_OK)
@@ -442,7 +810,7 @@ namespace sift_algo
                 wxString spath = saveFileDialog.GetPath();
                 std::string path = convertWxStringToString(spath);
 
-                sift_algo::createCSV(kp1, path);
+                sift_algo::saveDescriptors(kp1, descriptors, path);
             }
         }
     }
@@ -465,8 +833,8 @@ namespace sift_algo
         std::vector < cv::KeyPoint >  kp1 = ApplySift(img1, descriptor1);
         std::vector < cv::KeyPoint >  kp2 = ApplySift(img2, descriptor2);
 
-        saveCSV(kp1);
-        saveCSV(kp2);
+        saveCSV(kp1, descriptor1);
+        saveCSV(kp2, descriptor2);
 
         Mat result = getMatchedImage(descriptor1, descriptor2, kp1, kp2, img1, img2);
 
@@ -539,7 +907,8 @@ namespace template_matching
             int result_rows = BigImage.rows - tmpt.rows + 1;
 
             result.create(result_rows, result_cols, CV_32FC1);
-            matchTemplate(segmented1, tmpt, result, mode);
+            // the normalized modes share the window sums of segmented1 between the templates
+            integral::matchTemplate(segmented1, tmpt, result, mode);
             normalize(result, result, 0, 1, NORM_MINMAX, -1, Mat());
 
             double minVal; 
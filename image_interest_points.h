@@ -7,7 +7,9 @@
 #include <sstream>
 #include <iostream>
 #include <memory>
+#include <functional>
 #include <limits.h>
+#include <cstdint>
 
 struct ComponentsDescriptor
 {
@@ -26,13 +28,12 @@ struct ComponentsDescriptor
 
 	ComponentsDescriptor(ComponentsDescriptor&& rhs) noexcept
 	{
-		this->region = rhs.region;
-		this->momInertia = rhs.momInertia;
-		this->convex = rhs.convex;
+		region = std::move(rhs.region);
+		momInertia = rhs.momInertia;
+		convex = rhs.convex;
 
 		rhs.region.clear();
-		cv::Moments empty;
-		rhs.momInertia = empty;
+		rhs.momInertia = cv::Moments();
 	}
 
 	ComponentsDescriptor& operator=( const ComponentsDescriptor& rhs)
@@ -45,13 +46,15 @@ struct ComponentsDescriptor
 
 	ComponentsDescriptor& operator=(ComponentsDescriptor&& rhs) noexcept
 	{
-		this->region = rhs.region;
-		this->momInertia = rhs.momInertia;
-		this->convex = rhs.convex;
-
-		rhs.region.clear();
-		cv::Moments empty;
-		rhs.momInertia = empty;
+		if (this != &rhs)
+		{
+			region = std::move(rhs.region);
+			momInertia = rhs.momInertia;
+			convex = rhs.convex;
+
+			rhs.region.clear();
+			rhs.momInertia = cv::Moments();
+		}
 		return *this;
 	}
 };
@@ -101,6 +104,40 @@ struct ImageDescriptors
 };
 
 
+/*
+*	Descriptors of all the objects of an image as a structure of arrays.
+*	Every array is indexed by object, the Hu moments are stored 7 per object
+*	and the regions share one point buffer: region i is
+*	points[offsets[i], offsets[i+1]). A query over one field touches only
+*	that field.
+*/
+struct DescriptorTable
+{
+	std::vector<double> area;
+	std::vector<double> perimeter;
+	std::vector<double> roundness;
+	std::vector<double> orientation;
+	std::vector<int> centroid_x;
+	std::vector<int> centroid_y;
+	std::vector<uint8_t> convex;
+	std::vector<double> hu;
+	std::vector<cv::Point> points;
+	std::vector<size_t> offsets;
+
+	size_t size() const { return area.size(); };
+	bool empty() const { return area.empty(); };
+
+	void clear();
+	void resize(size_t objects, size_t total_points);
+
+	const double* huMoments(size_t i) const { return hu.data() + 7 * i; };
+	const cv::Point* region(size_t i) const { return points.data() + offsets[i]; };
+	size_t regionSize(size_t i) const { return offsets[i + 1] - offsets[i]; };
+
+	// one row as the old aggregate
+	ImageDescriptors get(size_t i) const;
+};
+
 using ObjectsCollection = std::vector< ComponentsDescriptor>;
 using RegionPoints = std::vector<std::vector<Point> >;
 using Descriptors = std::deque< ImageDescriptors >;
@@ -113,22 +150,26 @@ public:
 	~CImageComponentsDescriptorBase() { original_image.deallocate(); };
 
 	void detectRegions(int mode1 = RETR_CCOMP, int mode2 = CHAIN_APPROX_NONE);
-	ObjectsCollection getImageFullInformation()const { return Objects; };
-	
+	const ObjectsCollection& getImageFullInformation()const { return Objects; };
+	ObjectsCollection releaseImageFullInformation() { return std::move(Objects); };
+
 	// implement for each type of contour you are using
 	virtual void getObjectsInfo() = 0;
 
 	RegionPoints getraw_contourns() { return raw_contourns; };
 
+	// parent/child links, depth and net area of the contours of detectRegions
+	void getContourHierarchy(ContourHierarchy& tree) const;
+
 
 protected:
 
 	CImageComponentsDescriptorBase(CImageComponentsDescriptorBase&) = delete;
 	CImageComponentsDescriptorBase& operator=(CImageComponentsDescriptorBase&) = delete;
 
-	ComponentsDescriptor ImageComponentsDescriptor;
 	ObjectsCollection Objects;
 	RegionPoints raw_contourns;
+	std::vector<Vec4i> raw_hierarchy;
 	Mat original_image;
 
 };
@@ -154,11 +195,30 @@ public:
 	virtual void getObjectsInfo() override;
 };
 
+/*
+*	Normal, hull and approximated descriptors in one pass over the contours.
+*	getImageFullInformation returns the normal ones.
+*/
+class CImageComponentsDescriptorAll : public CImageComponentsDescriptorBase
+{
+public:
+	CImageComponentsDescriptorAll(const Mat& img) :CImageComponentsDescriptorBase(img) {};
+	virtual void getObjectsInfo() override;
+
+	const ObjectsCollection& getHullInformation()const { return HullObjects; };
+	const ObjectsCollection& getAproxInformation()const { return AproxObjects; };
+
+private:
+	ObjectsCollection HullObjects;
+	ObjectsCollection AproxObjects;
+};
+
 namespace image_info
 {
 
 	std::string getHuhMomentsLine(Mat& img);
-	std::pair<int, int> getCentroid(cv::Moments& momInertia);
+	// the center of the bounding box of region when its area is 0
+	std::pair<int, int> getCentroid(const cv::Moments& momInertia, const std::vector<cv::Point>& region);
 	std::string convertWxStringToString(const wxString wsx);
 
 	double getArea(std::vector<cv::Point>& region);
@@ -166,15 +226,53 @@ namespace image_info
 	double getRoundNess(std::vector<cv::Point>& region);
 	double getOrientation(cv::Moments& momInertia);
 	void getHuMoments(std::vector<cv::Point>& region, double* huh);
-	std::string getHuhMomentsLine(Mat& img);
+	void getHuMoments(const cv::Moments& momInertia, double* huh);
+
+	enum class RegionKind
+	{
+		Contour,	// the contour itself
+		Hull,		// its convex hull
+		Approx		// approxPolyDP with 10% of the perimeter
+	};
+
+	/*
+	*		Fills the descriptor table straight from the contours of
+	*		findContours, in parallel: the arrays are sized once, every object
+	*		writes its own slot and hulls / approximations go through one
+	*		scratch buffer per task, so there is no allocation per object
+	*/
+	void fillDescriptorTable(	const RegionPoints& contours,
+								DescriptorTable& table,
+								RegionKind kind = RegionKind::Contour);
+
+	/*
+	*		log scaled Hu moments of the whole image, huh has 7 elements
+	*/
+	void getHuhMoments(const Mat& img, double* huh);
+
+	/*
+	*		Hu moments of a list of images written to one csv (or .dvgc) file.
+	*		Images are loaded and processed in parallel batches and the rows
+	*		are written in the order of files through a single buffered writer
+	*		(a .dvgc file streams every column to a temporary file first), so
+	*		only one batch of rows is in memory.
+	*		Every row is h1..h7 followed by the index of its image in files,
+	*		with per_contour there is one row per contour of the Otsu binary
+	*		image (area >= min_area) and the contour index comes last.
+	*		Images that cannot be read have no rows, skipped receives how many.
+	*		progress(done, total) is called after every batch, returning false
+	*		cancels the extraction and removes the file.
+	*		Returns the number of rows, -1 on error or cancel.
+	*/
+	long long createHuMomentsFile(	const std::vector<std::string>& files,
+									const std::string& path,
+									bool per_contour = false,
+									double min_area = 1e2,
+									const std::function<bool(size_t, size_t)>& progress = nullptr,
+									size_t* skipped = nullptr);
 	
 	std::string loadDescriptorFile();
 
-	int readCSV2(	std::vector<std::vector<double>>& obs,
-					int nfields,
-					bool ignoreheader,
-					std::string& filename);
-
 
 	ObjectsCollection getContournInfo(const Mat& img);
 
@@ -197,11 +295,43 @@ namespace sift_algo
 	*/
 	void createCSV(std::vector < cv::KeyPoint >& descriptors, std::string fname);
 
+	/*
+	*		Saves keypoints (and descriptors) as csv, or as a binary columnar
+	*		file when fname has the .dvgc extension
+	*/
+	void saveDescriptors(	std::vector < cv::KeyPoint >& kp,
+							const Mat& descriptors,
+							std::string fname);
+
 	Mat ApplyAndCompareSIFT(std::vector<Mat>& images,
 		std::vector<std::string>& filenames);
 
 	std::vector < cv::KeyPoint >  ApplySift(const Mat& img, Mat& descriptors);
 
+	/*
+	*		Returns the descriptors with every row scaled to unit L2 norm
+	*/
+	Mat normalizeDescriptors(const Mat& descriptors);
+
+	/*
+	*		Radius match of every descriptor of descriptor1 against descriptor2
+	*		using a k-d tree. Both sets are L2 normalized first, so maxDist is
+	*		the euclidean distance between unit vectors (0 identical, sqrt(2)
+	*		orthogonal; d^2 = 2 - 2cos). All matches of all queries are returned,
+	*		at most maxNeighbours per query.
+	*/
+	std::vector<cv::DMatch> radiusMatchDescriptors(	const Mat& descriptor1,
+													const Mat& descriptor2,
+													double maxDist,
+													int maxNeighbours = 8);
+
+	/*
+	*		option 0: cross checked brute force, 10 best matches
+	*		option 1: ratio test
+	*		option 2: radius match on normalized descriptors
+	*		option 3: ratio test filtered by a RANSAC homography, draws the
+	*		          outline of img2 projected on img1
+	*/
 	Mat getMatchedImage(	Mat& descriptor1,
 							Mat& descriptor2,
 							std::vector < cv::KeyPoint >& kp1,
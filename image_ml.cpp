@@ -1,10 +1,27 @@
 #include "image_ml.h"
+#include "descriptor_io.h"
 #include <iostream>
 
+bool loadDescriptorMatrix(const std::string& f, mat& data, int nfields, bool ignoreheader)
+{
+	descriptor_io::CCsvParser parser;
+	if (!parser.open(f, nfields, ignoreheader))
+	{
+		return false;
+	}
+
+	data.set_size(parser.fields(), parser.rows());
+	parser.parse(data.memptr());
+	return true;
+}
+
 void machine_learnit(std::string& f)
 {
 	mat data;
-	data::Load(f, data, true);
+	if (!loadDescriptorMatrix(f, data))
+	{
+		return;
+	}
 
 	std::cout << data;
 
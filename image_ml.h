@@ -11,4 +11,11 @@ using namespace std;
 
 
 
+/*
+*	Loads a descriptor CSV as an armadillo matrix with one observation per
+*	column (the mlpack layout). The row major buffer of the parser is exactly
+*	that column major layout, so the text is parsed into the matrix memory.
+*/
+bool loadDescriptorMatrix(const std::string& f, mat& data, int nfields = 0, bool ignoreheader = false);
+
 void machine_learnit(std::string& f);
\ No newline at end of file
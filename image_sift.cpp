@@ -1,5 +1,6 @@
 #include "childframes.h"
 #include "image_interest_points.h"
+#include "image_stitching.h"
 
 CLoadImageSetBase::CLoadImageSetBase(	wxWindow* parent,
 										CWriteLogs* outxt,
@@ -119,6 +120,10 @@ void CLoadImageSetBase::setEventButtons()
 			readImagePath(this, _paths[0]);
 		});
 	i++;
+	if (i == inputs)
+	{
+		return;
+	}
 
 	_actions[1]->Bind(wxEVT_BUTTON, [&](wxCommandEvent& event)
 		{
@@ -265,3 +270,92 @@ void CApplySift::doProcess()
 	}
 }
 
+CApplyStitching::CApplyStitching(	wxWindow* parent,
+									CWriteLogs* outxt,
+									wxWindowID id,
+									const wxString& title,
+									int inputs,
+									int max_images)
+									:CLoadImageSetBase(parent, outxt, wxID_ANY, title, inputs),
+									max_images{ max_images }
+{
+	// a mosaic can take dozens of images, more than the boxes of the dialog
+	m_buttonAddImages = new wxButton(m_panel5, wxID_ANY, wxT("Add Images"), wxDefaultPosition, wxDefaultSize, 0);
+	m_panel5->GetSizer()->Add(m_buttonAddImages, 0, wxALL, 5);
+	m_panel5->Layout();
+
+	m_buttonAddImages->Bind(wxEVT_BUTTON, [&](wxCommandEvent& event)
+		{
+			wxFileDialog openFileDialog(this,
+				wxEmptyString,
+				wxEmptyString,
+				wxEmptyString,
+				"jpg and tif files(*.jpg; *.tif)| *.jpg; *.tif|All Files (*.*)|*.*", wxFD_OPEN | wxFD_FILE_MUST_EXIST | wxFD_MULTIPLE);
+
+			if (openFileDialog.ShowModal() == wxID_OK)
+			{
+				wxArrayString paths;
+				openFileDialog.GetPaths(paths);
+				for (const auto& path : paths)
+				{
+					_more_files.push_back(convertWxStringToString(path));
+				}
+				wxString info;
+				info << _more_files.size() << " images added\n";
+				this->outxt->writeTo(info);
+			}
+		});
+}
+
+void CApplyStitching::doProcess()
+{
+	// only the paths: the stitcher decodes every image once and keeps the pixels out of memory
+	std::vector<std::string> files;
+	for (int i = 0; i < inputs; i++)
+	{
+		std::string spath = convertWxStringToString(getTextFromBox(_paths[i]));
+		if (spath != "")
+		{
+			files.push_back(spath);
+		}
+	}
+	files.insert(files.end(), _more_files.begin(), _more_files.end());
+
+	if (static_cast<int>(files.size()) > max_images)
+	{
+		files.resize(max_images);
+		outxt->writeTo("Too many images, the last ones were not used.\n");
+	}
+	if (files.size() < 2)
+	{
+		return;
+	}
+
+	wxBusyInfo* wait = op_busy_sift::ProgramBusy();
+	try
+	{
+		Mat result = stitching::stitchImages(files);
+		op_busy_sift::Stop(wait);
+		outxt->writeTo("Mosaic created.\n");
+		showImage(result, "Mosaic");
+
+		wxFileDialog saveFileDialog(this,
+			wxEmptyString,
+			wxEmptyString,
+			"mosaic.jpg",
+			"Image Files (*.jpg;*.tif)|*.jpg;*.tif|All Files (*.*)|*.*",
+			wxFD_SAVE);
+
+		if (saveFileDialog.ShowModal() == wxID_OK)
+		{
+			std::string path = convertWxStringToString(saveFileDialog.GetPath());
+			saveImage(path, result);
+		}
+	}
+	catch (std::exception& e)
+	{
+		op_busy_sift::Stop(wait);
+		std::string a = e.what();
+		wxMessageBox(a.c_str(), "Error", wxOK | wxICON_ERROR);
+	}
+}
@@ -0,0 +1,567 @@
+#include "image_stitching.h"
+#include "image_interest_points.h"
+#include "descriptor_io.h"
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <stdexcept>
+#include <limits>
+#include <cmath>
+
+namespace stitching
+{
+    // https://docs.opencv.org/4.x/d5/d6f/tutorial_feature_flann_matcher.html
+    std::vector<DMatch> getRatioMatches(const Mat& descriptor1,
+                                        const Mat& descriptor2,
+                                        double ratio)
+    {
+        std::vector<DMatch> matches;
+
+        if (descriptor1.rows < 2 || descriptor2.rows < 2)
+        {
+            return matches;
+        }
+
+        std::vector<std::vector<cv::DMatch>> matches2D;
+        cv::FlannBasedMatcher matcher;
+        matcher.knnMatch(descriptor1, descriptor2, matches2D, 2);
+
+        for (const auto& m : matches2D)
+        {
+            if (m.size() < 2)
+            {
+                continue;
+            }
+            // first best match/second best match
+            if (m[0].distance < ratio * m[1].distance)
+            {
+                matches.push_back(m[0]);
+            }
+        }
+        return matches;
+    }
+
+    // https://docs.opencv.org/4.x/d7/dff/tutorial_feature_homography.html
+    Mat estimateHomography( const std::vector<cv::KeyPoint>& kp1,
+                            const std::vector<cv::KeyPoint>& kp2,
+                            const std::vector<DMatch>& matches,
+                            std::vector<char>& inliers,
+                            int method,
+                            double reprojThreshold)
+    {
+        inliers.assign(matches.size(), 0);
+
+        if (matches.size() < 4)
+        {
+            return Mat();
+        }
+
+        std::vector<Point2f> pts1;
+        std::vector<Point2f> pts2;
+        pts1.reserve(matches.size());
+        pts2.reserve(matches.size());
+
+        for (const auto& m : matches)
+        {
+            pts1.push_back(kp1[m.queryIdx].pt);
+            pts2.push_back(kp2[m.trainIdx].pt);
+        }
+
+        Mat mask;
+        Mat H = findHomography(pts2, pts1, method, reprojThreshold, mask);
+
+        if (H.empty() || mask.empty())
+        {
+            return Mat();
+        }
+
+        for (size_t i = 0; i < matches.size(); i++)
+        {
+            inliers[i] = mask.at<uchar>(static_cast<int>(i)) != 0;
+        }
+
+        return H;
+    }
+
+    std::vector<PairMatch> matchAllPairs(   const std::vector<std::vector<cv::KeyPoint>>& keypoints,
+                                            const std::vector<Mat>& descriptors,
+                                            int method,
+                                            int min_inliers)
+    {
+        int n = static_cast<int>(descriptors.size());
+
+        std::vector<PairMatch> pairs;
+        for (int i = 0; i < n; i++)
+        {
+            for (int j = i + 1; j < n; j++)
+            {
+                PairMatch p;
+                p.i = i;
+                p.j = j;
+                pairs.push_back(p);
+            }
+        }
+
+        // every pair is independent, each one writes only to its own slot
+        cv::parallel_for_(Range(0, static_cast<int>(pairs.size())), [&](const Range& r)
+            {
+                for (int k = r.start; k < r.end; k++)
+                {
+                    PairMatch& p = pairs[k];
+                    std::vector<DMatch> matches = getRatioMatches(descriptors[p.i], descriptors[p.j]);
+
+                    std::vector<char> inliers;
+                    Mat H = estimateHomography(keypoints[p.i], keypoints[p.j], matches, inliers, method);
+                    if (H.empty())
+                    {
+                        continue;
+                    }
+
+                    p.H = H;
+                    p.inliers = static_cast<int>(std::count(inliers.begin(), inliers.end(), 1));
+                }
+            });
+
+        std::vector<PairMatch> valid;
+        for (auto& p : pairs)
+        {
+            // a few inliers out of many matches is usually a wrong model
+            if (p.H.empty() == false && p.inliers >= min_inliers)
+            {
+                valid.push_back(p);
+            }
+        }
+        return valid;
+    }
+
+    /*
+    *   Bilinear "hat" weight, 1 at the center of the image and 0 at the border.
+    *   It is kept small and warped together with each tile.
+    */
+    Mat getBlendWeight(int size)
+    {
+        Mat weight(size, size, CV_32F);
+        for (int y = 0; y < size; y++)
+        {
+            float wy = 1.0f - std::abs(2.0f * y / (size - 1) - 1.0f);
+            float* w = weight.ptr<float>(y);
+            for (int x = 0; x < size; x++)
+            {
+                float wx = 1.0f - std::abs(2.0f * x / (size - 1) - 1.0f);
+                w[x] = std::max(wx * wy, 1e-3f);
+            }
+        }
+        return weight;
+    }
+
+    // BGR view (3 channels) or BGR copy of img
+    Mat toBGR(const Mat& img)
+    {
+        Mat bgr;
+        if (img.channels() == 1)
+        {
+            cvtColor(img, bgr, COLOR_GRAY2BGR);
+        }
+        else if (img.channels() == 4)
+        {
+            cvtColor(img, bgr, COLOR_BGRA2BGR);
+        }
+        else
+        {
+            bgr = img;
+        }
+        return bgr;
+    }
+
+    /*
+    *   Full resolution BGR pixels of the inputs. Every image is decoded once
+    *   and written to a raw temporary file that is then memory mapped: a tile
+    *   reads only the rows of the region it needs and the system pages them
+    *   in and out, so the memory of the process does not grow with the
+    *   number of inputs. The files are removed by the destructor.
+    */
+    class CRawImages final
+    {
+    public:
+
+        explicit CRawImages(int n) :paths(n), sizes(n), mapped(n)
+        {
+            const std::string stamp = std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+            const std::filesystem::path folder = std::filesystem::temp_directory_path();
+            for (int i = 0; i < n; i++)
+            {
+                paths[i] = (folder / ("dimage_mosaic_" + stamp + "_" + std::to_string(i) + ".raw")).string();
+            }
+        };
+
+        ~CRawImages()
+        {
+            for (size_t i = 0; i < paths.size(); i++)
+            {
+                mapped[i].close();
+                std::remove(paths[i].c_str());
+            }
+        };
+
+        // every i from one thread only
+        bool write(int i, const Mat& bgr)
+        {
+            FILE* file = fopen(paths[i].c_str(), "wb");
+            if (file == nullptr)
+            {
+                return false;
+            }
+            bool ok = true;
+            const size_t row = static_cast<size_t>(bgr.cols) * 3;
+            for (int y = 0; y < bgr.rows && ok; y++)
+            {
+                ok = fwrite(bgr.ptr<uchar>(y), 1, row, file) == row;
+            }
+            ok = (fclose(file) == 0) && ok;
+            sizes[i] = ok ? bgr.size() : Size();
+            return ok;
+        };
+
+        bool map(int i)
+        {
+            return mapped[i].open(paths[i]) &&
+                   mapped[i].size() == static_cast<size_t>(sizes[i].area()) * 3;
+        };
+
+        // read only view of the region r of image i
+        Mat region(int i, const Rect& r) const
+        {
+            Mat all(sizes[i], CV_8UC3, const_cast<char*>(mapped[i].data()));
+            return all(r);
+        };
+
+    private:
+        CRawImages(CRawImages&) = delete;
+        CRawImages& operator=(CRawImages&) = delete;
+
+        std::vector<std::string> paths;
+        std::vector<Size> sizes;
+        std::vector<descriptor_io::CMappedFile> mapped;
+    };
+
+    /*
+    *   Pixels of an image of the given size that T (image -> tile) brings into
+    *   a tile, with a margin for the interpolation. False when none does.
+    */
+    bool sourceRegion(const Size& size, const Mat& T, const Size& tile, Rect& region)
+    {
+        const Rect image(0, 0, size.width, size.height);
+        const Mat inv = T.inv();
+        const double corners[4][2] = { {0, 0}, {1.0 * tile.width, 0}, {1.0 * tile.width, 1.0 * tile.height}, {0, 1.0 * tile.height} };
+
+        double minx = std::numeric_limits<double>::max();
+        double miny = std::numeric_limits<double>::max();
+        double maxx = std::numeric_limits<double>::lowest();
+        double maxy = std::numeric_limits<double>::lowest();
+        for (const auto& c : corners)
+        {
+            const double w = inv.at<double>(2, 0) * c[0] + inv.at<double>(2, 1) * c[1] + inv.at<double>(2, 2);
+            if (w <= 1e-12)
+            {
+                // the tile crosses the horizon of T, the whole image may land in it
+                region = image;
+                return true;
+            }
+            const double x = (inv.at<double>(0, 0) * c[0] + inv.at<double>(0, 1) * c[1] + inv.at<double>(0, 2)) / w;
+            const double y = (inv.at<double>(1, 0) * c[0] + inv.at<double>(1, 1) * c[1] + inv.at<double>(1, 2)) / w;
+            minx = std::min(minx, x);
+            miny = std::min(miny, y);
+            maxx = std::max(maxx, x);
+            maxy = std::max(maxy, y);
+        }
+
+        // clamp before the conversion to int, with a margin for the interpolation
+        const int x0 = static_cast<int>(std::floor(std::max(-2.0, std::min<double>(size.width, minx)))) - 2;
+        const int y0 = static_cast<int>(std::floor(std::max(-2.0, std::min<double>(size.height, miny)))) - 2;
+        const int x1 = static_cast<int>(std::ceil(std::max(-2.0, std::min<double>(size.width, maxx)))) + 2;
+        const int y1 = static_cast<int>(std::ceil(std::max(-2.0, std::min<double>(size.height, maxy)))) + 2;
+        region = Rect(x0, y0, x1 - x0, y1 - y0) & image;
+        return region.empty() == false;
+    }
+
+    Mat stitchImages(   const std::vector<std::string>& files,
+                        int method,
+                        double work_megapixels,
+                        int tile_size)
+    {
+        int n = static_cast<int>(files.size());
+        if (n < 2)
+        {
+            throw std::runtime_error("At least two images are needed for stitching");
+        }
+
+        //------------------------------------------------------------------------
+        //   Step 1 : every image is decoded once, in parallel: SIFT on a reduced
+        //   copy and the full resolution pixels to a raw file for the tiles
+        //------------------------------------------------------------------------
+        std::vector<Size> sizes(n);
+        std::vector<double> scales(n, 1.0);
+        std::vector<std::vector<cv::KeyPoint>> keypoints(n);
+        std::vector<Mat> descriptors(n);
+        std::vector<uint8_t> stored(n, 0);
+        CRawImages raw(n);
+
+        cv::parallel_for_(Range(0, n), [&](const Range& r)
+            {
+                for (int i = r.start; i < r.end; i++)
+                {
+                    // an image that cannot be read has no keypoints and is never registered
+                    Mat img;
+                    if (loadImage(files[i], img) == false || img.empty())
+                    {
+                        continue;
+                    }
+                    sizes[i] = img.size();
+
+                    double area = static_cast<double>(img.cols) * img.rows;
+                    scales[i] = std::min(1.0, sqrt(work_megapixels * 1e6 / area));
+
+                    // reduce first, only the work copy is converted
+                    Mat reduced;
+                    if (scales[i] < 1.0)
+                    {
+                        resize(img, reduced, Size(), scales[i], scales[i], INTER_AREA);
+                    }
+                    else
+                    {
+                        reduced = img;
+                    }
+                    Mat work = toBGR(reduced);
+
+                    keypoints[i] = sift_algo::ApplySift(work, descriptors[i]);
+                    stored[i] = raw.write(i, toBGR(img)) ? 1 : 0;
+                }
+            });
+
+        //------------------------------------------------------------------------
+        //   Step 2 : pairwise homographies, in parallel
+        //------------------------------------------------------------------------
+        std::vector<PairMatch> pairs = matchAllPairs(keypoints, descriptors, method);
+
+        // bring the homographies back to full resolution: H = S_i^-1 * Hs * S_j
+        for (auto& p : pairs)
+        {
+            Mat Si = (Mat_<double>(3, 3) << 1.0 / scales[p.i], 0, 0, 0, 1.0 / scales[p.i], 0, 0, 0, 1);
+            Mat Sj = (Mat_<double>(3, 3) << scales[p.j], 0, 0, 0, scales[p.j], 0, 0, 0, 1);
+            p.H = Si * p.H * Sj;
+        }
+
+        //------------------------------------------------------------------------
+        //   Step 3 : maximum spanning tree on the number of inliers, the image
+        //   with most inliers is the reference frame
+        //------------------------------------------------------------------------
+        std::vector<int> total(n, 0);
+        for (const auto& p : pairs)
+        {
+            total[p.i] += p.inliers;
+            total[p.j] += p.inliers;
+        }
+        int reference = static_cast<int>(std::max_element(total.begin(), total.end()) - total.begin());
+
+        std::vector<Mat> global(n);
+        std::vector<bool> in_tree(n, false);
+        global[reference] = Mat::eye(3, 3, CV_64F);
+        in_tree[reference] = true;
+        int registered = 1;
+
+        while (true)
+        {
+            const PairMatch* best = nullptr;
+            for (const auto& p : pairs)
+            {
+                if (in_tree[p.i] != in_tree[p.j] && (best == nullptr || p.inliers > best->inliers))
+                {
+                    best = &p;
+                }
+            }
+            if (best == nullptr)
+            {
+                break;
+            }
+
+            if (in_tree[best->i])
+            {
+                // j -> i -> reference
+                global[best->j] = global[best->i] * best->H;
+                in_tree[best->j] = true;
+            }
+            else
+            {
+                // i -> j -> reference
+                global[best->i] = global[best->j] * best->H.inv();
+                in_tree[best->i] = true;
+            }
+            registered++;
+        }
+
+        if (registered < 2)
+        {
+            throw std::runtime_error("Images could not be registered, not enough matches");
+        }
+
+        for (int i = 0; i < n; i++)
+        {
+            if (in_tree[i] && (stored[i] == 0 || raw.map(i) == false))
+            {
+                throw std::runtime_error("Could not keep the pixels of " + files[i] + " in a temporary file");
+            }
+        }
+
+        //------------------------------------------------------------------------
+        //   Step 4 : size of the mosaic
+        //------------------------------------------------------------------------
+        double minx = std::numeric_limits<double>::max();
+        double miny = std::numeric_limits<double>::max();
+        double maxx = std::numeric_limits<double>::lowest();
+        double maxy = std::numeric_limits<double>::lowest();
+        double input_area = 0;
+
+        std::vector<std::vector<Point2f>> warped_corners(n);
+        for (int i = 0; i < n; i++)
+        {
+            if (in_tree[i] == false)
+            {
+                continue;
+            }
+            float w = static_cast<float>(sizes[i].width);
+            float h = static_cast<float>(sizes[i].height);
+            std::vector<Point2f> corners = { {0, 0}, {w, 0}, {w, h}, {0, h} };
+            perspectiveTransform(corners, warped_corners[i], global[i]);
+            for (const auto& c : warped_corners[i])
+            {
+                minx = std::min(minx, static_cast<double>(c.x));
+                miny = std::min(miny, static_cast<double>(c.y));
+                maxx = std::max(maxx, static_cast<double>(c.x));
+                maxy = std::max(maxy, static_cast<double>(c.y));
+            }
+            input_area += static_cast<double>(w) * h;
+        }
+
+        double canvas_w = ceil(maxx - minx);
+        double canvas_h = ceil(maxy - miny);
+
+        // a degenerate homography blows the mosaic up, do not try to allocate it
+        if (canvas_w < 1 || canvas_h < 1 || canvas_w * canvas_h > 4 * input_area ||
+            canvas_w > std::numeric_limits<int>::max() / 4 || canvas_h > std::numeric_limits<int>::max() / 4)
+        {
+            throw std::runtime_error("Degenerate homography, the mosaic would be too large");
+        }
+
+        Mat canvas = Mat::zeros(static_cast<int>(canvas_h), static_cast<int>(canvas_w), CV_8UC3);
+
+        std::vector<Rect> footprint(n);
+        for (int i = 0; i < n; i++)
+        {
+            if (in_tree[i] == true)
+            {
+                Rect r = boundingRect(warped_corners[i]);
+                footprint[i] = Rect(r.x - static_cast<int>(minx) - 1, r.y - static_cast<int>(miny) - 1, r.width + 2, r.height + 2);
+            }
+        }
+
+        //------------------------------------------------------------------------
+        //   Step 5 : warp and feather blend one tile at a time
+        //------------------------------------------------------------------------
+        std::vector<Rect> tiles;
+        for (int y = 0; y < canvas.rows; y += tile_size)
+        {
+            for (int x = 0; x < canvas.cols; x += tile_size)
+            {
+                tiles.push_back(Rect(x, y, std::min(tile_size, canvas.cols - x), std::min(tile_size, canvas.rows - y)));
+            }
+        }
+
+        const int weight_size = 64;
+        Mat weight = getBlendWeight(weight_size);
+
+        cv::parallel_for_(Range(0, static_cast<int>(tiles.size())), [&](const Range& r)
+            {
+                Mat accum;
+                Mat wsum;
+                Mat warped;
+                Mat wwarped;
+
+                for (int t = r.start; t < r.end; t++)
+                {
+                    const Rect& tile = tiles[t];
+                    accum.create(tile.size(), CV_32FC3);
+                    accum.setTo(Scalar::all(0));
+                    wsum.create(tile.size(), CV_32F);
+                    wsum.setTo(Scalar::all(0));
+
+                    Mat shift = (Mat_<double>(3, 3) << 1, 0, -(minx + tile.x), 0, 1, -(miny + tile.y), 0, 0, 1);
+
+                    for (int i = 0; i < n; i++)
+                    {
+                        if (in_tree[i] == false || (footprint[i] & tile).empty())
+                        {
+                            continue;
+                        }
+
+                        Mat T = shift * global[i];
+                        Rect region;
+                        if (sourceRegion(sizes[i], T, tile.size(), region) == false)
+                        {
+                            continue;
+                        }
+
+                        // only the pixels of the input this tile sees are read from its mapping
+                        Mat offset = (Mat_<double>(3, 3) << 1, 0, region.x, 0, 1, region.y, 0, 0, 1);
+                        warpPerspective(raw.region(i, region), warped, T * offset, tile.size(), INTER_LINEAR, BORDER_CONSTANT);
+
+                        // weight map coordinates -> image coordinates
+                        Mat Sw = (Mat_<double>(3, 3) <<
+                                    (sizes[i].width - 1.0) / (weight_size - 1), 0, 0,
+                                    0, (sizes[i].height - 1.0) / (weight_size - 1), 0,
+                                    0, 0, 1);
+                        warpPerspective(weight, wwarped, T * Sw, tile.size(), INTER_LINEAR, BORDER_CONSTANT);
+
+                        for (int y = 0; y < tile.height; y++)
+                        {
+                            const uchar* p = warped.ptr<uchar>(y);
+                            const float* w = wwarped.ptr<float>(y);
+                            float* a = accum.ptr<float>(y);
+                            float* s = wsum.ptr<float>(y);
+                            for (int x = 0; x < tile.width; x++)
+                            {
+                                float wv = w[x];
+                                if (wv <= 0)
+                                {
+                                    continue;
+                                }
+                                a[3 * x] += wv * p[3 * x];
+                                a[3 * x + 1] += wv * p[3 * x + 1];
+                                a[3 * x + 2] += wv * p[3 * x + 2];
+                                s[x] += wv;
+                            }
+                        }
+                    }
+
+                    Mat out = canvas(tile);
+                    for (int y = 0; y < tile.height; y++)
+                    {
+                        const float* a = accum.ptr<float>(y);
+                        const float* s = wsum.ptr<float>(y);
+                        uchar* o = out.ptr<uchar>(y);
+                        for (int x = 0; x < tile.width; x++)
+                        {
+                            if (s[x] > 0)
+                            {
+                                float inv = 1.0f / s[x];
+                                o[3 * x] = saturate_cast<uchar>(a[3 * x] * inv);
+                                o[3 * x + 1] = saturate_cast<uchar>(a[3 * x + 1] * inv);
+                                o[3 * x + 2] = saturate_cast<uchar>(a[3 * x + 2] * inv);
+                            }
+                        }
+                    }
+                }
+            });
+
+        return canvas;
+    }
+}
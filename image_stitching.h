@@ -0,0 +1,73 @@
+//--------------------------------------------------------------------------------------------------
+// Homography estimation from SIFT matches and tiled panorama / mosaic stitching
+// author: Daniel Vasconcelos Gomes 2023
+// if an external code has been used I indicate the sources
+//--------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "opcvwrapper.h"
+#include <string>
+#include <vector>
+
+namespace stitching
+{
+	// most images of a mosaic from the dialog
+	constexpr int max_images = 64;
+
+	/*
+	*	Result of matching image j against image i. H maps points of j
+	*	into the frame of i.
+	*/
+	struct PairMatch
+	{
+		int i = -1;
+		int j = -1;
+		Mat H;
+		int inliers = 0;
+	};
+
+	/*
+	*	Lowe ratio test over the two nearest neighbours of each query descriptor
+	*/
+	std::vector<DMatch> getRatioMatches(	const Mat& descriptor1,
+											const Mat& descriptor2,
+											double ratio = 0.75);
+
+	/*
+	*	Estimates the homography that maps kp2 onto kp1 using the matches
+	*	(queryIdx in kp1, trainIdx in kp2). method can be RANSAC or any of the
+	*	USAC variants (USAC_MAGSAC, USAC_ACCURATE...). inliers receives one flag
+	*	per match. Returns an empty Mat when there are not enough matches.
+	*/
+	Mat estimateHomography(	const std::vector<cv::KeyPoint>& kp1,
+							const std::vector<cv::KeyPoint>& kp2,
+							const std::vector<DMatch>& matches,
+							std::vector<char>& inliers,
+							int method = RANSAC,
+							double reprojThreshold = 3.0);
+
+	/*
+	*	Matches every pair of images in parallel and keeps the pairs that
+	*	have a valid homography. Keypoints and descriptors are given per image.
+	*/
+	std::vector<PairMatch> matchAllPairs(	const std::vector<std::vector<cv::KeyPoint>>& keypoints,
+											const std::vector<Mat>& descriptors,
+											int method = RANSAC,
+											int min_inliers = 20);
+
+	/*
+	*	Registers N image files with SIFT + homographies and warps/blends
+	*	them into one mosaic. Every file is decoded once: registration runs on
+	*	a reduced copy (work_megapixels) and the full resolution pixels go to
+	*	a memory mapped temporary file. The final warp/blend is done tile by
+	*	tile and every tile reads only the region of each input it sees, so
+	*	the memory used besides the output canvas is bounded by tile_size and
+	*	the decoding threads whatever the number of images. Files that cannot
+	*	be read are left out of the mosaic.
+	*	Throws std::runtime_error when the images cannot be registered.
+	*/
+	Mat stitchImages(	const std::vector<std::string>& files,
+						int method = RANSAC,
+						double work_megapixels = 0.6,
+						int tile_size = 1024);
+}
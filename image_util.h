@@ -46,7 +46,7 @@ namespace image_util
 	using Function4Parameters = std::function<Mat(Mat, int, double, double)>;
 	using Function5Parameters = std::function<Mat(Mat, int, int, int, int)>;
 	using Function2Slider = std::function<Mat(Mat, double)>;
-	using FunctionSobelParameters = std::function<Mat(Mat, int, int, int, double, int)>;
+	using FunctionSobelParameters = std::function<Mat(Mat, double, int)>;
 
 	using Function1ParContainer = std::map < wxString, Function1Parameter >;
 	using Function2ParContainer = std::map < wxString, Function2Parameter >;
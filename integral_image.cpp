@@ -0,0 +1,344 @@
+#include "integral_image.h"
+#include "preprocess_cache.h"
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+namespace integral
+{
+    // rows of a band of the parallel build
+    constexpr int min_band = 64;
+
+    /*
+    *   Rows [y0, y1) into table rows y0 + 1 .. y1, as if the rows above y0
+    *   were 0 (the band is summed on its own)
+    */
+    template<typename A, typename T>
+    void sumRows(const Mat& img, A* sums, A* squares, size_t stride, int y0, int y1)
+    {
+        const int cn = img.channels();
+        std::vector<A> zero(stride, A(0));
+        std::vector<A> row(cn);
+        std::vector<A> row2(cn);
+
+        for (int y = y0; y < y1; y++)
+        {
+            const T* p = img.ptr<T>(y);
+            const A* above = (y == y0) ? zero.data() : sums + y * stride;
+            const A* above2 = (y == y0) ? zero.data() : squares + y * stride;
+            A* out = sums + (y + 1) * stride;
+            A* out2 = squares + (y + 1) * stride;
+
+            std::fill(row.begin(), row.end(), A(0));
+            std::fill(row2.begin(), row2.end(), A(0));
+            for (int x = 0; x < img.cols; x++)
+            {
+                for (int c = 0; c < cn; c++)
+                {
+                    const A v = static_cast<A>(p[x * cn + c]);
+                    row[c] += v;
+                    row2[c] += v * v;
+                    out[(x + 1) * cn + c] = above[(x + 1) * cn + c] + row[c];
+                    out2[(x + 1) * cn + c] = above2[(x + 1) * cn + c] + row2[c];
+                }
+            }
+        }
+    }
+
+    template<typename A>
+    void CIntegralImage::build(const Mat& img, std::vector<A>& table, std::vector<A>& table2)
+    {
+        const size_t stride = static_cast<size_t>(n_cols + 1) * cn;
+        table.assign(stride * (n_rows + 1), A(0));
+        table2.assign(stride * (n_rows + 1), A(0));
+
+        const int bands = std::max(1, std::min(cv::getNumThreads(), n_rows / min_band));
+        std::vector<int> first(bands + 1);
+        for (int i = 0; i <= bands; i++)
+        {
+            first[i] = static_cast<int>(static_cast<int64_t>(n_rows) * i / bands);
+        }
+
+        cv::parallel_for_(cv::Range(0, bands), [&](const cv::Range& range)
+        {
+            for (int i = range.start; i < range.end; i++)
+            {
+                A* sums = table.data();
+                A* squares = table2.data();
+                const int y0 = first[i];
+                const int y1 = first[i + 1];
+                switch (img.depth())
+                {
+                case CV_8U: sumRows<A, uchar>(img, sums, squares, stride, y0, y1); break;
+                case CV_8S: sumRows<A, schar>(img, sums, squares, stride, y0, y1); break;
+                case CV_16U: sumRows<A, ushort>(img, sums, squares, stride, y0, y1); break;
+                case CV_16S: sumRows<A, short>(img, sums, squares, stride, y0, y1); break;
+                case CV_32S: sumRows<A, int>(img, sums, squares, stride, y0, y1); break;
+                case CV_32F: sumRows<A, float>(img, sums, squares, stride, y0, y1); break;
+                default: sumRows<A, double>(img, sums, squares, stride, y0, y1); break;
+                }
+            }
+        });
+
+        // totals of the bands above band i: the sum of their last rows, still band local
+        std::vector<A> offset(stride * bands, A(0));
+        std::vector<A> offset2(stride * bands, A(0));
+        for (int i = 1; i < bands; i++)
+        {
+            const A* last = table.data() + first[i] * stride;
+            const A* last2 = table2.data() + first[i] * stride;
+            for (size_t k = 0; k < stride; k++)
+            {
+                offset[i * stride + k] = offset[(i - 1) * stride + k] + last[k];
+                offset2[i * stride + k] = offset2[(i - 1) * stride + k] + last2[k];
+            }
+        }
+
+        cv::parallel_for_(cv::Range(1, std::max(1, bands)), [&](const cv::Range& range)
+        {
+            for (int i = range.start; i < range.end; i++)
+            {
+                const A* add = offset.data() + i * stride;
+                const A* add2 = offset2.data() + i * stride;
+                for (int y = first[i] + 1; y <= first[i + 1]; y++)
+                {
+                    A* out = table.data() + y * stride;
+                    A* out2 = table2.data() + y * stride;
+                    for (size_t k = 0; k < stride; k++)
+                    {
+                        out[k] += add[k];
+                        out2[k] += add2[k];
+                    }
+                }
+            }
+        });
+    }
+
+    CIntegralImage::CIntegralImage(const Mat& img)
+        :n_rows(img.rows), n_cols(img.cols), cn(img.channels())
+    {
+        const int depth = img.depth();
+        exact = (depth == CV_8U || depth == CV_8S || depth == CV_16U || depth == CV_16S);
+        if (exact)
+        {
+            build(img, int_sums, int_squares);
+        }
+        else
+        {
+            build(img, sums, squares);
+        }
+    }
+
+    double CIntegralImage::box(int x0, int y0, int x1, int y1, int channel, bool squared) const
+    {
+        const size_t stride = static_cast<size_t>(n_cols + 1) * cn;
+        const size_t a = y0 * stride + x0 * cn + channel;
+        const size_t b = y0 * stride + x1 * cn + channel;
+        const size_t c = y1 * stride + x0 * cn + channel;
+        const size_t d = y1 * stride + x1 * cn + channel;
+        if (exact)
+        {
+            const std::vector<int64_t>& t = squared ? int_squares : int_sums;
+            return static_cast<double>(t[d] - t[b] - t[c] + t[a]);
+        }
+        const std::vector<double>& t = squared ? squares : sums;
+        return t[d] - t[b] - t[c] + t[a];
+    }
+
+    double CIntegralImage::sum(const Rect& r, int channel) const
+    {
+        const Rect clipped = r & Rect(0, 0, n_cols, n_rows);
+        if (clipped.area() == 0)
+        {
+            return 0;
+        }
+        return box(clipped.x, clipped.y, clipped.x + clipped.width, clipped.y + clipped.height, channel, false);
+    }
+
+    double CIntegralImage::squaredSum(const Rect& r, int channel) const
+    {
+        const Rect clipped = r & Rect(0, 0, n_cols, n_rows);
+        if (clipped.area() == 0)
+        {
+            return 0;
+        }
+        return box(clipped.x, clipped.y, clipped.x + clipped.width, clipped.y + clipped.height, channel, true);
+    }
+
+    double CIntegralImage::mean(const Rect& r, int channel) const
+    {
+        const int n = (r & Rect(0, 0, n_cols, n_rows)).area();
+        return (n > 0) ? sum(r, channel) / n : 0;
+    }
+
+    double CIntegralImage::variance(const Rect& r, int channel) const
+    {
+        const int n = (r & Rect(0, 0, n_cols, n_rows)).area();
+        if (n == 0)
+        {
+            return 0;
+        }
+        const double m = sum(r, channel) / n;
+        return std::max(0.0, squaredSum(r, channel) / n - m * m);
+    }
+
+    template<typename A>
+    void CIntegralImage::windows(Mat& mean, Mat* stddev, Size window, const Rect& roi, const std::vector<A>& table, const std::vector<A>& table2) const
+    {
+        const size_t stride = static_cast<size_t>(n_cols + 1) * cn;
+        const int ax = window.width / 2;
+        const int ay = window.height / 2;
+
+        mean.create(roi.height, roi.width, CV_MAKETYPE(CV_32F, cn));
+        if (stddev != nullptr)
+        {
+            stddev->create(roi.height, roi.width, CV_MAKETYPE(CV_32F, cn));
+        }
+
+        cv::parallel_for_(cv::Range(0, roi.height), [&](const cv::Range& range)
+        {
+            for (int i = range.start; i < range.end; i++)
+            {
+                const int y = roi.y + i;
+                const int y0 = std::max(0, y - ay);
+                const int y1 = std::min(n_rows, y - ay + window.height);
+                const A* top = table.data() + y0 * stride;
+                const A* bottom = table.data() + y1 * stride;
+                const A* top2 = table2.data() + y0 * stride;
+                const A* bottom2 = table2.data() + y1 * stride;
+                float* m = mean.ptr<float>(i);
+                float* s = (stddev != nullptr) ? stddev->ptr<float>(i) : nullptr;
+
+                for (int j = 0; j < roi.width; j++)
+                {
+                    const int x = roi.x + j;
+                    const int x0 = std::max(0, x - ax) * cn;
+                    const int x1 = std::min(n_cols, x - ax + window.width) * cn;
+                    const double n = static_cast<double>(y1 - y0) * (x1 - x0) / cn;
+                    for (int c = 0; c < cn; c++)
+                    {
+                        const double total = static_cast<double>(bottom[x1 + c] - bottom[x0 + c] - top[x1 + c] + top[x0 + c]);
+                        const double mu = total / n;
+                        m[j * cn + c] = static_cast<float>(mu);
+                        if (s != nullptr)
+                        {
+                            const double total2 = static_cast<double>(bottom2[x1 + c] - bottom2[x0 + c] - top2[x1 + c] + top2[x0 + c]);
+                            s[j * cn + c] = static_cast<float>(std::sqrt(std::max(0.0, total2 / n - mu * mu)));
+                        }
+                    }
+                }
+            }
+        });
+    }
+
+    void CIntegralImage::mean(Mat& dst, Size window) const
+    {
+        window = Size(std::max(1, window.width), std::max(1, window.height));
+        const Rect all(0, 0, n_cols, n_rows);
+        if (exact)
+        {
+            windows(dst, nullptr, window, all, int_sums, int_squares);
+        }
+        else
+        {
+            windows(dst, nullptr, window, all, sums, squares);
+        }
+    }
+
+    void CIntegralImage::meanStdDev(Mat& mean, Mat& stddev, Size window) const
+    {
+        meanStdDev(mean, stddev, window, Rect(0, 0, n_cols, n_rows));
+    }
+
+    void CIntegralImage::meanStdDev(Mat& mean, Mat& stddev, Size window, const Rect& roi) const
+    {
+        window = Size(std::max(1, window.width), std::max(1, window.height));
+        const Rect clipped = roi & Rect(0, 0, n_cols, n_rows);
+        if (exact)
+        {
+            windows(mean, &stddev, window, clipped, int_sums, int_squares);
+        }
+        else
+        {
+            windows(mean, &stddev, window, clipped, sums, squares);
+        }
+    }
+
+    std::shared_ptr<const CIntegralImage> get(const Mat& img)
+    {
+        const size_t bytes = static_cast<size_t>(img.rows + 1) * (img.cols + 1) * img.channels() * 2 * sizeof(int64_t);
+        return preprocess::cache().object<CIntegralImage>(img, "integral", bytes, [](const Mat& src)
+        {
+            return std::make_shared<CIntegralImage>(src);
+        });
+    }
+
+    void matchTemplate(const Mat& img, const Mat& templ, Mat& result, int method)
+    {
+        const bool normed = (method == TM_CCORR_NORMED || method == TM_SQDIFF_NORMED || method == TM_CCOEFF_NORMED);
+        if (normed == false || img.channels() != 1 || templ.channels() != 1 ||
+            templ.rows > img.rows || templ.cols > img.cols)
+        {
+            cv::matchTemplate(img, templ, result, method);
+            return;
+        }
+
+        Mat correlation;
+        cv::matchTemplate(img, templ, correlation, TM_CCORR);
+
+        const std::shared_ptr<const CIntegralImage> table = get(img);
+        const double n = static_cast<double>(templ.rows) * templ.cols;
+        const Scalar templ_sum = cv::sum(templ);
+        const double templ_sum2 = templ.dot(templ);
+        const double templ_norm = (method == TM_CCOEFF_NORMED) ?
+                                        std::sqrt(std::max(0.0, templ_sum2 - templ_sum[0] * templ_sum[0] / n)) :
+                                        std::sqrt(templ_sum2);
+
+        result.create(correlation.size(), CV_32F);
+        cv::parallel_for_(cv::Range(0, correlation.rows), [&](const cv::Range& range)
+        {
+            for (int y = range.start; y < range.end; y++)
+            {
+                const float* cc = correlation.ptr<float>(y);
+                float* out = result.ptr<float>(y);
+                for (int x = 0; x < correlation.cols; x++)
+                {
+                    const Rect window(x, y, templ.cols, templ.rows);
+                    const double s = table->sum(window);
+                    const double s2 = table->squaredSum(window);
+
+                    double num = cc[x];
+                    double norm = 0;
+                    if (method == TM_CCOEFF_NORMED)
+                    {
+                        num -= s * templ_sum[0] / n;
+                        norm = std::sqrt(std::max(0.0, s2 - s * s / n)) * templ_norm;
+                    }
+                    else
+                    {
+                        norm = std::sqrt(s2) * templ_norm;
+                        if (method == TM_SQDIFF_NORMED)
+                        {
+                            num = s2 - 2 * num + templ_sum2;
+                        }
+                    }
+
+                    // the clamping of matchTemplate for flat windows and rounding
+                    if (std::abs(num) < norm)
+                    {
+                        num /= norm;
+                    }
+                    else if (std::abs(num) < norm * 1.125)
+                    {
+                        num = (num > 0) ? 1 : -1;
+                    }
+                    else
+                    {
+                        num = (method != TM_SQDIFF_NORMED) ? 0 : 1;
+                    }
+                    out[x] = static_cast<float>(num);
+                }
+            }
+        });
+    }
+}
@@ -0,0 +1,94 @@
+//--------------------------------------------------------------------------------------------------
+// Integral images (summed area tables) of the values and of their squares, with box sum,
+// mean and variance queries in constant time, shared by the algorithms that slide windows
+// F.C. Crow, "Summed-area tables for texture mapping", SIGGRAPH 1984
+// author: Daniel Vasconcelos Gomes 2023
+// if an external code has been used I indicate the sources
+//--------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "image_util.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace integral
+{
+	/*
+	*	Tables of (rows + 1) x (cols + 1) sums per channel, S(y, x) = sum of the
+	*	pixels above and left of (y, x). Integer images are summed in 64 bits
+	*	(exact for any size), the others in double. The tables are built by
+	*	bands of rows in parallel: every band sums its rows on their own, then
+	*	the totals of the bands above are added to it.
+	*/
+	class CIntegralImage final
+	{
+	public:
+
+		explicit CIntegralImage(const Mat& img);
+
+		int rows() const { return n_rows; };
+		int cols() const { return n_cols; };
+		int channels() const { return cn; };
+
+		/*
+		*	Sums, mean and (population) variance of the pixels of r, clipped
+		*	to the image. 4 reads per query whatever the size of r.
+		*/
+		double sum(const Rect& r, int channel = 0) const;
+		double squaredSum(const Rect& r, int channel = 0) const;
+		double mean(const Rect& r, int channel = 0) const;
+		double variance(const Rect& r, int channel = 0) const;
+
+		/*
+		*	Mean (and standard deviation) of the window around every pixel,
+		*	anchored at its center like blur, CV_32F with the channels of the
+		*	image. Windows are clipped to the image and divided by the pixels
+		*	they hold, so the border is not extrapolated.
+		*/
+		void mean(Mat& dst, Size window) const;
+		void meanStdDev(Mat& mean, Mat& stddev, Size window) const;
+
+		/*
+		*	The same for the pixels of roi only (the windows still see the
+		*	whole image), mean and stddev have the size of roi. Lets a caller
+		*	work by tiles without images of floats as large as the source.
+		*/
+		void meanStdDev(Mat& mean, Mat& stddev, Size window, const Rect& roi) const;
+
+	private:
+
+		// sum (or sum of squares) of the pixels of [x0, x1) x [y0, y1)
+		double box(int x0, int y0, int x1, int y1, int channel, bool squared) const;
+
+		template<typename A>
+		void build(const Mat& img, std::vector<A>& sums, std::vector<A>& squares);
+
+		template<typename A>
+		void windows(Mat& mean, Mat* stddev, Size window, const Rect& roi, const std::vector<A>& sums, const std::vector<A>& squares) const;
+
+		int n_rows;
+		int n_cols;
+		int cn;
+		bool exact;		// integer sums
+
+		std::vector<int64_t> int_sums;
+		std::vector<int64_t> int_squares;
+		std::vector<double> sums;
+		std::vector<double> squares;
+	};
+
+	/*
+	*	Integral image of img shared through the preprocessing cache: blur,
+	*	local thresholds and template matching on the same image build it once
+	*/
+	std::shared_ptr<const CIntegralImage> get(const Mat& img);
+
+	/*
+	*	TM_CCORR_NORMED, TM_SQDIFF_NORMED and TM_CCOEFF_NORMED of a single
+	*	channel image: the correlation comes from matchTemplate (TM_CCORR)
+	*	and the sums of every window from the shared integral image of img.
+	*	Other methods and images go to matchTemplate.
+	*/
+	void matchTemplate(const Mat& img, const Mat& templ, Mat& result, int method);
+}
@@ -1,5 +1,11 @@
 
 #include "mainframe.h"
+#include "image_interest_points.h"
+#include "filesys.h"
+#include "image_stitching.h"
+#include "descriptor_io.h"
+#include <wx/dirdlg.h>
+#include <wx/progdlg.h>
 
 
 MyFrame::MyFrame() :wxFrame{ nullptr, -1, "diMage", wxPoint(-1, -1) }
@@ -87,6 +93,201 @@ void MyFrame::onApplyHuh(wxCommandEvent& event)
     }
 }
 
+void MyFrame::onApplyHuhFolder(wxCommandEvent& event)
+{
+    wxDirDialog dirDialog(this, "Select the images folder", wxEmptyString, wxDD_DEFAULT_STYLE | wxDD_DIR_MUST_EXIST);
+    if (dirDialog.ShowModal() != wxID_OK)
+    {
+        return;
+    }
+
+    std::vector<std::string> files = listFiles( convertWxStringToString(dirDialog.GetPath()),
+                                                { ".jpg", ".jpeg", ".png", ".tif", ".tiff", ".bmp" });
+    if (files.empty())
+    {
+        wxMessageBox("There are no images in this folder", "Error", wxOK | wxICON_ERROR);
+        return;
+    }
+
+    bool per_contour = (wxYES == wxMessageBox(  wxT("One row per contour? (No: one row per image)"),
+                                                wxT("Hu moments"),
+                                                wxYES_NO | wxICON_QUESTION,
+                                                this));
+
+    wxFileDialog saveFileDialog(this,
+                                wxEmptyString,
+                                wxEmptyString,
+                                "descriptors.csv",
+                                "Text Files (*.csv)|*.csv|Binary columnar (*.dvgc)|*.dvgc|All Files (*.*)|*.*",
+                                wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
+    if (saveFileDialog.ShowModal() != wxID_OK)
+    {
+        return;
+    }
+
+    wxProgressDialog progress(  "Hu moments",
+                                "Extracting descriptors...",
+                                static_cast<int>(files.size()),
+                                this,
+                                wxPD_APP_MODAL | wxPD_CAN_ABORT | wxPD_AUTO_HIDE | wxPD_ELAPSED_TIME | wxPD_REMAINING_TIME);
+
+    const std::string path = convertWxStringToString(saveFileDialog.GetPath());
+    size_t skipped = 0;
+    long long rows = image_info::createHuMomentsFile(   files,
+                                                        path,
+                                                        per_contour,
+                                                        1e2,
+                                                        [&](size_t done, size_t total)
+                                                        {
+                                                            return progress.Update(static_cast<int>(done));
+                                                        },
+                                                        &skipped);
+
+    if (rows < 0)
+    {
+        if (progress.WasCancelled())
+        {
+            std::stringstream os;
+            os << "Hu moments cancelled, no file written." << std::endl;
+            outxt.writeInfo(os);
+            return;
+        }
+        wxMessageBox("Could not write the descriptors file", "Error", wxOK | wxICON_ERROR);
+        return;
+    }
+
+    std::stringstream os;
+    os << rows << " rows from " << files.size() - skipped << " images written." << std::endl;
+    if (skipped > 0)
+    {
+        os << skipped << " images could not be read." << std::endl;
+    }
+
+    // the image column is the position of the file in this list, kept next to the descriptors
+    const std::string list_path = path + ".files.csv";
+    descriptor_io::CCsvBuffer list;
+    bool listed = list.open(list_path);
+    if (listed)
+    {
+        list.add("image,file").newline();
+        for (size_t i = 0; i < files.size(); i++)
+        {
+            list.add(static_cast<int>(i)).comma().add(files[i].c_str()).newline();
+        }
+        listed = list.close();
+    }
+    if (listed)
+    {
+        os << "Images of the image column: " << list_path << std::endl;
+    }
+    else
+    {
+        os << "Could not write the list of images " << list_path << std::endl;
+    }
+    outxt.writeInfo(os);
+}
+
+void MyFrame::onEigenImages(wxCommandEvent& event)
+{
+    wxDirDialog dirDialog(this, "Select the images folder", wxEmptyString, wxDD_DEFAULT_STYLE | wxDD_DIR_MUST_EXIST);
+    if (dirDialog.ShowModal() != wxID_OK)
+    {
+        return;
+    }
+
+    std::vector<std::string> files = listFiles( convertWxStringToString(dirDialog.GetPath()),
+                                                { ".jpg", ".jpeg", ".png", ".tif", ".tiff", ".bmp" });
+
+    long components = wxGetNumberFromUser("Number of components", "Components:", "Eigen Images", 8, 1, 256, this);
+    if (components < 1)
+    {
+        return;
+    }
+
+    CEigenImages eigen(cv::Size(64, 64));
+    bool ok = false;
+    bool cancelled = false;
+    {
+        wxProgressDialog progress(  "Eigen Images",
+                                    "Reading the images...",
+                                    100,
+                                    this,
+                                    wxPD_APP_MODAL | wxPD_CAN_ABORT | wxPD_AUTO_HIDE | wxPD_ELAPSED_TIME | wxPD_REMAINING_TIME);
+
+        ok = eigen.compute( files,
+                            static_cast<int>(components),
+                            1,
+                            [&](size_t done, size_t total)
+                            {
+                                return progress.Update(static_cast<int>(100 * done / total));
+                            });
+        cancelled = progress.WasCancelled();
+    }
+
+    if (ok == false)
+    {
+        if (cancelled)
+        {
+            std::stringstream os;
+            os << "Eigen images cancelled." << std::endl;
+            outxt.writeInfo(os);
+            return;
+        }
+        wxMessageBox("The eigen images were not computed (at least two images are needed)", "Error", wxOK | wxICON_ERROR);
+        return;
+    }
+
+    std::stringstream os;
+    os << eigen.getFiles().size() << " images, eigenvalues: ";
+    for (int k = 0; k < eigen.components(); k++)
+    {
+        os << eigen.getEigenValues().at<double>(k) << " ";
+    }
+    os << std::endl;
+    outxt.writeInfo(os);
+
+    wxFileDialog saveFileDialog(this,
+                                wxEmptyString,
+                                wxEmptyString,
+                                "eigenimages.dvgc",
+                                "Binary columnar (*.dvgc)|*.dvgc|Text Files (*.csv)|*.csv|All Files (*.*)|*.*",
+                                wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
+    if (saveFileDialog.ShowModal() == wxID_OK)
+    {
+        if (eigen.save(convertWxStringToString(saveFileDialog.GetPath())) == false)
+        {
+            wxMessageBox("Could not write the components file", "Error", wxOK | wxICON_ERROR);
+        }
+    }
+
+    // every image on the plane of the first two components
+    eigenSpace espace = eigen.getProjectionSpace();
+    ShowPCA(espace);
+}
+
+void MyFrame::onSearchHuh(wxCommandEvent& event)
+{
+    CSearchHuMomments ImgSet(this, &outxt, -1, "Select Image", 1);
+    ImgSet.ShowModal();
+    if (ImgSet.IsoK)
+    {
+        ImgSet.doProcess();
+        wxString out = ImgSet.getInfo().c_str();
+        outxt.writeTo( out );
+        outxt.writeTo("End.\n");
+    }
+}
+
+void MyFrame::onApplyStitching(wxCommandEvent& event)
+{
+    CApplyStitching ImgSet(this, &outxt, -1, "Select Images", 8, stitching::max_images);
+    ImgSet.ShowModal();
+    if (ImgSet.IsoK)
+    {
+        ImgSet.doProcess();
+    }
+}
+
 void MyFrame::onApplyTemplate(wxCommandEvent& event)
 {
     CMatchTemplate ImgSet(this, &outxt, -1, "Select Images", 2);
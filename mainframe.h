@@ -57,6 +57,10 @@ private:
     void onApplyTemplate(wxCommandEvent& event);
     void onApplyTemplateFull(wxCommandEvent& event);
     void onApplyHuh(wxCommandEvent& event);
+    void onApplyStitching(wxCommandEvent& event);
+    void onSearchHuh(wxCommandEvent& event);
+    void onApplyHuhFolder(wxCommandEvent& event);
+    void onEigenImages(wxCommandEvent& event);
 
     enum  Opt 
     {
@@ -70,6 +74,10 @@ private:
         TEMPLATE_ID,
         TEMPLATE_ID_FULL,
         HUHID,
+        STITCH_ID,
+        HUH_SEARCH_ID,
+        HUH_FOLDER_ID,
+        EIGEN_IMAGES_ID,
     };
 
     void BinAllEvents()
@@ -85,6 +93,10 @@ private:
         Bind(wxEVT_MENU, &MyFrame::onApplyTemplate, this, TEMPLATE_ID); 
         Bind(wxEVT_MENU, &MyFrame::onApplyTemplateFull, this, TEMPLATE_ID_FULL);
         Bind(wxEVT_MENU, &MyFrame::onApplyHuh, this, HUHID);
+        Bind(wxEVT_MENU, &MyFrame::onApplyStitching, this, STITCH_ID);
+        Bind(wxEVT_MENU, &MyFrame::onSearchHuh, this, HUH_SEARCH_ID);
+        Bind(wxEVT_MENU, &MyFrame::onApplyHuhFolder, this, HUH_FOLDER_ID);
+        Bind(wxEVT_MENU, &MyFrame::onEigenImages, this, EIGEN_IMAGES_ID);
                 
     }
 
@@ -105,6 +117,18 @@ private:
         auto menuHuh = menuAlgo->Append(HUHID, "Create Descriptors file(Huh Moments)", "Image Space");
         menuHuh->SetBitmap(wxArtProvider::GetBitmap(wxART_TICK_MARK, wxART_MENU));
 
+        auto menuHuhFolder = menuAlgo->Append(HUH_FOLDER_ID, "Create Descriptors file from Folder (Huh Moments)", "Image Space");
+        menuHuhFolder->SetBitmap(wxArtProvider::GetBitmap(wxART_TICK_MARK, wxART_MENU));
+
+        auto menuHuhSearch = menuAlgo->Append(HUH_SEARCH_ID, "Find Similar Shapes (Huh Moments)", "Image Space");
+        menuHuhSearch->SetBitmap(wxArtProvider::GetBitmap(wxART_TICK_MARK, wxART_MENU));
+
+        auto menuEigen = menuAlgo->Append(EIGEN_IMAGES_ID, "Eigen Images (PCA of a Folder)", "Image Space");
+        menuEigen->SetBitmap(wxArtProvider::GetBitmap(wxART_TICK_MARK, wxART_MENU));
+
+        auto menuStitch = menuAlgo->Append(STITCH_ID, "Image Stitching (SIFT + Homography)", "Image Space");
+        menuStitch->SetBitmap(wxArtProvider::GetBitmap(wxART_TICK_MARK, wxART_MENU));
+
     }
 };
 #endif
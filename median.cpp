@@ -0,0 +1,460 @@
+#include "median.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace median
+{
+    // output columns of a tile, its column histograms stay in the cache
+    constexpr int tile_width = 128;
+
+    /*
+    *   Tiles of columns times bands of rows. A band starts its column
+    *   histograms from size rows, so bands are kept a few windows high.
+    */
+    struct Task
+    {
+        int x0;
+        int x1;
+        int y0;
+        int y1;
+    };
+
+    std::vector<Task> getTasks(int rows, int cols, int size, int tile)
+    {
+        const int min_band = std::max(64, 2 * size);
+        const int bands = std::max(1, std::min(cv::getNumThreads(), rows / min_band));
+        std::vector<Task> tasks;
+        for (int x0 = 0; x0 < cols; x0 += tile)
+        {
+            for (int i = 0; i < bands; i++)
+            {
+                tasks.push_back(Task{   x0,
+                                        std::min(cols, x0 + tile),
+                                        static_cast<int>(static_cast<int64_t>(rows) * i / bands),
+                                        static_cast<int>(static_cast<int64_t>(rows) * (i + 1) / bands) });
+            }
+        }
+        return tasks;
+    }
+
+    /*
+    *   16 coarse bins (high nibble) and 16 x 16 fine bins
+    */
+    struct Histogram8
+    {
+        uint16_t coarse[16];
+        uint16_t fine[16][16];
+
+        void clear()
+        {
+            std::fill(coarse, coarse + 16, uint16_t(0));
+            std::fill(&fine[0][0], &fine[0][0] + 256, uint16_t(0));
+        }
+
+        void add(uchar v)
+        {
+            coarse[v >> 4]++;
+            fine[v >> 4][v & 15]++;
+        }
+
+        void remove(uchar v)
+        {
+            coarse[v >> 4]--;
+            fine[v >> 4][v & 15]--;
+        }
+    };
+
+    /*
+    *   Perreault-Hebert over one task, padded has r = size / 2 replicated
+    *   pixels on every side. The fine bins of the kernel are updated only
+    *   for the coarse bin that holds the median, from the position where
+    *   that bin was last brought up to date.
+    */
+    void constantTimeTask(const Mat& padded, Mat& dst, int size, const Task& task, std::vector<Histogram8>& columns)
+    {
+        const int cn = dst.channels();
+        const int width = task.x1 - task.x0 + size - 1;
+        const int rank = size * size / 2;
+        columns.resize(width);
+
+        for (int ch = 0; ch < cn; ch++)
+        {
+            // padded value of column j of the tile
+            auto value = [&](int y, int j) { return padded.ptr<uchar>(y)[(task.x0 + j) * cn + ch]; };
+
+            for (int y = task.y0; y < task.y1; y++)
+            {
+                if (y == task.y0)
+                {
+                    for (int j = 0; j < width; j++)
+                    {
+                        columns[j].clear();
+                        for (int i = 0; i < size; i++)
+                        {
+                            columns[j].add(value(y + i, j));
+                        }
+                    }
+                }
+                else
+                {
+                    for (int j = 0; j < width; j++)
+                    {
+                        columns[j].remove(value(y - 1, j));
+                        columns[j].add(value(y + size - 1, j));
+                    }
+                }
+
+                Histogram8 kernel;
+                kernel.clear();
+                int updated[16];
+                std::fill(updated, updated + 16, -1);
+                for (int j = 0; j < size; j++)
+                {
+                    for (int b = 0; b < 16; b++)
+                    {
+                        kernel.coarse[b] += columns[j].coarse[b];
+                    }
+                }
+
+                uchar* out = dst.ptr<uchar>(y);
+                for (int x = 0; x < task.x1 - task.x0; x++)
+                {
+                    if (x > 0)
+                    {
+                        const Histogram8& in = columns[x + size - 1];
+                        const Histogram8& gone = columns[x - 1];
+                        for (int b = 0; b < 16; b++)
+                        {
+                            kernel.coarse[b] += in.coarse[b] - gone.coarse[b];
+                        }
+                    }
+
+                    int sum = 0;
+                    int b = 0;
+                    while (sum + kernel.coarse[b] <= rank)
+                    {
+                        sum += kernel.coarse[b];
+                        b++;
+                    }
+
+                    uint16_t* fine = kernel.fine[b];
+                    if (updated[b] < 0 || 2 * (x - updated[b]) > size)
+                    {
+                        // summing the window again is cheaper than catching up
+                        std::fill(fine, fine + 16, uint16_t(0));
+                        for (int j = x; j < x + size; j++)
+                        {
+                            for (int f = 0; f < 16; f++)
+                            {
+                                fine[f] += columns[j].fine[b][f];
+                            }
+                        }
+                    }
+                    else
+                    {
+                        for (int u = updated[b] + 1; u <= x; u++)
+                        {
+                            const uint16_t* in = columns[u + size - 1].fine[b];
+                            const uint16_t* gone = columns[u - 1].fine[b];
+                            for (int f = 0; f < 16; f++)
+                            {
+                                fine[f] += in[f] - gone[f];
+                            }
+                        }
+                    }
+                    updated[b] = x;
+
+                    int f = 0;
+                    while (sum + fine[f] <= rank)
+                    {
+                        sum += fine[f];
+                        f++;
+                    }
+                    out[(task.x0 + x) * cn + ch] = static_cast<uchar>(b * 16 + f);
+                }
+            }
+        }
+    }
+
+    /*
+    *   Huang over one task with a 256 x 256 bins kernel histogram: a column
+    *   of the window in and one out per pixel
+    */
+    void slidingTask(const Mat& padded, Mat& dst, int size, const Task& task, std::vector<uint16_t>& histogram)
+    {
+        const int cn = dst.channels();
+        const int rank = size * size / 2;
+        histogram.resize(256 + 65536);
+        uint16_t* coarse = histogram.data();
+        uint16_t* fine = coarse + 256;
+
+        for (int ch = 0; ch < cn; ch++)
+        {
+            for (int y = task.y0; y < task.y1; y++)
+            {
+                auto column = [&](int j, int delta)
+                {
+                    for (int i = 0; i < size; i++)
+                    {
+                        const ushort v = padded.ptr<ushort>(y + i)[(task.x0 + j) * cn + ch];
+                        coarse[v >> 8] += delta;
+                        fine[v] += delta;
+                    }
+                };
+
+                std::fill(histogram.begin(), histogram.end(), uint16_t(0));
+                for (int j = 0; j < size - 1; j++)
+                {
+                    column(j, 1);
+                }
+
+                ushort* out = dst.ptr<ushort>(y);
+                for (int x = 0; x < task.x1 - task.x0; x++)
+                {
+                    column(x + size - 1, 1);
+
+                    int sum = 0;
+                    int b = 0;
+                    while (sum + coarse[b] <= rank)
+                    {
+                        sum += coarse[b];
+                        b++;
+                    }
+                    int v = b << 8;
+                    while (sum + fine[v] <= rank)
+                    {
+                        sum += fine[v];
+                        v++;
+                    }
+                    out[(task.x0 + x) * cn + ch] = static_cast<ushort>(v);
+
+                    column(x, -1);
+                }
+            }
+        }
+    }
+
+    /*
+    *   Median (weights == nullptr) or weighted median of the window by
+    *   sorting, for any depth
+    */
+    template<typename T>
+    void sortedWindow(const Mat& padded, Mat& dst, int size, const float* weights)
+    {
+        const int cn = dst.channels();
+        const int n = size * size;
+
+        double total = 0;
+        for (int i = 0; weights != nullptr && i < n; i++)
+        {
+            total += weights[i];
+        }
+
+        cv::parallel_for_(cv::Range(0, dst.rows), [&](const cv::Range& range)
+        {
+            std::vector<T> values(n);
+            std::vector<std::pair<T, float> > pairs(n);
+            for (int y = range.start; y < range.end; y++)
+            {
+                T* out = dst.ptr<T>(y);
+                for (int x = 0; x < dst.cols; x++)
+                {
+                    for (int ch = 0; ch < cn; ch++)
+                    {
+                        for (int i = 0; i < size; i++)
+                        {
+                            const T* p = padded.ptr<T>(y + i) + x * cn + ch;
+                            for (int j = 0; j < size; j++)
+                            {
+                                values[i * size + j] = p[j * cn];
+                            }
+                        }
+
+                        if (weights == nullptr)
+                        {
+                            std::nth_element(values.begin(), values.begin() + n / 2, values.end());
+                            out[x * cn + ch] = values[n / 2];
+                            continue;
+                        }
+
+                        for (int i = 0; i < n; i++)
+                        {
+                            pairs[i] = std::make_pair(values[i], weights[i]);
+                        }
+                        std::sort(pairs.begin(), pairs.end(), [](const std::pair<T, float>& a, const std::pair<T, float>& b)
+                        {
+                            return a.first < b.first;
+                        });
+                        double sum = 0;
+                        int k = 0;
+                        while (k < n - 1 && 2 * (sum + pairs[k].second) < total)
+                        {
+                            sum += pairs[k].second;
+                            k++;
+                        }
+                        out[x * cn + ch] = pairs[k].first;
+                    }
+                }
+            }
+        });
+    }
+
+    /*
+    *   Weighted median of 8 bit images with a 256 bins histogram of weights
+    */
+    void weightedHistogram(const Mat& padded, Mat& dst, int size, const float* weights)
+    {
+        const int cn = dst.channels();
+        const int n = size * size;
+
+        double total = 0;
+        for (int i = 0; i < n; i++)
+        {
+            total += weights[i];
+        }
+
+        cv::parallel_for_(cv::Range(0, dst.rows), [&](const cv::Range& range)
+        {
+            double histogram[256];
+            for (int y = range.start; y < range.end; y++)
+            {
+                uchar* out = dst.ptr<uchar>(y);
+                for (int x = 0; x < dst.cols; x++)
+                {
+                    for (int ch = 0; ch < cn; ch++)
+                    {
+                        std::fill(histogram, histogram + 256, 0.0);
+                        for (int i = 0; i < size; i++)
+                        {
+                            const uchar* p = padded.ptr<uchar>(y + i) + x * cn + ch;
+                            const float* w = weights + i * size;
+                            for (int j = 0; j < size; j++)
+                            {
+                                histogram[p[j * cn]] += w[j];
+                            }
+                        }
+
+                        double sum = 0;
+                        int v = 0;
+                        while (v < 255 && 2 * (sum + histogram[v]) < total)
+                        {
+                            sum += histogram[v];
+                            v++;
+                        }
+                        out[x * cn + ch] = static_cast<uchar>(v);
+                    }
+                }
+            }
+        });
+    }
+
+    void filter(const Mat& src, Mat& dst, int size)
+    {
+        size = std::min(max_size, size | 1);
+        if (src.empty() || size == 1)
+        {
+            src.copyTo(dst);
+            return;
+        }
+
+        const int depth = src.depth();
+        if (depth == CV_8S || depth == CV_16S)
+        {
+            // the order is kept by the offset to the unsigned type
+            const int unsigned_depth = (depth == CV_8S) ? CV_8U : CV_16U;
+            const double offset = (depth == CV_8S) ? 128 : 32768;
+            Mat shifted;
+            src.convertTo(shifted, unsigned_depth, 1, offset);
+            filter(shifted, shifted, size);
+            shifted.convertTo(dst, depth, 1, -offset);
+            return;
+        }
+
+        if (depth == CV_32F && size <= 5)
+        {
+            medianBlur(src, dst, size);
+            return;
+        }
+
+        const int r = size / 2;
+        Mat padded;
+        copyMakeBorder(src, padded, r, r, r, r, BORDER_REPLICATE);
+        dst.create(src.size(), src.type());
+
+        if (depth == CV_8U || depth == CV_16U)
+        {
+            const std::vector<Task> tasks = getTasks(src.rows, src.cols, size, (depth == CV_8U) ? tile_width : src.cols);
+            cv::parallel_for_(cv::Range(0, static_cast<int>(tasks.size())), [&](const cv::Range& range)
+            {
+                std::vector<Histogram8> columns;
+                std::vector<uint16_t> histogram;
+                for (int i = range.start; i < range.end; i++)
+                {
+                    if (depth == CV_8U)
+                    {
+                        constantTimeTask(padded, dst, size, tasks[i], columns);
+                    }
+                    else
+                    {
+                        slidingTask(padded, dst, size, tasks[i], histogram);
+                    }
+                }
+            });
+            return;
+        }
+
+        switch (depth)
+        {
+        case CV_32S: sortedWindow<int>(padded, dst, size, nullptr); break;
+        case CV_32F: sortedWindow<float>(padded, dst, size, nullptr); break;
+        case CV_64F: sortedWindow<double>(padded, dst, size, nullptr); break;
+        default: medianBlur(src, dst, std::min(size, 5)); break;
+        }
+    }
+
+    void weighted(const Mat& src, Mat& dst, const Mat& weights)
+    {
+        // an even side loses its last row and column
+        int size = std::min(weights.rows, weights.cols);
+        size -= (size % 2 == 0) ? 1 : 0;
+        if (src.empty() || size < 1)
+        {
+            src.copyTo(dst);
+            return;
+        }
+
+        Mat w;
+        weights(Rect(0, 0, size, size)).convertTo(w, CV_32F);
+        threshold(w, w, 0, 0, THRESH_TOZERO);
+        if (sum(w)[0] <= 0)
+        {
+            src.copyTo(dst);
+            return;
+        }
+
+        const int r = size / 2;
+        Mat padded;
+        copyMakeBorder(src, padded, r, r, r, r, BORDER_REPLICATE);
+        dst.create(src.size(), src.type());
+
+        const float* pw = w.ptr<float>();
+        switch (src.depth())
+        {
+        case CV_8U: weightedHistogram(padded, dst, size, pw); break;
+        case CV_8S: sortedWindow<schar>(padded, dst, size, pw); break;
+        case CV_16U: sortedWindow<ushort>(padded, dst, size, pw); break;
+        case CV_16S: sortedWindow<short>(padded, dst, size, pw); break;
+        case CV_32S: sortedWindow<int>(padded, dst, size, pw); break;
+        case CV_32F: sortedWindow<float>(padded, dst, size, pw); break;
+        default: sortedWindow<double>(padded, dst, size, pw); break;
+        }
+    }
+
+    Mat gaussianWeights(int size, double sigma)
+    {
+        size |= 1;
+        const Mat kernel = getGaussianKernel(size, sigma, CV_32F);
+        return kernel * kernel.t();
+    }
+}
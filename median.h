@@ -0,0 +1,50 @@
+//--------------------------------------------------------------------------------------------------
+// Median filter with a cost per pixel that does not depend on the kernel size (8 bit),
+// and a weighted median filter
+// S. Perreault, P. Hebert, "Median filtering in constant time", IEEE TIP 16 (2007)
+// T.S. Huang, G.J. Yang, G.Y. Tang, "A fast two-dimensional median filtering algorithm",
+// IEEE Trans. ASSP 27 (1979)
+// author: Daniel Vasconcelos Gomes 2023
+// if an external code has been used I indicate the sources
+//--------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "image_util.h"
+
+namespace median
+{
+	// largest kernel side (the histograms count up to 255 x 255 values in 16 bits)
+	constexpr int max_size = 255;
+
+	/*
+	*	Median of the size x size window around every pixel, channel by
+	*	channel, with the replicated border of medianBlur. size is made odd
+	*	and at most max_size, dst may be src.
+	*
+	*	8 bit images: Perreault-Hebert, one histogram per column updated by
+	*	one pixel in and one out per row, and a two level (16 x 16 bins)
+	*	kernel histogram updated by one column in and one out per pixel, so
+	*	the cost per pixel is constant. The image is cut in tiles of columns
+	*	and bands of rows run in parallel, the column histograms of a tile
+	*	stay in the cache.
+	*	16 bit images: the kernel histogram (256 x 256 bins) is updated by a
+	*	column of pixels per step (Huang), O(size) per pixel.
+	*	Other depths: medianBlur up to 5 x 5 for float images, a partial sort
+	*	of the window otherwise.
+	*/
+	void filter(const Mat& src, Mat& dst, int size);
+
+	/*
+	*	Weighted median: every pixel of the window counts as many times as
+	*	its weight, the result is the smallest value with half of the total
+	*	weight at or below it. weights is a square kernel of odd side (any
+	*	depth, negative weights count as 0), dst may be src.
+	*/
+	void weighted(const Mat& src, Mat& dst, const Mat& weights);
+
+	/*
+	*	size x size Gaussian weights, sigma = 0 takes it from the size like
+	*	getGaussianKernel
+	*/
+	Mat gaussianWeights(int size, double sigma = 0);
+}
@@ -0,0 +1,1229 @@
+#include "morphology.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
+#include <vector>
+
+namespace morphology
+{
+    // columns (values) of the strips of the vertical pass
+    constexpr int strip_width = 256;
+
+    /*
+    *   Offsets of a window along one direction, relative to the anchor
+    */
+    struct Span
+    {
+        int lo;
+        int hi;
+
+        int length() const { return hi - lo + 1; };
+        bool identity() const { return lo == 0 && hi == 0; };
+    };
+
+    // window of size values anchored at size / 2, n times larger
+    Span centered(int size, int n)
+    {
+        const int a = size / 2;
+        return Span{ -a * n, (size - 1 - a) * n };
+    }
+
+    template<typename T>
+    struct MinOp
+    {
+        static constexpr bool dilate = false;
+        static T neutral() { return std::numeric_limits<T>::max(); };
+        T operator()(T a, T b) const { return std::min(a, b); };
+        static void combine(const Mat& a, Mat& acc) { cv::min(a, acc, acc); };
+    };
+
+    template<typename T>
+    struct MaxOp
+    {
+        static constexpr bool dilate = true;
+        static T neutral() { return std::numeric_limits<T>::lowest(); };
+        T operator()(T a, T b) const { return std::max(a, b); };
+        static void combine(const Mat& a, Mat& acc) { cv::max(a, acc, acc); };
+    };
+
+    /*
+    *   van Herk/Gil-Werman over a sequence of L vectors of width values:
+    *   out(x) = op(in(x) .. in(x + k - 1)) for x in [0, L - k].
+    *   The sequence is cut in blocks of k, h holds the suffix of every block
+    *   and g the running prefix, so every output is op(h(x), g(x + k - 1)).
+    *   in(i) is read before out(i - k + 1) is written.
+    */
+    template<typename T, typename Op, typename In, typename Out>
+    void runningWindow(In in, Out out, int L, int k, int width, T* h, T* g, Op op)
+    {
+        for (int i = L - 1; i >= 0; i--)
+        {
+            const T* p = in(i);
+            T* hi = h + static_cast<size_t>(i) * width;
+            if (i % k == k - 1 || i == L - 1)
+            {
+                std::copy(p, p + width, hi);
+            }
+            else
+            {
+                const T* next = hi + width;
+                for (int c = 0; c < width; c++)
+                {
+                    hi[c] = op(p[c], next[c]);
+                }
+            }
+        }
+
+        for (int i = 0; i < L; i++)
+        {
+            const T* p = in(i);
+            if (i % k == 0)
+            {
+                std::copy(p, p + width, g);
+            }
+            else
+            {
+                for (int c = 0; c < width; c++)
+                {
+                    g[c] = op(g[c], p[c]);
+                }
+            }
+
+            if (i >= k - 1)
+            {
+                const T* hx = h + static_cast<size_t>(i - k + 1) * width;
+                T* o = out(i - k + 1);
+                for (int c = 0; c < width; c++)
+                {
+                    o[c] = op(hx[c], g[c]);
+                }
+            }
+        }
+    }
+
+    template<typename T, typename Op>
+    void horizontalPass(const Mat& src, Mat& dst, Span s, Op op)
+    {
+        const int cols = src.cols;
+        const int cn = src.channels();
+        const int k = s.length();
+        const int L = cols + k - 1;
+
+        cv::parallel_for_(cv::Range(0, src.rows), [&](const cv::Range& range)
+        {
+            // row shifted by s.lo, the ends keep the neutral value
+            std::vector<T> row(static_cast<size_t>(L) * cn, Op::neutral());
+            std::vector<T> h(static_cast<size_t>(L) * cn);
+            std::vector<T> g(cn);
+            T* shifted = row.data() + static_cast<size_t>(-s.lo) * cn;
+
+            for (int y = range.start; y < range.end; y++)
+            {
+                const T* in = src.ptr<T>(y);
+                std::copy(in, in + static_cast<size_t>(cols) * cn, shifted);
+
+                T* out = dst.ptr<T>(y);
+                runningWindow(  [&](int i) { return row.data() + static_cast<size_t>(i) * cn; },
+                                [&](int x) { return out + static_cast<size_t>(x) * cn; },
+                                L, k, cn, h.data(), g.data(), op);
+            }
+        });
+    }
+
+    template<typename T, typename Op>
+    void verticalPass(const Mat& src, Mat& dst, Span s, Op op)
+    {
+        const int rows = src.rows;
+        const int values = src.cols * src.channels();
+        const int k = s.length();
+        const int L = rows + k - 1;
+        const int strips = (values + strip_width - 1) / strip_width;
+
+        cv::parallel_for_(cv::Range(0, strips), [&](const cv::Range& range)
+        {
+            std::vector<T> neutral(strip_width, Op::neutral());
+            std::vector<T> h(static_cast<size_t>(L) * strip_width);
+            std::vector<T> g(strip_width);
+
+            for (int strip = range.start; strip < range.end; strip++)
+            {
+                const int c0 = strip * strip_width;
+                const int width = std::min(strip_width, values - c0);
+
+                // rows are the vectors, the whole strip moves at once
+                runningWindow(  [&](int i)
+                                {
+                                    const int y = i + s.lo;
+                                    return (y >= 0 && y < rows) ? src.ptr<T>(y) + c0 : neutral.data();
+                                },
+                                [&](int y) { return dst.ptr<T>(y) + c0; },
+                                L, k, width, h.data(), g.data(), op);
+            }
+        });
+    }
+
+    /*
+    *   Window along the diagonals (x + t, y + t) when dir is 1
+    *   or (x + t, y - t) when dir is -1
+    */
+    template<typename T, typename Op>
+    void diagonalPass(const Mat& src, Mat& dst, Span s, int dir, Op op)
+    {
+        const int rows = src.rows;
+        const int cols = src.cols;
+        const int cn = src.channels();
+        const int k = s.length();
+        const int diagonals = rows + cols - 1;
+
+        cv::parallel_for_(cv::Range(0, diagonals), [&](const cv::Range& range)
+        {
+            const int max_length = std::min(rows, cols);
+            std::vector<T> line(static_cast<size_t>(max_length + k - 1) * cn);
+            std::vector<T> h(line.size());
+            std::vector<T> g(cn);
+
+            for (int d = range.start; d < range.end; d++)
+            {
+                // first pixel on the left column, then on the first (last) row
+                const int x0 = (d < rows) ? 0 : d - rows + 1;
+                int y0 = 0;
+                int n = 0;
+                if (dir > 0)
+                {
+                    y0 = (d < rows) ? rows - 1 - d : 0;
+                    n = std::min(cols - x0, rows - y0);
+                }
+                else
+                {
+                    y0 = (d < rows) ? d : rows - 1;
+                    n = std::min(cols - x0, y0 + 1);
+                }
+
+                const int L = n + k - 1;
+                std::fill(line.begin(), line.begin() + static_cast<size_t>(L) * cn, Op::neutral());
+                for (int i = 0; i < n; i++)
+                {
+                    const T* p = src.ptr<T>(y0 + dir * i) + static_cast<size_t>(x0 + i) * cn;
+                    std::copy(p, p + cn, line.data() + static_cast<size_t>(i - s.lo) * cn);
+                }
+
+                runningWindow(  [&](int i) { return line.data() + static_cast<size_t>(i) * cn; },
+                                [&](int i) { return dst.ptr<T>(y0 + dir * i) + static_cast<size_t>(x0 + i) * cn; },
+                                L, k, cn, h.data(), g.data(), op);
+            }
+        });
+    }
+
+    template<typename T, typename Op>
+    void rectPass(const Mat& src, Mat& dst, Span sx, Span sy, Op op)
+    {
+        dst.create(src.size(), src.type());
+
+        if (sx.identity() == false)
+        {
+            horizontalPass<T>(src, dst, sx, op);
+            if (sy.identity() == false)
+            {
+                verticalPass<T>(dst, dst, sy, op);
+            }
+        }
+        else if (sy.identity() == false)
+        {
+            verticalPass<T>(src, dst, sy, op);
+        }
+        else if (src.data != dst.data)
+        {
+            src.copyTo(dst);
+        }
+    }
+
+    /*
+    *   Diamond of radius r in an image that already has a border of r pixels
+    *
+    *   two diagonal lines of 2a + 1 pixels give the pixels of the diamond of
+    *   radius 2a with x + y even, one 3x3 cross fills the other ones and
+    *   grows the radius to 2a + 1, a second cross gives the even radius
+    */
+    template<typename T, typename Op>
+    void diamondPass(const Mat& src, Mat& dst, int r, Op op)
+    {
+        dst.create(src.size(), src.type());
+        if (r == 0)
+        {
+            if (src.data != dst.data)
+            {
+                src.copyTo(dst);
+            }
+            return;
+        }
+
+        const int crosses = (r % 2 == 1) ? 1 : 2;
+        const int a = (r - crosses) / 2;
+
+        Mat from = src;
+        if (a > 0)
+        {
+            diagonalPass<T>(src, dst, Span{ -a, a }, 1, op);
+            diagonalPass<T>(dst, dst, Span{ -a, a }, -1, op);
+            from = dst;
+        }
+
+        const Mat cross = getStructuringElement(MORPH_CROSS, Size(3, 3));
+        if (Op::dilate)
+        {
+            cv::dilate(from, dst, cross, Point(-1, -1), crosses);
+        }
+        else
+        {
+            cv::erode(from, dst, cross, Point(-1, -1), crosses);
+        }
+    }
+
+    /*
+    *   The decomposition needs the intermediate results around the image
+    *   too, so it runs on a copy with a neutral border of the element radius
+    */
+    template<typename T, typename Op>
+    void decomposedPass(const Mat& src, Mat& dst, int square, int diamond, Op op)
+    {
+        const int r = square + diamond;
+        Mat padded;
+        copyMakeBorder(src, padded, r, r, r, r, BORDER_CONSTANT, Scalar::all(static_cast<double>(Op::neutral())));
+
+        rectPass<T>(padded, padded, Span{ -square, square }, Span{ -square, square }, op);
+        diamondPass<T>(padded, padded, diamond, op);
+
+        padded(cv::Rect(r, r, src.cols, src.rows)).copyTo(dst);
+    }
+
+    /*
+    *   Cross and Ellipse: every row of the mask is one run, the rows holding
+    *   a run form a rectangle and the element is the union of them
+    */
+    template<typename T, typename Op>
+    void unionPass(const Mat& src, Mat& dst, const Element& e, int iterations, Op op)
+    {
+        const Mat mask = getMask(e);
+        const int ax = mask.cols / 2;
+        const int ay = mask.rows / 2;
+
+        std::vector<Span> runs(mask.rows, Span{ mask.cols, -1 });
+        for (int y = 0; y < mask.rows; y++)
+        {
+            const uchar* m = mask.ptr<uchar>(y);
+            for (int x = 0; x < mask.cols; x++)
+            {
+                if (m[x])
+                {
+                    runs[y].lo = std::min(runs[y].lo, x);
+                    runs[y].hi = std::max(runs[y].hi, x);
+                }
+            }
+        }
+
+        std::vector<std::pair<Span, Span> > rects;
+        for (int y = 0; y < mask.rows; y++)
+        {
+            const Span run = runs[y];
+            if (run.length() <= 0)
+            {
+                continue;
+            }
+
+            bool seen = false;
+            for (const auto& r : rects)
+            {
+                seen = seen || (r.first.lo == run.lo - ax && r.first.hi == run.hi - ax);
+            }
+            if (seen)
+            {
+                continue;
+            }
+
+            int y0 = y;
+            int y1 = y;
+            while (y0 > 0 && runs[y0 - 1].lo <= run.lo && runs[y0 - 1].hi >= run.hi)
+            {
+                y0--;
+            }
+            while (y1 < mask.rows - 1 && runs[y1 + 1].lo <= run.lo && runs[y1 + 1].hi >= run.hi)
+            {
+                y1++;
+            }
+            rects.emplace_back(Span{ run.lo - ax, run.hi - ax }, Span{ y0 - ay, y1 - ay });
+        }
+
+        Mat current = src;
+        for (int it = 0; it < iterations; it++)
+        {
+            Mat acc;
+            Mat tmp;
+            for (size_t i = 0; i < rects.size(); i++)
+            {
+                if (i == 0)
+                {
+                    rectPass<T>(current, acc, rects[i].first, rects[i].second, op);
+                }
+                else
+                {
+                    rectPass<T>(current, tmp, rects[i].first, rects[i].second, op);
+                    Op::combine(tmp, acc);
+                }
+            }
+            current = acc;
+        }
+        dst = current;
+    }
+
+    template<typename T, typename Op>
+    void apply(const Mat& src, Mat& dst, const Element& e, int n, Op op)
+    {
+        const int r = std::max(0, e.size.width / 2);
+
+        switch (e.shape)
+        {
+        case Shape::Rect:
+            rectPass<T>(src, dst, centered(e.size.width, n), centered(e.size.height, n), op);
+            break;
+        case Shape::HorizontalLine:
+            rectPass<T>(src, dst, centered(e.size.width, n), Span{ 0, 0 }, op);
+            break;
+        case Shape::VerticalLine:
+            rectPass<T>(src, dst, Span{ 0, 0 }, centered(e.size.height, n), op);
+            break;
+        case Shape::Diamond:
+            decomposedPass<T>(src, dst, 0, n * r, op);
+            break;
+        case Shape::Octagon:
+            decomposedPass<T>(src, dst, n * ((r + 1) / 2), n * (r / 2), op);
+            break;
+        default:
+            if (e.size == Size(3, 3) && e.shape == Shape::Cross)
+            {
+                // the 3x3 cross is the diamond of radius 1
+                decomposedPass<T>(src, dst, 0, n, op);
+            }
+            else
+            {
+                unionPass<T>(src, dst, e, n, op);
+            }
+            break;
+        }
+    }
+
+    template<template<typename> class Op>
+    void applyDepth(const Mat& src, Mat& dst, const Element& e, int iterations)
+    {
+        if (src.empty() || iterations <= 0 || e.size.width <= 0 || e.size.height <= 0)
+        {
+            if (src.data != dst.data)
+            {
+                src.copyTo(dst);
+            }
+            return;
+        }
+
+        switch (src.depth())
+        {
+        case CV_8U: apply<uchar>(src, dst, e, iterations, Op<uchar>()); break;
+        case CV_8S: apply<schar>(src, dst, e, iterations, Op<schar>()); break;
+        case CV_16U: apply<ushort>(src, dst, e, iterations, Op<ushort>()); break;
+        case CV_16S: apply<short>(src, dst, e, iterations, Op<short>()); break;
+        case CV_32S: apply<int>(src, dst, e, iterations, Op<int>()); break;
+        case CV_32F: apply<float>(src, dst, e, iterations, Op<float>()); break;
+        case CV_64F: apply<double>(src, dst, e, iterations, Op<double>()); break;
+        default:
+            if (Op<uchar>::dilate)
+            {
+                cv::dilate(src, dst, getMask(e), Point(-1, -1), iterations);
+            }
+            else
+            {
+                cv::erode(src, dst, getMask(e), Point(-1, -1), iterations);
+            }
+            break;
+        }
+    }
+
+    /*
+    *   Erosion or dilation by a rectangle as a stream of rows: every row
+    *   pushed is filtered along x and goes into the running window along y,
+    *   which keeps the rows of the current block of ky rows and the suffixes
+    *   of the previous one. A row comes out once its window is complete,
+    *   hi rows after it went in; nullptr pushes the neutral rows after the
+    *   last one until done().
+    */
+    template<typename T, typename Op>
+    class CRowStream final
+    {
+    public:
+
+        CRowStream(int rows, int cols, int cn, Span sx, Span sy)
+            :cn(cn), values(cols * cn), sx(sx), kx(sx.length()), ky(sy.length())
+        {
+            L = rows + ky - 1;
+            Lx = cols + kx - 1;
+
+            row.assign(static_cast<size_t>(Lx) * cn, Op::neutral());
+            hx.resize(static_cast<size_t>(Lx) * cn);
+            gx.resize(cn);
+            neutral.assign(values, Op::neutral());
+            current.resize(static_cast<size_t>(ky) * values);
+            previous.resize(static_cast<size_t>(ky) * values);
+            g.resize(values);
+            out.resize(values);
+
+            // the rows above the first one
+            for (int j = 0; j < -sy.lo; j++)
+            {
+                step(neutral.data());
+            }
+        }
+
+        const T* push(const T* in)
+        {
+            if (in == nullptr)
+            {
+                return step(neutral.data());
+            }
+
+            T* filtered = current.data() + static_cast<size_t>(i % ky) * values;
+            if (kx == 1)
+            {
+                std::copy(in, in + values, filtered);
+            }
+            else
+            {
+                std::copy(in, in + values, row.data() + static_cast<size_t>(-sx.lo) * cn);
+                runningWindow(  [&](int x) { return row.data() + static_cast<size_t>(x) * cn; },
+                                [&](int x) { return filtered + static_cast<size_t>(x) * cn; },
+                                Lx, kx, cn, hx.data(), gx.data(), Op());
+            }
+            return step(filtered);
+        }
+
+        bool done() const { return i == L; };
+
+    private:
+
+        const T* step(const T* p)
+        {
+            const int pos = i % ky;
+            T* slot = current.data() + static_cast<size_t>(pos) * values;
+            if (p != slot)
+            {
+                std::copy(p, p + values, slot);
+            }
+
+            if (pos == 0)
+            {
+                std::copy(p, p + values, g.begin());
+            }
+            else
+            {
+                for (int c = 0; c < values; c++)
+                {
+                    g[c] = op(g[c], p[c]);
+                }
+            }
+
+            // end of a block: suffixes in place, they serve the next block
+            // (no row comes out of the suffixes of a last incomplete block)
+            if (pos == ky - 1)
+            {
+                for (int j = pos - 1; j >= 0; j--)
+                {
+                    T* s = current.data() + static_cast<size_t>(j) * values;
+                    const T* next = s + values;
+                    for (int c = 0; c < values; c++)
+                    {
+                        s[c] = op(s[c], next[c]);
+                    }
+                }
+                std::swap(current, previous);
+            }
+
+            const T* result = nullptr;
+            if (i >= ky - 1)
+            {
+                const T* h = previous.data() + static_cast<size_t>((i - ky + 1) % ky) * values;
+                for (int c = 0; c < values; c++)
+                {
+                    out[c] = op(h[c], g[c]);
+                }
+                result = out.data();
+            }
+            i++;
+            return result;
+        }
+
+        Op op;
+        int cn;
+        int values;
+        Span sx;
+        int kx;
+        int ky;
+        int L = 0;
+        int Lx = 0;
+        int i = 0;
+
+        std::vector<T> row;
+        std::vector<T> hx;
+        std::vector<T> gx;
+        std::vector<T> neutral;
+        std::vector<T> current;
+        std::vector<T> previous;
+        std::vector<T> g;
+        std::vector<T> out;
+    };
+
+    /*
+    *   Pushes the rows [a, b) through first and its output through second,
+    *   emit(y, row) gets every row of the result
+    */
+    template<typename T, typename S1, typename S2, typename In, typename Emit>
+    void chainStreams(S1& first, S2& second, In in, int a, int b, Emit emit)
+    {
+        int y_out = a;
+        auto feed = [&](const T* r)
+        {
+            if (r != nullptr)
+            {
+                const T* s = second.push(r);
+                if (s != nullptr)
+                {
+                    emit(y_out++, s);
+                }
+            }
+        };
+
+        for (int y = a; y < b; y++)
+        {
+            feed(first.push(in(y)));
+        }
+        while (first.done() == false)
+        {
+            feed(first.push(nullptr));
+        }
+        while (second.done() == false)
+        {
+            const T* s = second.push(nullptr);
+            if (s != nullptr)
+            {
+                emit(y_out++, s);
+            }
+        }
+    }
+
+    /*
+    *   Open, close, gradient and top-hats by a rectangle in one pass over the
+    *   rows, written once into dst. The image is cut in bands of rows run in
+    *   parallel, each band reads the rows around it that its windows need;
+    *   when dst is src those rows are copied before any band writes.
+    */
+    template<typename T>
+    void streamMorphology(const Mat& src, Mat& dst, Operation operation, Span sx, Span sy)
+    {
+        const int rows = src.rows;
+        const int cols = src.cols;
+        const int cn = src.channels();
+        const int values = cols * cn;
+        const bool in_place = (src.data == dst.data);
+
+        const bool single = (operation == Operation::Gradient);
+        const int above = single ? -sy.lo : -2 * sy.lo;
+        const int below = single ? sy.hi : 2 * sy.hi;
+
+        const int min_band = std::max(64, 4 * (above + below));
+        const int bands = std::max(1, std::min(cv::getNumThreads(), rows / min_band));
+
+        struct Band
+        {
+            int y0;
+            int y1;
+            int a;
+            int b;
+            std::vector<T> halo;
+        };
+
+        std::vector<Band> parts(bands);
+        for (int i = 0; i < bands; i++)
+        {
+            Band& band = parts[i];
+            band.y0 = static_cast<int>(static_cast<int64_t>(rows) * i / bands);
+            band.y1 = static_cast<int>(static_cast<int64_t>(rows) * (i + 1) / bands);
+            band.a = std::max(0, band.y0 - above);
+            band.b = std::min(rows, band.y1 + below);
+        }
+
+        if (in_place && bands > 1)
+        {
+            cv::parallel_for_(cv::Range(0, bands), [&](const cv::Range& range)
+            {
+                for (int i = range.start; i < range.end; i++)
+                {
+                    Band& band = parts[i];
+                    band.halo.resize(static_cast<size_t>(band.y0 - band.a + band.b - band.y1) * values);
+                    T* h = band.halo.data();
+                    for (int y = band.a; y < band.b; y++)
+                    {
+                        if (y < band.y0 || y >= band.y1)
+                        {
+                            const T* p = src.ptr<T>(y);
+                            h = std::copy(p, p + values, h);
+                        }
+                    }
+                }
+            });
+        }
+
+        dst.create(src.size(), src.type());
+
+        cv::parallel_for_(cv::Range(0, bands), [&](const cv::Range& range)
+        {
+            for (int i = range.start; i < range.end; i++)
+            {
+                const Band& band = parts[i];
+                const int n = band.b - band.a;
+
+                auto in = [&](int y) -> const T*
+                {
+                    if (band.halo.empty() || (y >= band.y0 && y < band.y1))
+                    {
+                        return src.ptr<T>(y);
+                    }
+                    const int k = (y < band.y0) ? y - band.a : (band.y0 - band.a) + (y - band.y1);
+                    return band.halo.data() + static_cast<size_t>(k) * values;
+                };
+
+                auto store = [&](int y, auto value)
+                {
+                    if (y >= band.y0 && y < band.y1)
+                    {
+                        T* d = dst.ptr<T>(y);
+                        for (int c = 0; c < values; c++)
+                        {
+                            d[c] = value(c);
+                        }
+                    }
+                };
+
+                CRowStream<T, MinOp<T> > erosion(n, cols, cn, sx, sy);
+                CRowStream<T, MaxOp<T> > dilation(n, cols, cn, sx, sy);
+
+                switch (operation)
+                {
+                case Operation::Open:
+                    chainStreams<T>(erosion, dilation, in, band.a, band.b, [&](int y, const T* r)
+                    {
+                        store(y, [&](int c) { return r[c]; });
+                    });
+                    break;
+                case Operation::Close:
+                    chainStreams<T>(dilation, erosion, in, band.a, band.b, [&](int y, const T* r)
+                    {
+                        store(y, [&](int c) { return r[c]; });
+                    });
+                    break;
+                case Operation::TopHat:
+                    chainStreams<T>(erosion, dilation, in, band.a, band.b, [&](int y, const T* r)
+                    {
+                        const T* s = in(y);
+                        store(y, [&](int c) { return saturate_cast<T>(static_cast<double>(s[c]) - r[c]); });
+                    });
+                    break;
+                case Operation::BlackHat:
+                    chainStreams<T>(dilation, erosion, in, band.a, band.b, [&](int y, const T* r)
+                    {
+                        const T* s = in(y);
+                        store(y, [&](int c) { return saturate_cast<T>(static_cast<double>(r[c]) - s[c]); });
+                    });
+                    break;
+                default:
+                {
+                    // same element, both streams give their rows together
+                    int y_out = band.a;
+                    auto emit = [&](const T* lo, const T* hi)
+                    {
+                        if (lo != nullptr && hi != nullptr)
+                        {
+                            store(y_out++, [&](int c) { return saturate_cast<T>(static_cast<double>(hi[c]) - lo[c]); });
+                        }
+                    };
+                    for (int y = band.a; y < band.b; y++)
+                    {
+                        const T* p = in(y);
+                        emit(erosion.push(p), dilation.push(p));
+                    }
+                    while (erosion.done() == false)
+                    {
+                        emit(erosion.push(nullptr), dilation.push(nullptr));
+                    }
+                    break;
+                }
+                }
+            }
+        });
+    }
+
+    /*
+    *   Other elements: erosion and dilation one after the other
+    */
+    void composeMorphology(const Mat& src, Mat& dst, Operation operation, const Element& e, int iterations)
+    {
+        Mat first;
+        switch (operation)
+        {
+        case Operation::Open:
+            erode(src, first, e, iterations);
+            dilate(first, dst, e, iterations);
+            break;
+        case Operation::Close:
+            dilate(src, first, e, iterations);
+            erode(first, dst, e, iterations);
+            break;
+        case Operation::Gradient:
+            erode(src, first, e, iterations);
+            dilate(src, dst, e, iterations);
+            subtract(dst, first, dst);
+            break;
+        case Operation::TopHat:
+            erode(src, first, e, iterations);
+            dilate(first, first, e, iterations);
+            subtract(src, first, dst);
+            break;
+        case Operation::BlackHat:
+            dilate(src, first, e, iterations);
+            erode(first, first, e, iterations);
+            subtract(first, src, dst);
+            break;
+        }
+    }
+
+    Shape fromMorphShape(int morph_shape)
+    {
+        switch (morph_shape)
+        {
+        case MORPH_CROSS: return Shape::Cross;
+        case MORPH_ELLIPSE: return Shape::Ellipse;
+        default: return Shape::Rect;
+        }
+    }
+
+    Mat getMask(const Element& e)
+    {
+        const int r = std::max(0, e.size.width / 2);
+
+        switch (e.shape)
+        {
+        case Shape::Cross:
+            return getStructuringElement(MORPH_CROSS, e.size);
+        case Shape::Ellipse:
+            return getStructuringElement(MORPH_ELLIPSE, e.size);
+        case Shape::HorizontalLine:
+            return Mat::ones(1, e.size.width, CV_8U);
+        case Shape::VerticalLine:
+            return Mat::ones(e.size.height, 1, CV_8U);
+        case Shape::Diamond:
+        case Shape::Octagon:
+        {
+            // octagon: points at L1 distance <= b of the square of half side a
+            const int a = (e.shape == Shape::Octagon) ? (r + 1) / 2 : 0;
+            const int b = r - a;
+            Mat mask(2 * r + 1, 2 * r + 1, CV_8U);
+            for (int y = -r; y <= r; y++)
+            {
+                for (int x = -r; x <= r; x++)
+                {
+                    const int d = std::max(std::abs(x) - a, 0) + std::max(std::abs(y) - a, 0);
+                    mask.at<uchar>(y + r, x + r) = (d <= b) ? 1 : 0;
+                }
+            }
+            return mask;
+        }
+        default:
+            return getStructuringElement(MORPH_RECT, e.size);
+        }
+    }
+
+    void erode(const Mat& src, Mat& dst, const Element& e, int iterations)
+    {
+        applyDepth<MinOp>(src, dst, e, iterations);
+    }
+
+    void dilate(const Mat& src, Mat& dst, const Element& e, int iterations)
+    {
+        applyDepth<MaxOp>(src, dst, e, iterations);
+    }
+
+    void morphologyEx(const Mat& src, Mat& dst, Operation operation, const Element& e, int iterations)
+    {
+        const bool rect =   e.shape == Shape::Rect ||
+                            e.shape == Shape::HorizontalLine ||
+                            e.shape == Shape::VerticalLine;
+
+        if (src.empty() || iterations <= 0 || rect == false)
+        {
+            composeMorphology(src, dst, operation, e, iterations);
+            return;
+        }
+
+        const Span sx = (e.shape == Shape::VerticalLine) ? Span{ 0, 0 } : centered(e.size.width, iterations);
+        const Span sy = (e.shape == Shape::HorizontalLine) ? Span{ 0, 0 } : centered(e.size.height, iterations);
+
+        switch (src.depth())
+        {
+        case CV_8U: streamMorphology<uchar>(src, dst, operation, sx, sy); break;
+        case CV_8S: streamMorphology<schar>(src, dst, operation, sx, sy); break;
+        case CV_16U: streamMorphology<ushort>(src, dst, operation, sx, sy); break;
+        case CV_16S: streamMorphology<short>(src, dst, operation, sx, sy); break;
+        case CV_32S: streamMorphology<int>(src, dst, operation, sx, sy); break;
+        case CV_32F: streamMorphology<float>(src, dst, operation, sx, sy); break;
+        case CV_64F: streamMorphology<double>(src, dst, operation, sx, sy); break;
+        default: composeMorphology(src, dst, operation, e, iterations); break;
+        }
+    }
+
+    /*-------------------------------------------------------------------------------------------
+    *   Reconstruction
+    ---------------------------------------------------------------------------------------------*/
+
+    // the marker grows up to the mask
+    template<typename T>
+    struct DilationOrder
+    {
+        static T up(T a, T b) { return std::max(a, b); };
+        static T clip(T a, T mask) { return std::min(a, mask); };
+        static bool below(T a, T b) { return a < b; };
+    };
+
+    // the marker shrinks down to the mask
+    template<typename T>
+    struct ErosionOrder
+    {
+        static T up(T a, T b) { return std::min(a, b); };
+        static T clip(T a, T mask) { return std::max(a, mask); };
+        static bool below(T a, T b) { return a > b; };
+    };
+
+    /*
+    *   J holds the marker and gets the result, both continuous and one channel
+    */
+    template<typename T, typename Order>
+    void reconstruct(Mat& J, const Mat& I, int connectivity)
+    {
+        const int w = J.cols;
+        const int h = J.rows;
+        T* j = J.ptr<T>();
+        const T* m = I.ptr<T>();
+
+        // neighbours before the pixel in raster order, the others are the opposite ones
+        const int dx8[] = { -1, 0, 1, -1 };
+        const int dy8[] = { -1, -1, -1, 0 };
+        const int dx4[] = { 0, -1 };
+        const int dy4[] = { -1, 0 };
+        const int n = (connectivity == 4) ? 2 : 4;
+        const int* dx = (connectivity == 4) ? dx4 : dx8;
+        const int* dy = (connectivity == 4) ? dy4 : dy8;
+
+        auto inside = [&](int x, int y) { return x >= 0 && x < w && y >= 0 && y < h; };
+
+        for (size_t p = 0; p < J.total(); p++)
+        {
+            j[p] = Order::clip(j[p], m[p]);
+        }
+
+        for (int y = 0; y < h; y++)
+        {
+            for (int x = 0; x < w; x++)
+            {
+                const size_t p = static_cast<size_t>(y) * w + x;
+                T v = j[p];
+                for (int k = 0; k < n; k++)
+                {
+                    if (inside(x + dx[k], y + dy[k]))
+                    {
+                        v = Order::up(v, j[p + dy[k] * w + dx[k]]);
+                    }
+                }
+                j[p] = Order::clip(v, m[p]);
+            }
+        }
+
+        std::queue<size_t> fifo;
+        for (int y = h - 1; y >= 0; y--)
+        {
+            for (int x = w - 1; x >= 0; x--)
+            {
+                const size_t p = static_cast<size_t>(y) * w + x;
+                T v = j[p];
+                for (int k = 0; k < n; k++)
+                {
+                    if (inside(x - dx[k], y - dy[k]))
+                    {
+                        v = Order::up(v, j[p - dy[k] * w - dx[k]]);
+                    }
+                }
+                v = Order::clip(v, m[p]);
+                j[p] = v;
+
+                // a neighbour after p could still grow from p
+                for (int k = 0; k < n; k++)
+                {
+                    if (inside(x - dx[k], y - dy[k]))
+                    {
+                        const size_t q = p - dy[k] * w - dx[k];
+                        if (Order::below(j[q], v) && Order::below(j[q], m[q]))
+                        {
+                            fifo.push(p);
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+
+        while (fifo.empty() == false)
+        {
+            const size_t p = fifo.front();
+            fifo.pop();
+            const int x = static_cast<int>(p % w);
+            const int y = static_cast<int>(p / w);
+            const T v = j[p];
+
+            for (int k = 0; k < 2 * n; k++)
+            {
+                const int ddx = (k < n) ? dx[k] : -dx[k - n];
+                const int ddy = (k < n) ? dy[k] : -dy[k - n];
+                if (inside(x + ddx, y + ddy))
+                {
+                    const size_t q = p + ddy * w + ddx;
+                    if (Order::below(j[q], v) && j[q] != m[q])
+                    {
+                        j[q] = Order::clip(v, m[q]);
+                        fifo.push(q);
+                    }
+                }
+            }
+        }
+    }
+
+    template<template<typename> class Order>
+    void reconstructChannel(const Mat& marker, const Mat& mask, Mat& dst, int connectivity)
+    {
+        Mat J = marker.clone();
+        const Mat I = mask.isContinuous() ? mask : mask.clone();
+
+        switch (J.depth())
+        {
+        case CV_8U: reconstruct<uchar, Order<uchar> >(J, I, connectivity); break;
+        case CV_8S: reconstruct<schar, Order<schar> >(J, I, connectivity); break;
+        case CV_16U: reconstruct<ushort, Order<ushort> >(J, I, connectivity); break;
+        case CV_16S: reconstruct<short, Order<short> >(J, I, connectivity); break;
+        case CV_32S: reconstruct<int, Order<int> >(J, I, connectivity); break;
+        case CV_32F: reconstruct<float, Order<float> >(J, I, connectivity); break;
+        case CV_64F: reconstruct<double, Order<double> >(J, I, connectivity); break;
+        default:
+        {
+            Mat J32;
+            Mat I32;
+            J.convertTo(J32, CV_32F);
+            I.convertTo(I32, CV_32F);
+            reconstruct<float, Order<float> >(J32, I32, connectivity);
+            J32.convertTo(J, J.type());
+            break;
+        }
+        }
+        dst = J;
+    }
+
+    template<template<typename> class Order>
+    void reconstructAll(const Mat& marker, const Mat& mask, Mat& dst, int connectivity)
+    {
+        if (marker.empty() || marker.size() != mask.size() || marker.type() != mask.type())
+        {
+            dst = Mat();
+            return;
+        }
+
+        if (marker.channels() == 1)
+        {
+            reconstructChannel<Order>(marker, mask, dst, connectivity);
+            return;
+        }
+
+        std::vector<Mat> markers;
+        std::vector<Mat> masks;
+        split(marker, markers);
+        split(mask, masks);
+        for (size_t c = 0; c < markers.size(); c++)
+        {
+            reconstructChannel<Order>(markers[c], masks[c], markers[c], connectivity);
+        }
+        merge(markers, dst);
+    }
+
+    void reconstructByDilation(const Mat& marker, const Mat& mask, Mat& dst, int connectivity)
+    {
+        reconstructAll<DilationOrder>(marker, mask, dst, connectivity);
+    }
+
+    void reconstructByErosion(const Mat& marker, const Mat& mask, Mat& dst, int connectivity)
+    {
+        reconstructAll<ErosionOrder>(marker, mask, dst, connectivity);
+    }
+
+    void fillHoles(const Mat& src, Mat& dst, int connectivity)
+    {
+        if (src.empty())
+        {
+            dst = Mat();
+            return;
+        }
+
+        // the border keeps its values, every other pixel starts at the maximum
+        double max_value = 0;
+        minMaxLoc(src.reshape(1), nullptr, &max_value);
+        Mat marker(src.size(), src.type(), Scalar::all(max_value));
+        const int last_row = src.rows - 1;
+        const int last_col = src.cols - 1;
+        src.row(0).copyTo(marker.row(0));
+        src.row(last_row).copyTo(marker.row(last_row));
+        src.col(0).copyTo(marker.col(0));
+        src.col(last_col).copyTo(marker.col(last_col));
+
+        reconstructByErosion(marker, src, dst, connectivity);
+    }
+
+    void hMaxima(const Mat& src, Mat& dst, double h, int connectivity)
+    {
+        Mat marker;
+        subtract(src, Scalar::all(h), marker);
+        reconstructByDilation(marker, src, dst, connectivity);
+    }
+
+    void hMinima(const Mat& src, Mat& dst, double h, int connectivity)
+    {
+        Mat marker;
+        add(src, Scalar::all(h), marker);
+        reconstructByErosion(marker, src, dst, connectivity);
+    }
+
+    /*
+    *   The closest value below (above) every pixel: a plateau comes back to
+    *   its value unless it is a regional extremum
+    */
+    template<typename T>
+    void shiftValues(const Mat& src, Mat& dst, bool down)
+    {
+        dst.create(src.size(), src.type());
+        for (int y = 0; y < src.rows; y++)
+        {
+            const T* s = src.ptr<T>(y);
+            T* d = dst.ptr<T>(y);
+            for (int x = 0; x < src.cols * src.channels(); x++)
+            {
+                if (std::numeric_limits<T>::is_integer)
+                {
+                    d[x] = down ? saturate_cast<T>(static_cast<double>(s[x]) - 1) : saturate_cast<T>(static_cast<double>(s[x]) + 1);
+                }
+                else
+                {
+                    d[x] = std::nextafter(s[x], down ? std::numeric_limits<T>::lowest() : std::numeric_limits<T>::max());
+                }
+            }
+        }
+    }
+
+    void regionalExtrema(const Mat& src, Mat& dst, int connectivity, bool maxima)
+    {
+        if (src.empty())
+        {
+            dst = Mat();
+            return;
+        }
+
+        Mat values = src;
+        if (src.depth() != CV_8U && src.depth() != CV_16U && src.depth() != CV_16S &&
+            src.depth() != CV_32S && src.depth() != CV_32F && src.depth() != CV_64F)
+        {
+            src.convertTo(values, CV_32F);
+        }
+
+        Mat marker;
+        switch (values.depth())
+        {
+        case CV_8U: shiftValues<uchar>(values, marker, maxima); break;
+        case CV_16U: shiftValues<ushort>(values, marker, maxima); break;
+        case CV_16S: shiftValues<short>(values, marker, maxima); break;
+        case CV_32S: shiftValues<int>(values, marker, maxima); break;
+        case CV_32F: shiftValues<float>(values, marker, maxima); break;
+        default: shiftValues<double>(values, marker, maxima); break;
+        }
+
+        Mat rec;
+        if (maxima)
+        {
+            reconstructByDilation(marker, values, rec, connectivity);
+        }
+        else
+        {
+            reconstructByErosion(marker, values, rec, connectivity);
+        }
+        compare(values, rec, dst, maxima ? CMP_GT : CMP_LT);
+    }
+
+    void regionalMaxima(const Mat& src, Mat& dst, int connectivity)
+    {
+        regionalExtrema(src, dst, connectivity, true);
+    }
+
+    void regionalMinima(const Mat& src, Mat& dst, int connectivity)
+    {
+        regionalExtrema(src, dst, connectivity, false);
+    }
+
+    void openingByReconstruction(const Mat& src, Mat& dst, const Element& e, int connectivity)
+    {
+        Mat eroded;
+        erode(src, eroded, e);
+        reconstructByDilation(eroded, src, dst, connectivity);
+    }
+
+    std::vector<double> granulometry(const Mat& src, int max_radius, Shape shape, bool by_reconstruction)
+    {
+        std::vector<double> spectrum;
+        if (src.empty() || max_radius <= 0)
+        {
+            return spectrum;
+        }
+
+        auto volume = [](const Mat& img)
+        {
+            const Scalar s = sum(img);
+            return s[0] + s[1] + s[2] + s[3];
+        };
+
+        // the cost of an opening does not depend on the radius
+        double previous = volume(src);
+        for (int r = 1; r <= max_radius; r++)
+        {
+            const Element e(shape, 2 * r + 1);
+            Mat opened;
+            if (by_reconstruction)
+            {
+                openingByReconstruction(src, opened, e);
+            }
+            else
+            {
+                morphologyEx(src, opened, Operation::Open, e);
+            }
+
+            const double current = volume(opened);
+            spectrum.push_back(previous - current);
+            previous = current;
+        }
+        return spectrum;
+    }
+}
@@ -0,0 +1,141 @@
+//--------------------------------------------------------------------------------------------------
+// Erosion and dilation with a cost per pixel that does not depend on the size of the
+// structuring element: van Herk/Gil-Werman for rectangles and lines, decomposition
+// for diamonds and octagons
+// M. van Herk, "A fast algorithm for local minimum and maximum filters on rectangular
+// and octagonal kernels", Pattern Recognition Letters 13 (1992)
+// J. Gil, M. Werman, "Computing 2-D min, median, and max filters", IEEE PAMI 15 (1993)
+// author: Daniel Vasconcelos Gomes 2023
+// if an external code has been used I indicate the sources
+//--------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "image_util.h"
+#include <vector>
+
+namespace morphology
+{
+	enum class Shape
+	{
+		Rect,
+		Cross,
+		Ellipse,
+		HorizontalLine,
+		VerticalLine,
+		Diamond,
+		Octagon
+	};
+
+	/*
+	*	Structuring element anchored at its center (size / 2, like the default
+	*	anchor of cv::erode).
+	*	HorizontalLine uses size.width and VerticalLine size.height.
+	*	Diamond (|x| + |y| <= r) and Octagon use the radius r = size.width / 2.
+	*/
+	struct Element
+	{
+		Shape shape = Shape::Rect;
+		Size size = Size(3, 3);
+
+		Element() = default;
+		Element(Shape _shape, Size _size) :shape(_shape), size(_size) {};
+		Element(Shape _shape, int _size) :shape(_shape), size(_size, _size) {};
+	};
+
+	/*
+	*	MORPH_RECT, MORPH_CROSS or MORPH_ELLIPSE to the Shape
+	*/
+	Shape fromMorphShape(int morph_shape);
+
+	/*
+	*	The element as a mask for cv::erode, cv::dilate and cv::morphologyEx
+	*/
+	Mat getMask(const Element& e);
+
+	/*
+	*	Erosion (minimum) and dilation (maximum) of src by e, with the border
+	*	of cv::erode/cv::dilate (pixels outside the image are ignored). dst may
+	*	be src.
+	*
+	*	Rect and lines are one van Herk/Gil-Werman pass per direction, about
+	*	three comparisons per pixel for any length. A diamond is decomposed
+	*	into two diagonal lines plus one or two 3x3 crosses and an octagon into
+	*	a square plus a diamond. Cross and Ellipse are the union of the
+	*	rectangles of their rows (the minimum of one pass per rectangle).
+	*
+	*	iterations are fused into one pass with an element n times larger for
+	*	every shape except the Ellipse and the crosses larger than 3x3 (the 3x3
+	*	cross is the diamond of radius 1), which are applied n times.
+	*/
+	void erode(const Mat& src, Mat& dst, const Element& e, int iterations = 1);
+	void dilate(const Mat& src, Mat& dst, const Element& e, int iterations = 1);
+
+	enum class Operation
+	{
+		Open,		// dilate(erode(src))
+		Close,		// erode(dilate(src))
+		Gradient,	// dilate(src) - erode(src)
+		TopHat,		// src - open(src)
+		BlackHat	// close(src) - src
+	};
+
+	/*
+	*	The results of cv::morphologyEx (MORPH_OPEN, MORPH_CLOSE,
+	*	MORPH_GRADIENT, MORPH_TOPHAT, MORPH_BLACKHAT) with the mask of e.
+	*
+	*	For rectangles and lines the erosion and the dilation are chained row
+	*	by row: every row goes through both and the result is written once in
+	*	dst, with buffers of a few rows per thread and no intermediate image.
+	*	dst may be src. The other elements run erode and dilate one after the
+	*	other with one intermediate image.
+	*/
+	void morphologyEx(const Mat& src, Mat& dst, Operation operation, const Element& e, int iterations = 1);
+
+	/*
+	*	Geodesic reconstruction of marker under mask (by dilation, marker <= mask)
+	*	or over mask (by erosion, marker >= mask), connectivity 4 or 8.
+	*	Fast hybrid algorithm: one raster and one anti-raster scan, then the
+	*	pixels that can still change are propagated with a FIFO queue, O(N)
+	*	in practice instead of dilating the whole image until it is stable.
+	*	L. Vincent, "Morphological grayscale reconstruction in image analysis:
+	*	applications and efficient algorithms", IEEE TIP 2 (1993)
+	*	Images with more than one channel are reconstructed channel by channel.
+	*/
+	void reconstructByDilation(const Mat& marker, const Mat& mask, Mat& dst, int connectivity = 8);
+	void reconstructByErosion(const Mat& marker, const Mat& mask, Mat& dst, int connectivity = 8);
+
+	/*
+	*	Fills the regions (holes) that cannot be reached from the border:
+	*	reconstruction by erosion from the border values, with the holes
+	*	connected by 4-connectivity by default
+	*/
+	void fillHoles(const Mat& src, Mat& dst, int connectivity = 4);
+
+	/*
+	*	Removes the maxima (minima) with a height (depth) lower than h
+	*/
+	void hMaxima(const Mat& src, Mat& dst, double h, int connectivity = 8);
+	void hMinima(const Mat& src, Mat& dst, double h, int connectivity = 8);
+
+	/*
+	*	CV_8U mask (255) of the plateaus without higher (lower) neighbours
+	*/
+	void regionalMaxima(const Mat& src, Mat& dst, int connectivity = 8);
+	void regionalMinima(const Mat& src, Mat& dst, int connectivity = 8);
+
+	/*
+	*	Erosion by e followed by reconstruction by dilation under src, the
+	*	shapes that survive the erosion come back whole
+	*/
+	void openingByReconstruction(const Mat& src, Mat& dst, const Element& e, int connectivity = 8);
+
+	/*
+	*	Pattern spectrum (size distribution): element r - 1 is the sum of the
+	*	values removed between the openings by the elements of radius r - 1
+	*	and r (size 2r + 1), r = 1 .. max_radius
+	*/
+	std::vector<double> granulometry(	const Mat& src,
+										int max_radius,
+										Shape shape = Shape::Rect,
+										bool by_reconstruction = false);
+}
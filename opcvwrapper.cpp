@@ -1,6 +1,14 @@
 ﻿#include "opcvwrapper.h"
 #include "image_util.h"
 #include "image_interest_points.h"
+#include "preprocess_cache.h"
+#include "morphology.h"
+#include "gaussian.h"
+#include "scale_space.h"
+#include "median.h"
+#include "edge_preserving.h"
+#include "thresholding.h"
+#include "gradient.h"
 #include <iostream>
 #include <fstream>
 
@@ -8,14 +16,12 @@
 
 Mat ApplyDifferenceOfGaussian(const Mat& im)
 {
-    Mat img1 = GaussianImageSmoothExtended(im, 3, 0.01, 0.01);
-    Mat img2 = GaussianImageSmoothExtended(im, 3, 100, 100);
-
-    Mat final = img1 - img2;
-
-    img1.deallocate();
-    img2.deallocate();
+    // sigma 0.01 is the image itself, sigma 100 comes from a small octave of the shared scale space
+    std::shared_ptr<scale_space::CScaleSpace> pyramid = scale_space::get(im);
+    Mat difference = pyramid->blurAt(0.01) - pyramid->blurAt(100);
 
+    Mat final;
+    difference.convertTo(final, im.depth(), (im.depth() == CV_8U) ? 255.0 : 1.0);
     return final;
 }
 
@@ -161,27 +167,8 @@ Mat adjustGama(const Mat& img, double gamma)
 
 Mat getBinaryImage(const Mat& img)
 {
-    // Create binary image from source image
-    Mat bw;
-
-    if (!isGrayScaleImage(img))
-    {
-        try
-        {
-            cvtColor(img, bw, COLOR_BGR2GRAY);
-        }
-        catch (...)
-        {
-            bw = img.clone();
-        }        
-    }
-    else
-    {
-        bw = img.clone();
-    }
-    
-    threshold(bw, bw, 40, 255, THRESH_BINARY | THRESH_OTSU);
-    return bw;
+    // Otsu of the gray image, shared with the contours through the cache
+    return preprocess::cache().otsu(img).clone();
 }
 
 void plotHistogram(const Mat& img)
@@ -231,6 +218,16 @@ void plotHistogram(const Mat& img)
 
 }
 
+void plotGranulometry(const Mat& img, int max_radius)
+{
+    std::vector<double> spectrum = morphology::granulometry(convertograyScale(img), max_radius);
+
+    matplot::bar(spectrum);
+    matplot::xlabel("radius");
+    matplot::ylabel("removed volume");
+    matplot::show();
+}
+
 //https://docs.opencv.org/4.x/d4/d1b/tutorial_histogram_equalization.html
 Mat equalizeGrayImage(const Mat& img)
 {
@@ -276,6 +273,11 @@ Mat equalizeColorImage(const Mat& img)
 // https://docs.opencv.org/3.4/dc/dd3/tutorial_gausian_median_blur_bilateral_filter.html
 Mat blurImageSmooth(const Mat& img, int kernel_size)
 {
+    /*
+    *   cv::blur is already O(1) per pixel and keeps the reflect-101 border;
+    *   the integral image would cost 2 int64 tables per channel and clip
+    *   the windows at the border
+    */
     Mat Blurred;
     blur(img, Blurred, Size(kernel_size, kernel_size));
     return Blurred;
@@ -284,36 +286,45 @@ Mat blurImageSmooth(const Mat& img, int kernel_size)
 Mat MedianImageSmooth(const Mat& img, int kernel_size)
 {
     Mat MedianI;
-    medianBlur(img, MedianI, kernel_size);
+    median::filter(img, MedianI, kernel_size);
+    return MedianI;
+}
+
+Mat WeightedMedianImageSmooth(const Mat& img, int kernel_size)
+{
+    Mat MedianI;
+    median::weighted(img, MedianI, median::gaussianWeights(kernel_size));
     return MedianI;
 }
 
 Mat ApplyBilateralFilterExt(const Mat& img, int kernel_size, double sigma1, double sigma2)
 {
-    Mat Gray = convertograyScale(img);
+    // without a sigma for the space the window of kernel_size holds +-2 sigma
+    const double sigma_space = (sigma2 > 0) ? sigma2 : kernel_size / 4.0;
     Mat Blurred;
 
-    bilateralFilter(Gray, Blurred, -1, sigma1, sigma2);
+    edge_preserving::bilateral(img, Blurred, sigma_space, sigma1);
 
     return Blurred;
 }
 
+Mat ApplyGuidedFilter(const Mat& img, int radius, double eps, double subsample)
+{
+    Mat Smoothed;
+    edge_preserving::guided(img, img, Smoothed, radius, eps, cvRound(subsample));
+    return Smoothed;
+}
+
 Mat GaussianImageSmoothExtended(    const Mat& img, 
                                     int kernel_size,
                                     double sigmaX,
                                     double sigmaY
                                 )
 {
-    //Mat Gray = convertograyScale(img);
+    // kernel_size 0 takes the size from the sigmas,
+    // from gaussian::recursive_min_sigma on the cost does not depend on them
     Mat Blurred;
-    GaussianBlur(   
-                    img,
-                    Blurred, 
-                    Size(kernel_size, kernel_size), 
-                    sigmaX, // sigmaX standard deviation in X direction
-                    0 // sigmaY standard deviation in Y directiom 
-                       //if sigmaY is zero, it is set to be equal to sigma                    
-                );
+    gaussian::blur(img, Blurred, sigmaX, sigmaY, kernel_size);
     return Blurred;
 }
 
@@ -328,6 +339,31 @@ Mat ApplyThreShold(const Mat& img, double _threshold)
     return out;
 }
 
+Mat ApplySauvolaThreshold(const Mat& img, int window)
+{
+    return thresholding::sauvola(img, window);
+}
+
+Mat ApplyNiblackThreshold(const Mat& img, int window)
+{
+    return thresholding::niblack(img, window);
+}
+
+Mat ApplyBradleyThreshold(const Mat& img, int window)
+{
+    return thresholding::bradley(img, window);
+}
+
+Mat ApplyMultiOtsu(const Mat& img, int classes)
+{
+    return thresholding::quantize(img, thresholding::multiOtsu(img, classes));
+}
+
+Mat ApplyHysteresisThreshold(const Mat& img, int low, int high)
+{
+    return thresholding::hysteresis(img, low, high);
+}
+
 // https://docs.opencv.org/3.4/d5/db5/tutorial_laplace_operator.html
 Mat ApplyLaplacianExtended(const Mat& src, int kernel_size, int scale, int delta, int ddepth)
 {
@@ -393,9 +429,6 @@ Robert Laganiere
 Page [ 188 ]
 ----------------------------------------------------------------------------------------------*/
 Mat ApplySobelXExtended(    const Mat& img,
-                    int image_type, 
-                    int depth, 
-                    int type,
                     double delta,
                     int kernel_size)
 {
@@ -416,9 +449,6 @@ Mat ApplySobelXExtended(    const Mat& img,
 }
 
 Mat ApplySobelYExtended(const Mat& img,
-                        int image_type,
-                        int depth,
-                        int type,
                         double delta,
                         int kernel_size)
 {
@@ -439,28 +469,28 @@ Mat ApplySobelYExtended(const Mat& img,
 }
 
 Mat ApplySobelExtended( const Mat& img,
-                        int image_type,
-                        int depth,
-                        int type,
                         double delta,
                         int kernel_size)
 {
-    // Reduce noise by blurring with a Gaussian filter ( kernel size = 3 )
-    GaussianBlur(img, img, Size(3, 3), 0, 0, BORDER_DEFAULT);
-    Mat src_gray;
-    src_gray = convertograyScale(img);
-    Mat sobelX = ApplySobelXExtended(src_gray, image_type, depth, type, delta, kernel_size);
-    Mat sobelY = ApplySobelYExtended(src_gray, image_type, depth, type, delta, kernel_size);
-
-    // Compute norm of Sobel
-    cv::Sobel(src_gray, sobelX, CV_8U, 1, 0);
-    cv::Sobel(src_gray, sobelY, CV_8U, 0, 1);
+    // L1 norm of the gradient, in 16 bits so the negative derivatives count
+    Mat magnitude;
+    if (kernel_size <= 3)
+    {
+        // the gradient of img shared through the cache with Canny and the Hough transforms
+        magnitude = gradient::get(img)->magnitude;
+    }
+    else
+    {
+        Mat src_gray = convertograyScale(img);
+        Mat sobelX;
+        Mat sobelY;
+        cv::Sobel(src_gray, sobelX, CV_32F, 1, 0, kernel_size);
+        cv::Sobel(src_gray, sobelY, CV_32F, 0, 1, kernel_size);
+        magnitude = abs(sobelX) + abs(sobelY);
+    }
+
     cv::Mat sobel;
-    //compute the L1 norm
-    sobel = abs(sobelX) + abs(sobelY);
-    src_gray.deallocate();
-    sobelX.deallocate();
-    sobelY.deallocate();
+    magnitude.convertTo(sobel, CV_8U, 1, delta);
     return sobel;
 }
 
@@ -478,7 +508,7 @@ Mat ApplyHoughTransformLines(const Mat& img)
     Mat cdst = img.clone();
 
     // Apply Canny algorithm
-    Canny(img, dst, 50, 200, 3);
+    gradient::canny(img, dst, 50, 200);
 
     // Probabilistic Line Transform
     std::vector<Vec4i> linesP; // will hold the results of the detection
@@ -515,7 +545,7 @@ Mat ApplyHoughTransformCircles(const Mat& img)
     Mat cdst = img.clone();
 
     // Apply Canny algorithm
-    Canny(img, dst, 50, 200, 3);
+    gradient::canny(img, dst, 50, 200);
 
     // Standard Hough circles Transform
     std::vector<cv::Vec3f> circles;
@@ -545,17 +575,17 @@ Mat ApplyHoughTransformCircles(const Mat& img)
 
 }
 
-Mat ApplyErodeEx(const Mat& img,int type)
+Mat ApplyErodeEx(const Mat& img, int shape, int size)
 {
     cv::Mat eroded; // the destination image
-    cv::erode(img, eroded, type);
+    morphology::erode(img, eroded, morphology::Element(static_cast<morphology::Shape>(shape), size));
     return eroded;
 }
 
-Mat ApplyDilateEx(const Mat& img,int type)
+Mat ApplyDilateEx(const Mat& img, int shape, int size)
 {
     cv::Mat dilated; // the destination image
-    cv::dilate(img, dilated, type);
+    morphology::dilate(img, dilated, morphology::Element(static_cast<morphology::Shape>(shape), size));
     return dilated;
 }
 
@@ -575,36 +605,62 @@ Mat ApplyDilate(const Mat& img)
 
 Mat ApplyClosing(const Mat& img)
 {
+    // dilation followed by erosion, 3x3 square
     cv::Mat final;
-    final = ApplyErode(img);
-    final = ApplyDilate(final);
+    morphology::morphologyEx(img, final, morphology::Operation::Close, morphology::Element());
     return final;
 }
 
 Mat ApplyOpening(const Mat& img)
 {
+    // erosion followed by dilation, 3x3 square
     cv::Mat final;
-    final = ApplyDilate(img);
-    final = ApplyErode(final);    
+    morphology::morphologyEx(img, final, morphology::Operation::Open, morphology::Element());
     return final;
 }
 
 Mat ApplyMorphGradient(const Mat& img)
 {
     cv::Mat result;
-    cv::morphologyEx(img,
-        result,
-        cv::MORPH_GRADIENT,
-        cv::Mat());
-
-        return result;
+    morphology::morphologyEx(img, result, morphology::Operation::Gradient, morphology::Element());
+    return result;
 }
 
 Mat ApplyTopHatAlgo(const Mat& img)
+{
+    // image minus its opening by a 7x7 square
+    cv::Mat result;
+    morphology::morphologyEx(img, result, morphology::Operation::TopHat, morphology::Element(morphology::Shape::Rect, 7));
+    return result;
+}
+
+Mat ApplyBlackHatAlgo(const Mat& img)
+{
+    // closing by a 7x7 square minus the image
+    cv::Mat result;
+    morphology::morphologyEx(img, result, morphology::Operation::BlackHat, morphology::Element(morphology::Shape::Rect, 7));
+    return result;
+}
+
+Mat ApplyFillHoles(const Mat& img)
+{
+    cv::Mat result;
+    morphology::fillHoles(convertograyScale(img), result);
+    return result;
+}
+
+Mat ApplyRegionalMaxima(const Mat& img)
 {
     cv::Mat result;
-    cv::Mat element7(7, 7, CV_8U, cv::Scalar(1));
-    cv::morphologyEx(img, result, cv::MORPH_BLACKHAT, element7);
+    morphology::regionalMaxima(convertograyScale(img), result);
+    return result;
+}
+
+Mat ApplyOpeningByReconstruction(const Mat& img)
+{
+    // objects that survive an erosion by a 7x7 square are restored whole
+    cv::Mat result;
+    morphology::openingByReconstruction(convertograyScale(img), result, morphology::Element(morphology::Shape::Rect, 7));
     return result;
 }
 
@@ -626,14 +682,11 @@ Mat segmentErode(const Mat& img)
 Mat ApplyCannyAlgoFull(const Mat& img, int threshold, int aperture)
 {
     Mat contours;
-    Mat grayscale = convertograyScale(img);
-    //Apply Canny algorithm
-    cv::Canny(grayscale, // gray-level image
+    // Canny from the Sobel derivatives shared through the cache
+    gradient::canny(img,
         contours, // output contours
         threshold, // low threshold
         aperture); // high threshold
-
-    grayscale.deallocate();
     return contours;
 }
 
@@ -647,7 +700,7 @@ std::vector<Vec4i> GetLinesHoughTransform(  const Mat& img,
 
     // Apply Canny algorithm
     cv::Mat contours;
-    Canny(img, dst, 50, 200, 3);
+    gradient::canny(img, dst, 50, 200);
 
     // Probabilistic Line Transform
     std::vector<Vec4i> linesP; // will hold the results of the detection
@@ -691,7 +744,7 @@ std::vector<cv::Vec3f> GetCirclesHoughTransform(const Mat& img,
 
     // Apply Canny algorithm
     cv::Mat contours;
-    Canny(img, dst, 50, 200, 3);
+    gradient::canny(img, dst, 50, 200);
 
     // Copy edges to the images that will display the results in BGR
     cvtColor(dst, cdst, COLOR_GRAY2BGR);
@@ -751,68 +804,106 @@ std::vector<cv::Vec3f> GetCirclesHoughTransform(const Mat& img,
 
 Mat ApplyFindContournsThreshold(const Mat& img)
 {
-    // Convert image to grayscale
-    Mat gray;
+    // Otsu binary image and its contours are shared through the cache
+    auto contours = preprocess::cache().otsuContours(img, RETR_LIST, CHAIN_APPROX_NONE);
 
-    if (isGrayScaleImage(img) == false)
+    Mat drawing = Mat::zeros(img.size(), CV_8UC3);
+    for (size_t i = 0; i < contours->size(); i++)
     {
-        cvtColor(img, gray, COLOR_BGR2GRAY);
-    }
-    else
-    {
-        gray = img.clone();
+        drawContours(drawing, *contours, static_cast<int>(i), Scalar(0, 0, 255), 2);
     }
 
-    // Convert image to binary
-    Mat bw;
-    threshold(gray, bw, 50, 255, THRESH_BINARY | THRESH_OTSU);
-    // Find all the contours in the thresholded image
+    return drawing;
+}
+
+Mat ApplyFindContournsCanny(const Mat& img)
+{
+    int thresh = 50;
+
+    Mat canny_output = preprocess::cache().canny(img, thresh, 250, 3);
+
     std::vector<std::vector<Point> > contours;
-    findContours(bw, contours, RETR_LIST, CHAIN_APPROX_NONE);
+    ContourHierarchy tree;
+    findContourHierarchy(canny_output, contours, tree, RETR_TREE, CHAIN_APPROX_SIMPLE);
 
-    Mat drawing = Mat::zeros(bw.size(), CV_8UC3);
+    // outer contours in red, holes in blue, the nesting alternates
+    Mat drawing = Mat::zeros(canny_output.size(), CV_8UC3);
     for (size_t i = 0; i < contours.size(); i++)
     {
-        drawContours(drawing, contours, static_cast<int>(i), Scalar(0, 0, 255), 2);
+        Scalar color = (tree.depth[i] % 2 == 0) ? Scalar(0, 0, 255) : Scalar(255, 0, 0);
+        drawContours(drawing, contours, static_cast<int>(i), color, 2);
     }
 
-    gray.deallocate();
-    bw.deallocate();
-
     return drawing;
 }
 
-Mat ApplyFindContournsCanny(const Mat& img)
+void buildContourHierarchy( const std::vector<std::vector<Point> >& contours,
+                            const std::vector<Vec4i>& hierarchy,
+                            ContourHierarchy& tree)
 {
-    Mat src_gray;
-    int thresh = 50;
-
-    if (isGrayScaleImage(img) == false)
+    const int n = static_cast<int>(contours.size());
+    tree.parent.assign(n, -1);
+    tree.first_child.assign(n, -1);
+    tree.next_sibling.assign(n, -1);
+    tree.depth.assign(n, -1);
+    tree.area.resize(n);
+    tree.net_area.resize(n);
+
+    cv::parallel_for_(cv::Range(0, n), [&](const cv::Range& range)
     {
-        cvtColor(img, src_gray, COLOR_BGR2GRAY);
-    }
-    else
+        for (int i = range.start; i < range.end; i++)
+        {
+            tree.area[i] = contourArea(contours[i]);
+        }
+    });
+
+    const bool has_hierarchy = static_cast<int>(hierarchy.size()) == n;
+    for (int i = 0; i < n; i++)
     {
-        src_gray = img.clone();
+        tree.net_area[i] = tree.area[i];
+        if (has_hierarchy)
+        {
+            tree.next_sibling[i] = hierarchy[i][0];
+            tree.first_child[i] = hierarchy[i][2];
+            tree.parent[i] = hierarchy[i][3];
+        }
     }
-    blur(src_gray, src_gray, Size(3, 3));
 
-    Mat canny_output;
-    Canny(src_gray, canny_output, thresh, 250);
-
-    std::vector<std::vector<Point> > contours;
-    std::vector<Vec4i> hierarchy;
-    findContours(canny_output, contours, hierarchy, RETR_TREE, CHAIN_APPROX_SIMPLE);
-    
-    Mat drawing = Mat::zeros(canny_output.size(), CV_8UC3);
-    for (size_t i = 0; i < contours.size(); i++)
+    // one pass: the depth of a contour is found walking up to a known depth,
+    // every contour takes the area of its direct children off its parent
+    std::vector<int> path;
+    for (int i = 0; i < n; i++)
     {
-        drawContours(drawing, contours, static_cast<int>(i), Scalar(0, 0, 255), 2);
-    }
+        int p = tree.parent[i];
+        if (p >= 0)
+        {
+            tree.net_area[p] -= tree.area[i];
+        }
 
-    src_gray.deallocate();
+        int j = i;
+        while (j >= 0 && tree.depth[j] < 0)
+        {
+            path.push_back(j);
+            j = tree.parent[j];
+        }
+        int d = (j >= 0) ? tree.depth[j] : -1;
+        for (auto k = path.rbegin(); k != path.rend(); k++)
+        {
+            tree.depth[*k] = ++d;
+        }
+        path.clear();
+    }
+}
 
-    return drawing;
+void findContourHierarchy(  const Mat& binary,
+                            std::vector<std::vector<Point> >& contours,
+                            ContourHierarchy& tree,
+                            int mode,
+                            int method)
+{
+    std::vector<Vec4i> hierarchy;
+    findContours(binary, contours, hierarchy, mode, method);
+    buildContourHierarchy(contours, hierarchy, tree);
 }
 
 Mat ApplySiftToImage(const Mat& img)
@@ -825,6 +916,18 @@ Mat ApplySiftToImage(const Mat& img)
 
 }
 
+Mat ApplyFindBlobs(const Mat& img)
+{
+    Mat out = img.clone();
+    std::shared_ptr<scale_space::CScaleSpace> pyramid = scale_space::get(preprocess::cache().gray(img));
+    for (const KeyPoint& blob : pyramid->detectBlobs())
+    {
+        // the radius of a blob is about sqrt(2) sigma
+        circle(out, blob.pt, cvRound(blob.size * 0.7071), Scalar(0, 0, 255), 1, LINE_AA);
+    }
+    return out;
+}
+
 // https://docs.opencv.org/3.4/db/d28/tutorial_cascade_classifier.html
 void drawCirclesAtImgFromRoi(Mat& img, Rect& roi)
 {
@@ -904,33 +1007,14 @@ std::vector<Rect> detectEyesInImage(Mat& img)
 
 Mat ApplyFindContournsDvg(const Mat& img, const Mat& orig)
 {
-    // Convert image to grayscale
-    Mat gray;
+    // Otsu binary image and its contours are shared through the cache
+    auto contours = preprocess::cache().otsuContours(img, RETR_LIST, CHAIN_APPROX_NONE);
 
-    if (isGrayScaleImage(img) == false)
+    for (size_t i = 0; i < contours->size(); i++)
     {
-        cvtColor(img, gray, COLOR_BGR2GRAY);
-    }
-    else
-    {
-        gray = img.clone();
+        drawContours(orig, *contours, static_cast<int>(i), Scalar(0, 0, 255), 2);
     }
 
-    // Convert image to binary
-    Mat bw;
-    threshold(gray, bw, 50, 255, THRESH_BINARY | THRESH_OTSU);
-    // Find all the contours in the thresholded image
-    std::vector<std::vector<Point> > contours;
-    findContours(bw, contours, RETR_LIST, CHAIN_APPROX_NONE);
-
-    for (size_t i = 0; i < contours.size(); i++)
-    {
-        drawContours(orig, contours, static_cast<int>(i), Scalar(0, 0, 255), 2);
-    }
-
-    gray.deallocate();
-    bw.deallocate();
-
     return orig;
 }
 
@@ -940,12 +1024,11 @@ Mat ApplyFindContournsDvg(const Mat& img, const Mat& orig)
 */
 Mat ApplyCustomAlgo(const Mat& image)
 {
-    Mat final_image = convertograyScale(image);
+    Mat gray = preprocess::cache().gray(image);
 
-    for (int i = 0; i < 15; i++)
-    {
-        final_image = ApplyErode(final_image);
-    }
+    // 15 erosions by the 3x3 square are one erosion by a 31x31 square
+    Mat final_image;
+    morphology::erode(gray, final_image, morphology::Element(), 15);
 
     Mat tmp = ApplyFindContournsThreshold(image);
     
@@ -38,6 +38,9 @@ Mat adjustGama(const Mat& img, double);
 
 void plotHistogram(const Mat& img);
 
+// size distribution of the gray image, openings by squares of radius 1 .. max_radius
+void plotGranulometry(const Mat& img, int max_radius);
+
 /*************************************************************************************
 *   Gray Scale
 **************************************************************************************/
@@ -60,13 +63,27 @@ Mat equalizeColorImage(const Mat& img);
 
 Mat ApplyThreShold(const Mat& img, double _threshold);
 
+// local thresholds in windows of window x window pixels
+Mat ApplySauvolaThreshold(const Mat& img, int window);
+Mat ApplyNiblackThreshold(const Mat& img, int window);
+Mat ApplyBradleyThreshold(const Mat& img, int window);
+
+// the gray levels in classes, one gray per class
+Mat ApplyMultiOtsu(const Mat& img, int classes);
+
+Mat ApplyHysteresisThreshold(const Mat& img, int low, int high);
+
 Mat blurImageSmooth(const Mat& img, int kernel_size);
 
+// sigma1 is the sigma of the values and sigma2 the one of the space (pixels)
 Mat ApplyBilateralFilterExt(    const Mat& img, 
                                 int kernel_size, 
                                 double sigma1, 
                                 double sigma2);
 
+// guided by the image itself, eps for values in [0, 1]
+Mat ApplyGuidedFilter(const Mat& img, int radius, double eps, double subsample);
+
 Mat GaussianImageSmoothExtended(    const Mat& img,
                                     int kernel_size,
                                     double sigmaX,
@@ -74,6 +91,8 @@ Mat GaussianImageSmoothExtended(    const Mat& img,
                                 );
 
 Mat MedianImageSmooth(const Mat& img, int kernel_size);
+// every pixel of the window weighted by a Gaussian of the distance to the center
+Mat WeightedMedianImageSmooth(const Mat& img, int kernel_size);
 
 Mat ApplyCustomKernel(const Mat& img, Mat& kernel);
 
@@ -119,23 +138,14 @@ Mat ApplyLaplacianExtended( const Mat& src,
 **************************************************************************************/
 
 Mat ApplySobelXExtended(const Mat& img,
-    int image_type,
-    int depth,
-    int type,
     double delta,
     int kernel_size);
 
 Mat ApplySobelYExtended(const Mat& img,
-    int image_type,
-    int depth,
-    int type,
     double delta,
     int kernel_size);
 
 Mat ApplySobelExtended(const Mat& img,
-    int image_type,
-    int depth,
-    int type,
     double delta,
     int kernel_size);
 
@@ -145,12 +155,17 @@ Mat ApplySobelExtended(const Mat& img,
 
 Mat ApplyErode(const Mat& img);
 Mat ApplyDilate(const Mat& img);
-Mat ApplyErodeEx(const Mat& img,int);
-Mat ApplyDilateEx(const Mat& img,int);
+// shape is a morphology::Shape, size the side of the element (2 x radius + 1 for diamonds and octagons)
+Mat ApplyErodeEx(const Mat& img, int shape, int size);
+Mat ApplyDilateEx(const Mat& img, int shape, int size);
 Mat ApplyClosing(const Mat& img);
 Mat ApplyOpening(const Mat& img);
 Mat ApplyMorphGradient(const Mat& img);
 Mat ApplyTopHatAlgo(const Mat& img);
+Mat ApplyBlackHatAlgo(const Mat& img);
+Mat ApplyFillHoles(const Mat& img);
+Mat ApplyRegionalMaxima(const Mat& img);
+Mat ApplyOpeningByReconstruction(const Mat& img);
 Mat segmentErode(const Mat& img);
 
 /*************************************************************************************
@@ -162,12 +177,45 @@ Mat ApplyDifferenceOfGaussian(const Mat& im);
 Mat ApplyFindContournsThreshold(const Mat& img);
 Mat ApplyFindContournsCanny(const Mat& img);
 
+/*
+*   Hierarchy of findContours as flat arrays indexed by contour: parent,
+*   first child and next sibling (-1 when there is none), nesting depth
+*   (0 for the outer contours) and area. net_area is the area minus the area
+*   of the direct children, ie an outer contour minus its holes.
+*/
+struct ContourHierarchy
+{
+    std::vector<int> parent;
+    std::vector<int> first_child;
+    std::vector<int> next_sibling;
+    std::vector<int> depth;
+    std::vector<double> area;
+    std::vector<double> net_area;
+
+    size_t size() const { return parent.size(); };
+};
+
+void buildContourHierarchy( const std::vector<std::vector<Point> >& contours,
+                            const std::vector<Vec4i>& hierarchy,
+                            ContourHierarchy& tree);
+
+/*
+*   findContours keeping the hierarchy (RETR_CCOMP or RETR_TREE)
+*/
+void findContourHierarchy(  const Mat& binary,
+                            std::vector<std::vector<Point> >& contours,
+                            ContourHierarchy& tree,
+                            int mode = RETR_TREE,
+                            int method = CHAIN_APPROX_SIMPLE);
+
 
 /*************************************************************************************
 *   SIFT
 /*************************************************************************************/
 
 Mat ApplySiftToImage(const Mat& img);
+// DoG extrema of the shared scale space drawn with their size
+Mat ApplyFindBlobs(const Mat& img);
 
 /*************************************************************************************
 *   Face/Eye detection
@@ -1,4 +1,10 @@
 #include "pca.h"
+#include "descriptor_io.h"
+#include "preprocess_cache.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
 
 /*
 *  Calculates the PCA object from a contour
@@ -45,40 +51,78 @@ double calculateNorm2D(Point2d& v1)
 }
 
 /*
-*   Calculates the eigenvector and eingenvalue for a contourn
+*   Eigen decomposition of the symmetric matrix [a b; b d] in closed form,
+*   eigenvalues in decreasing order and unit eigenvectors like cv::PCA
 */
-PointValue getEingenFromContourn(const std::vector<Point>& pts, Mat& img, center& c)
+void getEigen2x2(double a, double b, double d, Point2d* vecs, double* vals)
 {
+    const double half_trace = 0.5 * (a + d);
+    const double root = sqrt(0.25 * (a - d) * (a - d) + b * b);
 
-    //Perform PCA analysis
-    PCA pca_analysis = getPCAAnalysis(pts);
-
+    vals[0] = half_trace + root;
+    vals[1] = half_trace - root;
 
-    //Store the center of the object
-    Point cent = Point(     static_cast<int>(pca_analysis.mean.at<double>(0, 0)),
-                            static_cast<int>(pca_analysis.mean.at<double>(0, 1)));
+    Point2d v;
+    if (std::abs(b) > 1e-12 * std::max(1.0, std::abs(a) + std::abs(d)))
+    {
+        v = Point2d(vals[0] - d, b);
+        v /= sqrt(v.x * v.x + v.y * v.y);
+    }
+    else
+    {
+        v = (a >= d) ? Point2d(1, 0) : Point2d(0, 1);
+    }
 
-    c.first = cent.x;
-    c.second = cent.y;
+    vecs[0] = v;
+    vecs[1] = Point2d(-v.y, v.x);
+}
 
-    std::vector<Point2d> eigen_vecs(2);
-    std::vector<double> eigen_val(2);
+/*
+*   Calculates the eigenvector and eingenvalue for a contourn.
+*   Mean and covariance (1/N, as cv::PCA) are accumulated in one pass with
+*   integer sums, so no data matrix is built.
+*/
+PointValue getEingenFromContourn(const std::vector<Point>& pts, Mat& img, center& c)
+{
+    PointValue p;
+    p.first.resize(2);
+    p.second.resize(2);
 
-    for (int i = 0; i < 2; i++)
+    const double n = static_cast<double>(pts.size());
+    if (pts.empty())
     {
-        eigen_vecs[i] = Point2d(    pca_analysis.eigenvectors.at<double>(i, 0),
-                                    pca_analysis.eigenvectors.at<double>(i, 1));
+        c.first = 0;
+        c.second = 0;
+        return p;
+    }
 
-        eigen_val[i] = pca_analysis.eigenvalues.at<double>(i);
+    int64_t sx = 0;
+    int64_t sy = 0;
+    int64_t sxx = 0;
+    int64_t sxy = 0;
+    int64_t syy = 0;
+    for (const auto& pt : pts)
+    {
+        sx += pt.x;
+        sy += pt.y;
+        sxx += static_cast<int64_t>(pt.x) * pt.x;
+        sxy += static_cast<int64_t>(pt.x) * pt.y;
+        syy += static_cast<int64_t>(pt.y) * pt.y;
     }
 
-    PointValue p;
+    const double mx = sx / n;
+    const double my = sy / n;
 
-    p.first = eigen_vecs;
-    p.second = eigen_val;
+    //Store the center of the object
+    c.first = static_cast<int>(mx);
+    c.second = static_cast<int>(my);
 
-    return p;
+    const double cxx = sxx / n - mx * mx;
+    const double cxy = sxy / n - mx * my;
+    const double cyy = syy / n - my * my;
 
+    getEigen2x2(cxx, cxy, cyy, p.first.data(), p.second.data());
+    return p;
 }
 
 /*
@@ -86,29 +130,48 @@ PointValue getEingenFromContourn(const std::vector<Point>& pts, Mat& img, center
 */
 eigenSpace getEingenSpace(  const contourns& contours, 
                             Mat& src, 
-                            centers& _centers)
+                            centers& _centers,
+                            double min_area,
+                            double max_area)
 {
-    eigenSpace espace;
-    eigenvectors evctors;
-    eigenvalues evalues;
-
+    std::vector<int> selected;
     for (size_t i = 0; i < contours.size(); i++)
     {
         // Calculate the area of each contour
         double area = contourArea(contours[i]);
         // Ignore contours that are too small or too large
-        if (area < 1e2 || 1e5 < area) continue;
+        if (area < min_area || max_area < area) continue;
+        selected.push_back(static_cast<int>(i));
+    }
 
-        center c;
-        PointValue p = getEingenFromContourn(contours[i], src,c);
+    return getEingenSpace(contours, selected, src, _centers);
+}
 
-        evctors.push_back(p.first);
-        evalues.push_back(p.second);
-        _centers.push_back(c);
-    }
+eigenSpace getEingenSpace(  const contourns& contours,
+                            const std::vector<int>& selected,
+                            Mat& src,
+                            centers& _centers)
+{
+    eigenSpace espace;
+    eigenvectors& evctors = espace.first;
+    eigenvalues& evalues = espace.second;
+
+    // every contour writes its own slot
+    const size_t first = _centers.size();
+    evctors.resize(selected.size());
+    evalues.resize(selected.size());
+    _centers.resize(first + selected.size());
+
+    cv::parallel_for_(cv::Range(0, static_cast<int>(selected.size())), [&](const cv::Range& range)
+    {
+        for (int k = range.start; k < range.end; k++)
+        {
+            PointValue p = getEingenFromContourn(contours[selected[k]], src, _centers[first + k]);
+            evctors[k] = std::move(p.first);
+            evalues[k] = std::move(p.second);
+        }
+    });
 
-    espace.first = evctors;
-    espace.second = evalues;
     return espace;
 }
 
@@ -116,29 +179,10 @@ eigenSpace getEingenSpace(  const contourns& contours,
 /*
 *   Get All the contours of a image
 */
-std::vector<std::vector<Point> > getContourns(const Mat& img)
+std::shared_ptr<const preprocess::ContourList> getContourns(const Mat& img)
 {
-    Mat src = img.clone();
-    // Convert image to grayscale
-    Mat gray;
-
-    if (isGrayScaleImage(src) == false)
-    {
-        cvtColor(src, gray, COLOR_BGR2GRAY);
-    }
-    else
-    {
-        gray = src.clone();
-    }
-
-    // Convert image to binary
-    Mat bw;
-    threshold(gray, bw, 50, 255, THRESH_BINARY | THRESH_OTSU);
-    // Find all the contours in the thresholded image
-    std::vector<std::vector<Point> > contours;
-    findContours(bw, contours, RETR_CCOMP, CHAIN_APPROX_NONE);
-
-    return contours;
+    // the Otsu binary image and its contours come from the preprocessing cache, no copy
+    return preprocess::cache().otsuContours(img, RETR_CCOMP, CHAIN_APPROX_NONE);
 }
 
 
@@ -148,45 +192,615 @@ std::vector<std::vector<Point> > getContourns(const Mat& img)
 */
 std::stringstream  getEingenSpaceInfo(const Mat& img, eigenSpace& _espace)
 {
-    std::stringstream outinfo;
+    centers _centers;
+    return getEingenSpaceInfo(img, _espace, _centers);
+}
+
+std::stringstream  getEingenSpaceInfo(const Mat& img, eigenSpace& _espace, centers& _centers)
+{
     //------------------------------------------------------------------------
     //   Step 1 : Find contourns
     //------------------------------------------------------------------------
 
-    std::vector<std::vector<Point> > contours = getContourns(img);
+    const std::shared_ptr<const preprocess::ContourList> shared = getContourns(img);
+    const contourns& contours = *shared;
 
     //------------------------------------------------------------------------
     //  Step 2 : Find centers, Eigenvectors and Eigenvalues
     //------------------------------------------------------------------------
-    centers _centers;
     Mat clone = img.clone();
     _espace = getEingenSpace(contours, clone, _centers);
 
     //------------------------------------------------------------------------
-    //  Step 3 : Print values to a stringstream
+    //  Step 3 : Print values to one text buffer
     //------------------------------------------------------------------------
-    eigenvectors evectors = _espace.first;
-    eigenvalues  evalues = _espace.second;
+    const eigenvectors& evectors = _espace.first;
+    const eigenvalues& evalues = _espace.second;
 
-    /*
-                                Angles& angles,
-                            Distances& distances)
-    */
+    descriptor_io::CCsvBuffer outinfo(64 * (evectors.size() + 1));
 
-    outinfo << "eg1x,eg1y,eg2x,eg2y,evalue1,evalue2,centerx,centery" << std::endl;
+    outinfo.add("eg1x,eg1y,eg2x,eg2y,evalue1,evalue2,centerx,centery").newline();
     for (int i = 0; i < evectors.size(); i++)
     {
-        for (const auto evcts : evectors[i])
+        for (const auto& evcts : evectors[i])
         {
-            outinfo << evcts.x << "," << evcts.y << ",";
+            outinfo.add(evcts.x).comma().add(evcts.y).comma();
         }
         for (const auto evalue : evalues[i])
         {
-            outinfo << evalue << ",";
+            outinfo.add(evalue).comma();
+        }
+
+        outinfo.add(_centers[i].first).comma().add(_centers[i].second).newline();
+    }
+
+    return std::stringstream(outinfo.str());
+}
+
+/*
+*   Indices of the contours with area in [min_area, max_area]
+*/
+std::vector<int> selectContours(const contourns& contours, double min_area, double max_area)
+{
+    std::vector<int> selected;
+    for (size_t i = 0; i < contours.size(); i++)
+    {
+        double area = contourArea(contours[i]);
+        if (area < min_area || max_area < area) continue;
+        selected.push_back(static_cast<int>(i));
+    }
+    return selected;
+}
+
+// every step-th of n items keeps at most max_sample of them
+size_t sampleStep(size_t n, size_t max_sample)
+{
+    max_sample = std::max<size_t>(1, max_sample);
+    return std::max<size_t>(1, (n + max_sample - 1) / max_sample);
+}
+
+eigenvectors sampleEingenVectors(const Mat& img, size_t max_sample, double min_area, double max_area)
+{
+    const std::shared_ptr<const preprocess::ContourList> shared = getContourns(img);
+    const contourns& contours = *shared;
+    const std::vector<int> selected = selectContours(contours, min_area, max_area);
+    const size_t step = sampleStep(selected.size(), max_sample);
+
+    std::vector<int> part;
+    for (size_t i = 0; i < selected.size(); i += step)
+    {
+        part.push_back(selected[i]);
+    }
+
+    Mat src;
+    centers _centers;
+    return getEingenSpace(contours, part, src, _centers).first;
+}
+
+long long exportEingenSpace(    const Mat& img,
+                                const std::string& path,
+                                double min_area,
+                                double max_area,
+                                const std::function<bool(size_t, size_t)>& progress,
+                                eigenvectors* sample,
+                                size_t max_sample)
+{
+    // contours per chunk
+    const size_t chunk = 1 << 14;
+
+    //------------------------------------------------------------------------
+    //   Pass 1 : contours and the rows that will be written
+    //------------------------------------------------------------------------
+    const std::shared_ptr<const preprocess::ContourList> shared = getContourns(img);
+    const contourns& contours = *shared;
+    const std::vector<int> selected = selectContours(contours, min_area, max_area);
+    const size_t step = sampleStep(selected.size(), max_sample);
+
+    const std::vector<std::string> names = { "eg1x", "eg1y", "eg2x", "eg2y", "evalue1", "evalue2", "centerx", "centery" };
+    const bool binary = descriptor_io::isBinaryFile(path);
+
+    descriptor_io::CColumnarWriter columnar;
+    descriptor_io::CCsvBuffer csv;
+    if (binary)
+    {
+        std::vector<descriptor_io::Field> fields;
+        for (const auto& n : names)
+        {
+            fields.push_back({ n, descriptor_io::COL_FLOAT64 });
+        }
+        if (columnar.open(path, selected.size(), fields) == false)
+        {
+            return -1;
+        }
+    }
+    else
+    {
+        if (csv.open(path) == false)
+        {
+            return -1;
+        }
+        csv.add("eg1x,eg1y,eg2x,eg2y,evalue1,evalue2,centerx,centery").newline();
+    }
+
+    //------------------------------------------------------------------------
+    //   Pass 2 : one chunk at a time
+    //------------------------------------------------------------------------
+    Mat src;
+    std::vector<int> part;
+    std::vector<double> column;
+    bool ok = true;
+    bool cancelled = false;
+
+    for (size_t first = 0; first < selected.size() && ok; first += chunk)
+    {
+        const size_t n = std::min(chunk, selected.size() - first);
+        part.assign(selected.begin() + first, selected.begin() + first + n);
+
+        centers _centers;
+        eigenSpace espace = getEingenSpace(contours, part, src, _centers);
+        const eigenvectors& evectors = espace.first;
+        const eigenvalues& evalues = espace.second;
+
+        if (binary)
+        {
+            column.resize(n);
+            for (size_t c = 0; c < names.size() && ok; c++)
+            {
+                for (size_t i = 0; i < n; i++)
+                {
+                    switch (c)
+                    {
+                    case 0: column[i] = evectors[i][0].x; break;
+                    case 1: column[i] = evectors[i][0].y; break;
+                    case 2: column[i] = evectors[i][1].x; break;
+                    case 3: column[i] = evectors[i][1].y; break;
+                    case 4: column[i] = evalues[i][0]; break;
+                    case 5: column[i] = evalues[i][1]; break;
+                    case 6: column[i] = _centers[i].first; break;
+                    default: column[i] = _centers[i].second; break;
+                    }
+                }
+                ok = columnar.write(static_cast<int>(c), first, column.data(), n);
+            }
+        }
+        else
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                for (const auto& evcts : evectors[i])
+                {
+                    csv.add(evcts.x).comma().add(evcts.y).comma();
+                }
+                for (const auto evalue : evalues[i])
+                {
+                    csv.add(evalue).comma();
+                }
+                csv.add(_centers[i].first).comma().add(_centers[i].second).newline();
+            }
+        }
+
+        if (sample != nullptr)
+        {
+            for (size_t i = (step - first % step) % step; i < n; i += step)
+            {
+                sample->push_back(evectors[i]);
+            }
+        }
+
+        if (ok && progress && progress(first + n, selected.size()) == false)
+        {
+            cancelled = true;
+            ok = false;
+        }
+    }
+
+    ok = (binary ? columnar.close() : csv.close()) && ok;
+    if (ok == false)
+    {
+        std::remove(path.c_str());
+        return cancelled ? export_cancelled : -1;
+    }
+
+    return static_cast<long long>(selected.size());
+}
+
+/*-------------------------------------------------------------------------------------------
+*   CEigenImages
+---------------------------------------------------------------------------------------------*/
+
+// orthonormal basis of the columns of m
+Mat getOrthonormalBasis(const Mat& m)
+{
+    Mat w, u, vt;
+    SVD::compute(m, w, u, vt);
+    return u;
+}
+
+bool CEigenImages::getSample(const Mat& img, double* row) const
+{
+    if (img.empty())
+    {
+        return false;
+    }
+
+    Mat gray;
+    switch (img.channels())
+    {
+    case 1:
+        gray = img;
+        break;
+    case 3:
+        cvtColor(img, gray, COLOR_BGR2GRAY);
+        break;
+    case 4:
+        cvtColor(img, gray, COLOR_BGRA2GRAY);
+        break;
+    default:
+        return false;
+    }
+
+    Mat resized;
+    resize(gray, resized, sample_size, 0, 0, INTER_AREA);
+
+    // the row of the caller is used as the destination buffer, a Mat of
+    // another type would be reallocated and leave the row unfilled
+    Mat out(sample_size, CV_64F, row);
+    resized.convertTo(out, CV_64F);
+    return out.data == reinterpret_cast<uchar*>(row);
+}
+
+bool CEigenImages::forEachBatch(const BatchFunction& f)
+{
+    const int D = sample_size.area();
+    const int batch_size = 64;
+    const int N = static_cast<int>(_files.size());
+
+    Mat batch;
+    for (int first = 0; first < N; first += batch_size)
+    {
+        const int n = std::min(batch_size, N - first);
+        batch.create(n, D, CV_64F);
+
+        cv::parallel_for_(cv::Range(0, n), [&](const cv::Range& range)
+        {
+            for (int i = range.start; i < range.end; i++)
+            {
+                double* row = batch.ptr<double>(i);
+                Mat img = imread(_files[first + i], IMREAD_GRAYSCALE);
+                if (getSample(img, row) == false)
+                {
+                    // before the mean exists a NaN marks the file as unreadable,
+                    // afterwards the sample is just the mean
+                    std::fill(row, row + D, 0.0);
+                    if (_mean.empty())
+                    {
+                        row[0] = std::numeric_limits<double>::quiet_NaN();
+                    }
+                    continue;
+                }
+
+                if (_mean.empty() == false)
+                {
+                    const double* m = _mean.ptr<double>(0);
+                    for (int j = 0; j < D; j++)
+                    {
+                        row[j] -= m[j];
+                    }
+                }
+            }
+        });
+
+        f(batch, first);
+
+        _done += n;
+        if (_progress && _progress(_done, _total) == false)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CEigenImages::compute( const std::vector<std::string>& files,
+                            int components,
+                            int power_iterations,
+                            const std::function<bool(size_t, size_t)>& progress)
+{
+    const int D = sample_size.area();
+    power_iterations = std::max(0, power_iterations);
+
+    _mean.release();
+    _components.release();
+    _eigenvalues.release();
+    _coefficients.release();
+    _progress = progress;
+    _done = 0;
+    _total = files.size() * (3 + 2 * static_cast<size_t>(power_iterations));
+
+    //------------------------------------------------------------------------
+    //   Pass 1 : readable files and the mean image
+    //------------------------------------------------------------------------
+    _files = files;
+    std::vector<std::string> readable;
+    Mat sum = Mat::zeros(1, D, CV_64F);
+    bool ok = forEachBatch([&](const Mat& batch, int first)
+    {
+        for (int r = 0; r < batch.rows; r++)
+        {
+            if (std::isnan(batch.at<double>(r, 0)) == false)
+            {
+                sum += batch.row(r);
+                readable.push_back(_files[first + r]);
+            }
+        }
+    });
+
+    _files = readable;
+    const int N = static_cast<int>(_files.size());
+    if (ok == false || N < 2 || components < 1)
+    {
+        return false;
+    }
+    _mean = sum / N;
+
+    const int K = std::min(components, std::min(N, D));
+    const int l = std::min(K + 10, std::min(N, D));
+
+    //------------------------------------------------------------------------
+    //   Pass 2 : range of the centered data, Y = Xc * omega
+    //------------------------------------------------------------------------
+    Mat omega(D, l, CV_64F);
+    cv::RNG rng(0x2023);
+    rng.fill(omega, RNG::NORMAL, 0, 1);
+
+    Mat Y(N, l, CV_64F);
+    auto sampleRange = [&](const Mat& Z)
+    {
+        return forEachBatch([&](const Mat& batch, int first)
+        {
+            Mat out = Y.rowRange(first, first + batch.rows);
+            gemm(batch, Z, 1, noArray(), 0, out);
+        });
+    };
+
+    if (sampleRange(omega) == false)
+    {
+        return false;
+    }
+
+    //------------------------------------------------------------------------
+    //   Power iterations : Z = Xc' * Q, Y = Xc * orth(Z)
+    //------------------------------------------------------------------------
+    for (int q = 0; q < power_iterations; q++)
+    {
+        Mat Q = getOrthonormalBasis(Y);
+        Mat Z = Mat::zeros(D, l, CV_64F);
+        Mat part;
+        ok = forEachBatch([&](const Mat& batch, int first)
+        {
+            gemm(batch, Q.rowRange(first, first + batch.rows), 1, noArray(), 0, part, GEMM_1_T);
+            Z += part;
+        });
+
+        if (ok == false || sampleRange(getOrthonormalBasis(Z)) == false)
+        {
+            return false;
+        }
+    }
+
+    //------------------------------------------------------------------------
+    //   Last pass : B = Q' * Xc and its small SVD
+    //------------------------------------------------------------------------
+    Mat Q = getOrthonormalBasis(Y);
+    Mat B = Mat::zeros(l, D, CV_64F);
+    Mat part;
+    ok = forEachBatch([&](const Mat& batch, int first)
+    {
+        gemm(Q.rowRange(first, first + batch.rows), batch, 1, noArray(), 0, part, GEMM_1_T);
+        B += part;
+    });
+    if (ok == false)
+    {
+        return false;
+    }
+
+    Mat w, u, vt;
+    SVD::compute(B, w, u, vt);
+
+    _components = vt.rowRange(0, K).clone();
+    _eigenvalues = w.rowRange(0, K).mul(w.rowRange(0, K)) / (N - 1);
+
+    // Xc ~ Q u diag(w) vt, so the coefficients are Q u diag(w)
+    _coefficients = Q * u.colRange(0, K) * Mat::diag(w.rowRange(0, K));
+    return true;
+}
+
+Mat CEigenImages::project(const Mat& img) const
+{
+    if (_components.empty())
+    {
+        return Mat();
+    }
+
+    Mat row(1, sample_size.area(), CV_64F);
+    if (getSample(img, row.ptr<double>(0)) == false)
+    {
+        return Mat();
+    }
+    row -= _mean;
+    return row * _components.t();
+}
+
+Mat CEigenImages::reconstruct(const Mat& coefficients) const
+{
+    Mat row = coefficients * _components + _mean;
+    Mat out;
+    row.reshape(1, sample_size.height).convertTo(out, CV_8U);
+    return out;
+}
+
+Mat CEigenImages::getComponentImage(int k) const
+{
+    Mat row = (k < 0) ? _mean : _components.row(k);
+    Mat out;
+    normalize(row.reshape(1, sample_size.height), out, 0, 255, NORM_MINMAX, CV_8U);
+    return out;
+}
+
+eigenSpace CEigenImages::getProjectionSpace() const
+{
+    eigenSpace espace;
+    for (int i = 0; i < _coefficients.rows; i++)
+    {
+        const double c1 = _coefficients.at<double>(i, 0);
+        const double c2 = (_coefficients.cols > 1) ? _coefficients.at<double>(i, 1) : 0.0;
+        espace.first.push_back(eigenvector{ Point2d(c1, c2) });
+        espace.second.push_back(eigenvalue{ _eigenvalues.at<double>(0) });
+    }
+    return espace;
+}
+
+bool CEigenImages::save(const std::string& path) const
+{
+    const int D = sample_size.area();
+    const int K = components();
+    if (K == 0 || D < K + 2)
+    {
+        return false;
+    }
+
+    std::vector<std::string> names = { "mean" };
+    for (int k = 0; k < K; k++)
+    {
+        names.push_back("pc" + std::to_string(k + 1));
+    }
+    names.push_back("meta");
+
+    const size_t cols = names.size();
+    std::vector<double> values(static_cast<size_t>(D) * cols, 0.0);
+    for (int r = 0; r < D; r++)
+    {
+        double* row = values.data() + r * cols;
+        row[0] = _mean.at<double>(0, r);
+        for (int k = 0; k < K; k++)
+        {
+            row[1 + k] = _components.at<double>(k, r);
+        }
+    }
+    values[cols - 1] = sample_size.width;
+    values[2 * cols - 1] = sample_size.height;
+    for (int k = 0; k < K; k++)
+    {
+        values[(2 + k) * cols + cols - 1] = _eigenvalues.at<double>(k);
+    }
+
+    if (descriptor_io::isBinaryFile(path))
+    {
+        return descriptor_io::writeTable(path, names, values.data(), D);
+    }
+
+    descriptor_io::CCsvBuffer os;
+    if (os.open(path) == false)
+    {
+        return false;
+    }
+    for (size_t c = 0; c < cols; c++)
+    {
+        if (c > 0)
+        {
+            os.comma();
         }
+        os.add(names[c].c_str());
+    }
+    os.newline();
+    for (int r = 0; r < D; r++)
+    {
+        for (size_t c = 0; c < cols; c++)
+        {
+            if (c > 0)
+            {
+                os.comma();
+            }
+            os.add(values[r * cols + c]);
+        }
+        os.newline();
+    }
+    return os.close();
+}
+
+bool CEigenImages::load(const std::string& path)
+{
+    std::vector<double> values;
+    size_t rows = 0;
+    size_t cols = 0;
+
+    if (descriptor_io::isBinaryFile(path))
+    {
+        descriptor_io::CColumnarReader reader;
+        if (reader.open(path) == false)
+        {
+            return false;
+        }
+        rows = reader.rows();
+        cols = reader.columns();
+        values.resize(rows * cols);
+        for (size_t c = 0; c < cols; c++)
+        {
+            const double* column = reader.column<double>(static_cast<int>(c));
+            if (column == nullptr)
+            {
+                return false;
+            }
+            for (size_t r = 0; r < rows; r++)
+            {
+                values[r * cols + c] = column[r];
+            }
+        }
+    }
+    else
+    {
+        descriptor_io::CCsvParser parser;
+        if (parser.open(path, 0, true) == false)
+        {
+            return false;
+        }
+        parser.parse(values);
+        rows = parser.rows();
+        cols = parser.fields();
+    }
 
-        outinfo << _centers[i].first << "," << _centers[i].second << std::endl;
+    if (cols < 3 || rows < cols)
+    {
+        return false;
+    }
+
+    const int K = static_cast<int>(cols) - 2;
+    const int D = static_cast<int>(rows);
+    const cv::Size size(static_cast<int>(values[cols - 1]), static_cast<int>(values[2 * cols - 1]));
+    if (size.area() != D)
+    {
+        return false;
     }
 
-    return outinfo;
-}
\ No newline at end of file
+    sample_size = size;
+    _mean.create(1, D, CV_64F);
+    _components.create(K, D, CV_64F);
+    _eigenvalues.create(K, 1, CV_64F);
+    _coefficients.release();
+    _files.clear();
+
+    for (int r = 0; r < D; r++)
+    {
+        const double* row = values.data() + r * cols;
+        _mean.at<double>(0, r) = row[0];
+        for (int k = 0; k < K; k++)
+        {
+            _components.at<double>(k, r) = row[1 + k];
+        }
+    }
+    for (int k = 0; k < K; k++)
+    {
+        _eigenvalues.at<double>(k) = values[(2 + k) * cols + cols - 1];
+    }
+    return true;
+}
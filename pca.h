@@ -1,8 +1,10 @@
 #pragma once
 #include "opcvwrapper.h"
+#include "preprocess_cache.h"
 #include <iostream>
 #include <string>
 #include <sstream>
+#include <functional>
 
 constexpr int _dim2D = 2;
 
@@ -18,15 +20,143 @@ using PointValue = std::pair<std::vector<Point2d>, std::vector<double>>;
 using Distances = std::vector<double>;
 using Angles = std::vector<double>;
 
-std::vector<std::vector<Point> > getContourns(const Mat& img);
-eigenSpace getEingenSpace(const contourns& contours, Mat& src, centers& _centers);
+/*
+*   Contours of the Otsu binary image, shared with the preprocessing cache
+*/
+std::shared_ptr<const preprocess::ContourList> getContourns(const Mat& img);
+/*
+*   Contours with area outside [min_area, max_area] are ignored
+*/
+eigenSpace getEingenSpace(  const contourns& contours,
+                            Mat& src,
+                            centers& _centers,
+                            double min_area = 1e2,
+                            double max_area = 1e5);
+
+/*
+*   Only the contours in selected, eg the indices of a descriptor query
+*/
+eigenSpace getEingenSpace(  const contourns& contours,
+                            const std::vector<int>& selected,
+                            Mat& src,
+                            centers& _centers);
 PointValue getEingenFromContourn(const std::vector<Point>& pts, Mat& img, center& c);
+void getEigen2x2(double a, double b, double d, Point2d* vecs, double* vals);
 std::stringstream getEingenSpaceInfo(const Mat& img, eigenSpace& _espace);
+std::stringstream getEingenSpaceInfo(const Mat& img, eigenSpace& _espace, centers& _centers);
 PCA getPCAAnalysis(const std::vector<Point>& pts);
 
+// most eigen vectors kept to be plotted by ShowPCA
+constexpr size_t plot_sample = 1 << 14;
+
+// exportEingenSpace was cancelled by progress
+constexpr long long export_cancelled = -2;
+
+/*
+*   Computes the eigen space of the contours of img chunk by chunk and writes
+*   every chunk straight to path (csv with the format of getEingenSpaceInfo,
+*   or a columnar file when path has the .dvgc extension). Only one chunk of
+*   results is in memory; when sample is given it also receives the eigen
+*   vectors of at most max_sample contours spread evenly over all of them.
+*   progress(done, total) is called after every chunk, returning false
+*   cancels the export. The file is removed when the export does not finish.
+*   Returns the number of rows written, -1 on error, export_cancelled on cancel.
+*/
+long long exportEingenSpace(    const Mat& img,
+                                const std::string& path,
+                                double min_area = 1e2,
+                                double max_area = 1e5,
+                                const std::function<bool(size_t, size_t)>& progress = nullptr,
+                                eigenvectors* sample = nullptr,
+                                size_t max_sample = plot_sample);
+
+/*
+*   Eigen vectors of at most max_sample contours of img (area in
+*   [min_area, max_area]) spread evenly over all of them, nothing is formatted
+*/
+eigenvectors sampleEingenVectors(   const Mat& img,
+                                    size_t max_sample = plot_sample,
+                                    double min_area = 1e2,
+                                    double max_area = 1e5);
+
 double calculateDistance2D(eigenvector& e);
 double Angle2D(eigenvector& e);
 int dotProduct2D(Point2d& v1, Point2d& v2);
 double calculateNorm2D(Point2d& v1);
 
+/*
+*   Principal components of a set of images (eigen images).
+*   Every image is loaded as gray, resized to size and seen as one row of
+*   size.area() values. The decomposition is a randomized SVD done in
+*   passes over the files (mean, range finder, power iterations and the
+*   final projection), images are read in parallel batches so the data
+*   matrix never has to be in memory:
+*
+*       Halko, Martinsson, Tropp, Finding structure with randomness, 2011
+*       https://arxiv.org/abs/0909.4061
+*
+*   Besides the top components it keeps the coefficients of every image,
+*   which come for free from the factorization.
+*/
+class CEigenImages final
+{
+public:
+
+    explicit CEigenImages(cv::Size size = cv::Size(64, 64)) :sample_size(size) {};
+
+    /*
+    *   progress(done, total) counts the images of all the passes, returning
+    *   false cancels. Unreadable files are skipped.
+    */
+    bool compute(   const std::vector<std::string>& files,
+                    int components,
+                    int power_iterations = 1,
+                    const std::function<bool(size_t, size_t)>& progress = nullptr);
+
+    // 1 x K coefficients of an image
+    Mat project(const Mat& img) const;
+    Mat reconstruct(const Mat& coefficients) const;
+
+    // component k (or the mean with k < 0) scaled to an 8 bit image
+    Mat getComponentImage(int k) const;
+
+    int components() const { return _components.rows; };
+    const Mat& getMean() const { return _mean; };
+    const Mat& getComponents() const { return _components; };
+    const Mat& getEigenValues() const { return _eigenvalues; };
+    const Mat& getCoefficients() const { return _coefficients; };
+    const std::vector<std::string>& getFiles() const { return _files; };
+
+    /*
+    *   Coefficients of every image on the first two components as an
+    *   eigenSpace, one point per image, to be plotted by ShowPCA
+    */
+    eigenSpace getProjectionSpace() const;
+
+    /*
+    *   Columnar file (.dvgc) or csv with one row per pixel and the columns
+    *   mean, pc1..pcK and meta (width, height and the K eigenvalues)
+    */
+    bool save(const std::string& path) const;
+    bool load(const std::string& path);
+
+private:
+    CEigenImages(CEigenImages&) = delete;
+    CEigenImages& operator=(CEigenImages&) = delete;
+
+    bool getSample(const Mat& img, double* row) const;
+
+    using BatchFunction = std::function<void(const Mat& batch, int first)>;
+    bool forEachBatch(const BatchFunction& f);
+
+    cv::Size sample_size;
+    std::vector<std::string> _files;
+    Mat _mean;
+    Mat _components;
+    Mat _eigenvalues;
+    Mat _coefficients;
 
+    std::function<bool(size_t, size_t)> _progress;
+    size_t _done = 0;
+    size_t _total = 0;
+};
@@ -0,0 +1,257 @@
+#include "preprocess_cache.h"
+#include "gradient.h"
+#include <algorithm>
+#include <cstring>
+
+namespace preprocess
+{
+    // rows of a band of the parallel hash
+    constexpr int hash_band = 256;
+
+    constexpr uint64_t fnv_offset = 1469598103934665603ULL;
+    constexpr uint64_t fnv_prime = 1099511628211ULL;
+
+    CPreprocessCache& cache()
+    {
+        static CPreprocessCache shared;
+        return shared;
+    }
+
+    CPreprocessCache::SourceKey CPreprocessCache::getSourceKey(const Mat& img)
+    {
+        SourceKey key;
+        key.data = img.data;
+        key.rows = img.rows;
+        key.cols = img.cols;
+        key.type = img.type();
+        key.step = img.step;
+
+        /*
+        *   FNV-1a over every byte of the image (8 byte words and the tail of
+        *   each row), by bands of rows in parallel. A sampled hash misses
+        *   in-place edits between the samples and returns stale products.
+        *   Four independent lanes take the words in turn so the multiplies
+        *   overlap and the pass runs at the speed of the memory reads.
+        */
+        const size_t row_bytes = img.cols * img.elemSize();
+        const int bands = img.empty() ? 0 : (img.rows + hash_band - 1) / hash_band;
+        std::vector<uint64_t> band_hash(bands, fnv_offset);
+        cv::parallel_for_(cv::Range(0, bands), [&](const cv::Range& range)
+        {
+            const size_t words = row_bytes / sizeof(uint64_t);
+            const size_t quads = words / 4;
+            for (int b = range.start; b < range.end; b++)
+            {
+                uint64_t h[4] = { fnv_offset, fnv_offset ^ 1, fnv_offset ^ 2, fnv_offset ^ 3 };
+                const int last = std::min(img.rows, (b + 1) * hash_band);
+                for (int y = b * hash_band; y < last; y++)
+                {
+                    const uchar* row = img.ptr(y);
+                    for (size_t k = 0; k < quads; k++)
+                    {
+                        uint64_t v[4];
+                        memcpy(v, row + k * sizeof(v), sizeof(v));
+                        h[0] = (h[0] ^ v[0]) * fnv_prime;
+                        h[1] = (h[1] ^ v[1]) * fnv_prime;
+                        h[2] = (h[2] ^ v[2]) * fnv_prime;
+                        h[3] = (h[3] ^ v[3]) * fnv_prime;
+                    }
+                    for (size_t k = quads * 4; k < words; k++)
+                    {
+                        uint64_t v;
+                        memcpy(&v, row + k * sizeof(uint64_t), sizeof(v));
+                        h[0] = (h[0] ^ v) * fnv_prime;
+                    }
+                    for (size_t k = words * sizeof(uint64_t); k < row_bytes; k++)
+                    {
+                        h[0] = (h[0] ^ row[k]) * fnv_prime;
+                    }
+                }
+                uint64_t band = fnv_offset;
+                for (const uint64_t lane : h)
+                {
+                    band = (band ^ lane) * fnv_prime;
+                }
+                band_hash[b] = band;
+            }
+        });
+
+        uint64_t h = fnv_offset;
+        for (const uint64_t v : band_hash)
+        {
+            h = (h ^ v) * fnv_prime;
+        }
+        key.hash = h;
+        return key;
+    }
+
+    bool CPreprocessCache::find(const SourceKey& key, const std::string& operation, Entry& out)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        for (auto it = entries.begin(); it != entries.end(); it++)
+        {
+            if (it->operation == operation && it->source == key)
+            {
+                // most recently used first
+                entries.splice(entries.begin(), entries, it);
+                out.image = entries.front().image;
+                out.contours = entries.front().contours;
+                out.object = entries.front().object;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void CPreprocessCache::insert(Entry&& entry)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        used_bytes += entry.bytes;
+        entries.push_front(std::move(entry));
+
+        while (entries.size() > 1 && (entries.size() > max_entries || used_bytes > max_bytes))
+        {
+            used_bytes -= entries.back().bytes;
+            entries.pop_back();
+        }
+    }
+
+    void CPreprocessCache::clear()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        entries.clear();
+        used_bytes = 0;
+    }
+
+    Mat CPreprocessCache::gray(const Mat& img)
+    {
+        if (img.channels() == 1)
+        {
+            return img;
+        }
+        return gray(img, getSourceKey(img));
+    }
+
+    Mat CPreprocessCache::gray(const Mat& img, const SourceKey& key)
+    {
+        if (img.channels() == 1)
+        {
+            return img;
+        }
+
+        Entry entry;
+        if (find(key, "gray", entry))
+        {
+            return entry.image;
+        }
+
+        cvtColor(img, entry.image, COLOR_BGR2GRAY);
+        entry.source = key;
+        entry.operation = "gray";
+        entry.keep_source = img;
+        entry.bytes = entry.image.total() * entry.image.elemSize() + img.total() * img.elemSize();
+
+        Mat result = entry.image;
+        insert(std::move(entry));
+        return result;
+    }
+
+    Mat CPreprocessCache::otsu(const Mat& img)
+    {
+        return otsu(img, getSourceKey(img));
+    }
+
+    Mat CPreprocessCache::otsu(const Mat& img, const SourceKey& key)
+    {
+        Entry entry;
+        if (find(key, "otsu", entry))
+        {
+            return entry.image;
+        }
+
+        threshold(gray(img, key), entry.image, 50, 255, THRESH_BINARY | THRESH_OTSU);
+        entry.source = key;
+        entry.operation = "otsu";
+        entry.keep_source = img;
+        entry.bytes = entry.image.total() * entry.image.elemSize() + img.total() * img.elemSize();
+
+        Mat result = entry.image;
+        insert(std::move(entry));
+        return result;
+    }
+
+    Mat CPreprocessCache::canny(const Mat& img, double threshold1, double threshold2, int blur_size)
+    {
+        return canny(img, getSourceKey(img), threshold1, threshold2, blur_size);
+    }
+
+    Mat CPreprocessCache::canny(const Mat& img, const SourceKey& key, double threshold1, double threshold2, int blur_size)
+    {
+        const std::string operation =   "canny:" + std::to_string(threshold1) +
+                                        ":" + std::to_string(threshold2) +
+                                        ":" + std::to_string(blur_size);
+        Entry entry;
+        if (find(key, operation, entry))
+        {
+            return entry.image;
+        }
+
+        if (blur_size > 0)
+        {
+            Mat blurred;
+            blur(gray(img, key), blurred, Size(blur_size, blur_size));
+            Canny(blurred, entry.image, threshold1, threshold2);
+        }
+        else
+        {
+            // the derivatives of the image are shared with Sobel
+            if (img.empty() == false)
+            {
+                const std::shared_ptr<const gradient::Gradient> g = gradient::get(img, key);
+                Canny(g->dx, g->dy, entry.image, threshold1, threshold2);
+            }
+        }
+
+        entry.source = key;
+        entry.operation = operation;
+        entry.keep_source = img;
+        entry.bytes = entry.image.total() * entry.image.elemSize() + img.total() * img.elemSize();
+
+        Mat result = entry.image;
+        insert(std::move(entry));
+        return result;
+    }
+
+    std::shared_ptr<const ContourList> CPreprocessCache::otsuContours(const Mat& img, int mode, int method)
+    {
+        return otsuContours(img, getSourceKey(img), mode, method);
+    }
+
+    std::shared_ptr<const ContourList> CPreprocessCache::otsuContours(const Mat& img, const SourceKey& key, int mode, int method)
+    {
+        const std::string operation = "contours:" + std::to_string(mode) + ":" + std::to_string(method);
+        Entry entry;
+        if (find(key, operation, entry))
+        {
+            return entry.contours;
+        }
+
+        auto contours = std::make_shared<ContourList>();
+        findContours(otsu(img, key), *contours, mode, method);
+
+        size_t points = 0;
+        for (const auto& c : *contours)
+        {
+            points += c.size();
+        }
+
+        entry.source = key;
+        entry.operation = operation;
+        entry.keep_source = img;
+        entry.contours = contours;
+        entry.bytes = points * sizeof(Point) + img.total() * img.elemSize();
+
+        insert(std::move(entry));
+        return contours;
+    }
+}
@@ -0,0 +1,141 @@
+//--------------------------------------------------------------------------------------------------
+// Memoization of the preprocessing steps shared by several algorithms (gray conversion,
+// Otsu binary image, Canny edges, contours and objects such as the scale space) so the same
+// image is not processed again
+// author: Daniel Vasconcelos Gomes 2023
+// if an external code has been used I indicate the sources
+//--------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "image_util.h"
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace preprocess
+{
+	using ContourList = std::vector<std::vector<Point> >;
+
+	/*
+	*	LRU cache of preprocessing results. An entry is keyed by the identity
+	*	of the source image (data pointer, size, type, step and a hash of
+	*	all its bytes, so an image changed in place is not mistaken for the
+	*	cached one, short of a 64 bit collision) plus the operation and its
+	*	parameters. The hash reads the whole image, by bands of rows in
+	*	parallel, so every public call computes the key once and passes it to
+	*	the nested steps (otsuContours -> otsu -> gray, the gradient of canny
+	*	-> gray): the keyed overloads are for callers that already hold the
+	*	key of img. Every entry keeps a reference to its source, so the
+	*	buffer address cannot be reused by another image while the entry
+	*	exists.
+	*
+	*	The returned Mats are shared with the cache and must not be modified.
+	*/
+	class CPreprocessCache final
+	{
+	public:
+
+		explicit CPreprocessCache(size_t max_entries = 32, size_t max_bytes = size_t(256) << 20)
+			:max_entries(max_entries), max_bytes(max_bytes) {};
+
+		struct SourceKey
+		{
+			const uchar* data = nullptr;
+			int rows = 0;
+			int cols = 0;
+			int type = 0;
+			size_t step = 0;
+			uint64_t hash = 0;
+
+			bool operator==(const SourceKey& rhs) const
+			{
+				return	data == rhs.data && rows == rhs.rows && cols == rhs.cols &&
+						type == rhs.type && step == rhs.step && hash == rhs.hash;
+			}
+		};
+
+		// identity of img, reads every byte
+		static SourceKey getSourceKey(const Mat& img);
+
+		// gray version of img (img itself when it is already gray)
+		Mat gray(const Mat& img);
+		Mat gray(const Mat& img, const SourceKey& key);
+
+		// THRESH_BINARY | THRESH_OTSU of the gray image
+		Mat otsu(const Mat& img);
+		Mat otsu(const Mat& img, const SourceKey& key);
+
+		// Canny of the gray image, blurred first with a blur_size box when > 0
+		Mat canny(const Mat& img, double threshold1, double threshold2, int blur_size = 0);
+		Mat canny(const Mat& img, const SourceKey& key, double threshold1, double threshold2, int blur_size = 0);
+
+		// contours of the Otsu binary image
+		std::shared_ptr<const ContourList> otsuContours(const Mat& img, int mode, int method);
+		std::shared_ptr<const ContourList> otsuContours(const Mat& img, const SourceKey& key, int mode, int method);
+
+		/*
+		*	Any object built from img by make(img), which returns a
+		*	std::shared_ptr<T>; bytes is its size for the memory bound.
+		*	The first caller builds it, the others share it. The second
+		*	form takes the key of img when the caller already has it.
+		*/
+		template<typename T, typename F>
+		std::shared_ptr<T> object(const Mat& img, const std::string& operation, size_t bytes, F make)
+		{
+			return object<T>(img, getSourceKey(img), operation, bytes, make);
+		}
+
+		template<typename T, typename F>
+		std::shared_ptr<T> object(const Mat& img, const SourceKey& key, const std::string& operation, size_t bytes, F make)
+		{
+			Entry entry;
+			if (find(key, operation, entry))
+			{
+				return std::static_pointer_cast<T>(entry.object);
+			}
+
+			std::shared_ptr<T> result = make(img);
+			entry.source = key;
+			entry.operation = operation;
+			entry.keep_source = img;
+			entry.object = result;
+			entry.bytes = bytes + img.total() * img.elemSize();
+
+			insert(std::move(entry));
+			return result;
+		}
+
+		void clear();
+
+	private:
+		CPreprocessCache(CPreprocessCache&) = delete;
+		CPreprocessCache& operator=(CPreprocessCache&) = delete;
+
+		struct Entry
+		{
+			SourceKey source;
+			std::string operation;
+			Mat keep_source;
+			Mat image;
+			std::shared_ptr<const ContourList> contours;
+			std::shared_ptr<void> object;
+			size_t bytes = 0;
+		};
+
+		bool find(const SourceKey& key, const std::string& operation, Entry& out);
+		void insert(Entry&& entry);
+
+		size_t max_entries;
+		size_t max_bytes;
+		size_t used_bytes = 0;
+		std::list<Entry> entries;
+		std::mutex lock;
+	};
+
+	/*
+	*	Cache shared by the algorithms of the program
+	*/
+	CPreprocessCache& cache();
+}
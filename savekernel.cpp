@@ -1,4 +1,5 @@
 #include "savekernel.h"
+#include "descriptor_io.h"
 
 std::string writeLine(std::vector<double> vec)
 {
@@ -75,20 +76,21 @@ bool SaveDataToFile(std::string fname, wxGrid* grid)
 	return true;
 }
 
-bool LoadDataFromFile(std::vector<std::vector<double>> obs, wxGrid* grid)
+bool LoadDataFromFile(const std::vector<double>& values, int nfields, wxGrid* grid)
 {
-    // grid->SetCellValue(3, 3, "green on grey");
-    int i = 0;
-
-    for (auto it = obs.begin(); it != obs.end(); it++,i++)
+    if (nfields <= 0)
     {
-        std::vector<double> tmp = *it;
+        return false;
+    }
 
-        for (int j = 0; j < tmp.size(); j++)
+    const size_t rows = values.size() / nfields;
+    for (size_t i = 0; i < rows; i++)
+    {
+        for (int j = 0; j < nfields; j++)
         {
             std::stringstream os;
-            os << obs[i][j];
-            grid->SetCellValue(i,j, os.str());
+            os << values[i * nfields + j];
+            grid->SetCellValue(static_cast<int>(i), j, os.str());
         }
     }
 
@@ -96,66 +98,17 @@ bool LoadDataFromFile(std::vector<std::vector<double>> obs, wxGrid* grid)
 }
 
 
-int readCSV(std::vector<std::vector<double>>& obs, std::string filename)
+int readCSV(std::vector<double>& values, int& nfields, std::string filename)
 {
-    std::ifstream myFile;
-    myFile.open(filename, std::ios_base::in);
-    bool ignoreheader = true;
-    int nfields = 0;
-
-    if (myFile.is_open())
-    {
-        while (myFile.good())
-        {
-
-            std::string Line;
-            getline(myFile, Line);
-
-            if (ignoreheader == true)
-            {
-                int start = 0;
-                int pos = static_cast<int>(Line.find(',', start));
-                std::string tmp = Line.substr(start, pos - start);
-                start = pos + 1;
-                nfields = stoi(tmp);
-                ignoreheader = false;
-                continue;
-            }
-
-            if (Line.length() == 0)
-            {
-                break;
-            }
-            int pos = 0;
-            int start = 0;
-            std::vector<double> ob;
-            int cnt = 0;
-            while (pos != -1)
-            {
-                if (cnt < nfields)
-                {
-                    pos = static_cast<int>(Line.find(',', start));
-                    std::string tmp = Line.substr(start, pos - start);
-                    start = pos + 1;
-                    double f = stof(tmp);
-                    ob.push_back(f);
-                    cnt++;
-                }
-                else
-                {
-                    break;
-                }
-            }
-
-            obs.push_back(ob);
-        }
-        myFile.close();
-    }
-    else
+    descriptor_io::CCsvParser parser;
+    if (!parser.openWithFieldsHeader(filename))
     {
         return -1;
     }
 
+    // row major, straight from the parser
+    parser.parse(values);
+    nfields = parser.fields();
     return 0;
 };
 
@@ -12,8 +12,9 @@
 
 
 bool SaveDataToFile(std::string, wxGrid* grid);
-bool LoadDataFromFile(std::vector<std::vector<double>> obs, wxGrid* grid);
-int readCSV(std::vector<std::vector<double>>& obs, std::string filename);
+// values are row major, nfields per row
+bool LoadDataFromFile(const std::vector<double>& values, int nfields, wxGrid* grid);
+int readCSV(std::vector<double>& values, int& nfields, std::string filename);
 std::vector<double>& getcol(const std::vector<std::vector<double>>& obs, std::vector<double>& vec, int col);
 std::string writeLine(std::vector<double>);
 
@@ -0,0 +1,285 @@
+#include "scale_space.h"
+#include "gaussian.h"
+#include "preprocess_cache.h"
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+namespace scale_space
+{
+    // blur of the source assumed by the first level
+    constexpr double source_sigma = 0.5;
+
+    // smallest side of the last octave
+    constexpr int min_octave_side = 8;
+
+    /*
+    *   Bilinear scaling where pixel x of src is pixel x * factor of the
+    *   result, the grid of the octaves (taken every second pixel), rather
+    *   than the pixel centers of resize
+    */
+    Mat rescale(const Mat& src, double factor, Size size)
+    {
+        const Matx23d to_src(1.0 / factor, 0, 0, 0, 1.0 / factor, 0);
+        Mat out;
+        warpAffine(src, out, to_src, size, INTER_LINEAR | WARP_INVERSE_MAP, BORDER_REPLICATE);
+        return out;
+    }
+
+    CScaleSpace::CScaleSpace(const Mat& img, int scales, double sigma0, int octaves, bool upsample)
+        :n_scales(std::max(1, scales)), first_octave(upsample ? -1 : 0), sigma0(sigma0)
+    {
+        const double scale = (img.depth() == CV_8U) ? 1.0 / 255.0 : 1.0;
+        img.convertTo(source, CV_32F, scale);
+
+        int side = std::min(img.rows, img.cols) * (upsample ? 2 : 1);
+        int fit = 1;
+        while (side / 2 >= min_octave_side)
+        {
+            side /= 2;
+            fit++;
+        }
+        n_octaves = (octaves > 0) ? std::min(octaves, fit) : fit;
+
+        levels.assign(n_octaves, std::vector<Mat>(n_scales + 3));
+        dogs.assign(n_octaves, std::vector<Mat>(n_scales + 2));
+    }
+
+    double CScaleSpace::sigma(int octave, int level) const
+    {
+        return sigma0 * std::pow(2.0, octave + first_octave + static_cast<double>(level) / n_scales);
+    }
+
+    double CScaleSpace::pixelSize(int octave) const
+    {
+        return std::pow(2.0, octave + first_octave);
+    }
+
+    void CScaleSpace::buildGaussian(int octave, int level)
+    {
+        if (levels[octave][level].empty() == false)
+        {
+            return;
+        }
+
+        Mat& out = levels[octave][level];
+        if (level == 0 && octave == 0)
+        {
+            // from the assumed blur of the source to sigma0, in the pixels of octave 0
+            Mat base = source;
+            double blur = source_sigma;
+            if (first_octave < 0)
+            {
+                base = rescale(source, 2, Size(source.cols * 2, source.rows * 2));
+                blur *= 2;
+            }
+            const double first = std::sqrt(std::max(0.01, sigma0 * sigma0 - blur * blur));
+            gaussian::blur(base, out, first);
+            return;
+        }
+
+        if (level == 0)
+        {
+            buildGaussian(octave - 1, n_scales);
+            const Mat& previous = levels[octave - 1][n_scales];
+            resize(previous, out, Size(previous.cols / 2, previous.rows / 2), 0, 0, INTER_NEAREST);
+            return;
+        }
+
+        buildGaussian(octave, level - 1);
+        const double k = std::pow(2.0, 1.0 / n_scales);
+        const double increment = sigma0 * std::sqrt(std::pow(k, 2.0 * level) - std::pow(k, 2.0 * (level - 1)));
+        gaussian::blur(levels[octave][level - 1], out, increment);
+    }
+
+    void CScaleSpace::buildDog(int octave, int level)
+    {
+        if (dogs[octave][level].empty() == false)
+        {
+            return;
+        }
+        buildGaussian(octave, level + 1);
+        subtract(levels[octave][level + 1], levels[octave][level], dogs[octave][level]);
+    }
+
+    const Mat& CScaleSpace::gaussian(int octave, int level)
+    {
+        std::lock_guard<std::recursive_mutex> guard(lock);
+        buildGaussian(octave, level);
+        return levels[octave][level];
+    }
+
+    const Mat& CScaleSpace::dog(int octave, int level)
+    {
+        std::lock_guard<std::recursive_mutex> guard(lock);
+        buildDog(octave, level);
+        return dogs[octave][level];
+    }
+
+    Mat CScaleSpace::log(int octave, int level)
+    {
+        const double k = std::pow(2.0, 1.0 / n_scales);
+        Mat out;
+        dog(octave, level).convertTo(out, CV_32F, 1.0 / (k - 1));
+        return out;
+    }
+
+    Mat CScaleSpace::blurAt(double s)
+    {
+        if (s <= source_sigma)
+        {
+            return source.clone();
+        }
+        if (s < sigma(0, 0))
+        {
+            Mat out;
+            gaussian::blur(source, out, std::sqrt(s * s - source_sigma * source_sigma));
+            return out;
+        }
+
+        // highest level not above s, the last levels of an octave are also level 0 .. 2 of the next
+        int octave = 0;
+        int level = 0;
+        for (int o = 0; o < n_octaves; o++)
+        {
+            for (int l = 0; l <= n_scales + 2; l++)
+            {
+                if (sigma(o, l) <= s)
+                {
+                    octave = o;
+                    level = l;
+                }
+            }
+        }
+
+        Mat out;
+        const double rest = std::sqrt(std::max(0.0, s * s - sigma(octave, level) * sigma(octave, level)));
+        const Mat& nearest = gaussian(octave, level);
+        if (rest > 0)
+        {
+            gaussian::blur(nearest, out, rest / pixelSize(octave));
+        }
+        else
+        {
+            out = nearest.clone();
+        }
+
+        if (out.size() != source.size())
+        {
+            return rescale(out, pixelSize(octave), source.size());
+        }
+        return out;
+    }
+
+    std::vector<KeyPoint> CScaleSpace::detectBlobs(double contrast, double edge_ratio)
+    {
+        std::vector<KeyPoint> blobs;
+        if (source.channels() != 1)
+        {
+            return blobs;
+        }
+
+        const float threshold = static_cast<float>(contrast / n_scales);
+        const double edge = (edge_ratio + 1) * (edge_ratio + 1) / edge_ratio;
+        std::mutex mtex;
+
+        for (int o = 0; o < n_octaves; o++)
+        {
+            for (int l = 1; l <= n_scales; l++)
+            {
+                const Mat& below = dog(o, l - 1);
+                const Mat& center = dog(o, l);
+                const Mat& above = dog(o, l + 1);
+                const double size = 2 * sigma(o, l);
+                const double to_source = pixelSize(o);
+
+                cv::parallel_for_(cv::Range(1, std::max(1, center.rows - 1)), [&](const cv::Range& range)
+                {
+                    std::vector<KeyPoint> found;
+                    for (int y = range.start; y < range.end; y++)
+                    {
+                        const float* rows[3][3];
+                        for (int d = -1; d <= 1; d++)
+                        {
+                            rows[0][d + 1] = below.ptr<float>(y + d);
+                            rows[1][d + 1] = center.ptr<float>(y + d);
+                            rows[2][d + 1] = above.ptr<float>(y + d);
+                        }
+                        const float* c = rows[1][1];
+
+                        for (int x = 1; x < center.cols - 1; x++)
+                        {
+                            const float v = c[x];
+                            if (std::abs(v) <= threshold)
+                            {
+                                continue;
+                            }
+
+                            bool extremum = true;
+                            for (int s = 0; s < 3 && extremum; s++)
+                            {
+                                for (int d = 0; d < 3 && extremum; d++)
+                                {
+                                    for (int dx = -1; dx <= 1; dx++)
+                                    {
+                                        if (s == 1 && d == 1 && dx == 0)
+                                        {
+                                            continue;
+                                        }
+                                        const float n = rows[s][d][x + dx];
+                                        if ((v > 0 && n >= v) || (v < 0 && n <= v))
+                                        {
+                                            extremum = false;
+                                            break;
+                                        }
+                                    }
+                                }
+                            }
+                            if (extremum == false)
+                            {
+                                continue;
+                            }
+
+                            // 2x2 Hessian of the DoG, an edge has one large principal curvature
+                            const double dxx = c[x + 1] + c[x - 1] - 2.0 * v;
+                            const double dyy = rows[1][2][x] + rows[1][0][x] - 2.0 * v;
+                            const double dxy = (rows[1][2][x + 1] - rows[1][2][x - 1] -
+                                                rows[1][0][x + 1] + rows[1][0][x - 1]) * 0.25;
+                            const double trace = dxx + dyy;
+                            const double det = dxx * dyy - dxy * dxy;
+                            if (det <= 0 || trace * trace >= edge * det)
+                            {
+                                continue;
+                            }
+
+                            found.emplace_back( Point2f(static_cast<float>(x * to_source),
+                                                        static_cast<float>(y * to_source)),
+                                                static_cast<float>(size),
+                                                -1.0f,
+                                                std::abs(v),
+                                                o);
+                        }
+                    }
+
+                    std::lock_guard<std::mutex> guard(mtex);
+                    blobs.insert(blobs.end(), found.begin(), found.end());
+                });
+            }
+        }
+
+        return blobs;
+    }
+
+    std::shared_ptr<CScaleSpace> get(const Mat& img, int scales, double sigma0)
+    {
+        const std::string operation = "scale_space:" + std::to_string(scales) + ":" + std::to_string(sigma0);
+
+        // the levels of all the octaves add up to about 4/3 of the first one
+        const size_t bytes = img.total() * img.channels() * sizeof(float) * (2 * scales + 5) * 4 / 3;
+
+        return preprocess::cache().object<CScaleSpace>(img, operation, bytes, [=](const Mat& src)
+        {
+            return std::make_shared<CScaleSpace>(src, scales, sigma0);
+        });
+    }
+}
@@ -0,0 +1,105 @@
+//--------------------------------------------------------------------------------------------------
+// Gaussian scale space of an image: octaves of levels blurred one from the other with small
+// incremental sigmas, their differences (DoG), the normalized Laplacian and blob detection,
+// built once per image and shared by the algorithms that need it
+// D.G. Lowe, "Distinctive image features from scale-invariant keypoints", IJCV 60 (2004)
+// T. Lindeberg, "Feature detection with automatic scale selection", IJCV 30 (1998)
+// author: Daniel Vasconcelos Gomes 2023
+// if an external code has been used I indicate the sources
+//--------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "image_util.h"
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace scale_space
+{
+	/*
+	*	Octave o holds scales + 3 Gaussian levels at half the resolution of
+	*	octave o - 1. Level l has sigma = sigma0 * 2^(o + l / scales) in pixels
+	*	of the source image, so l = 0 .. scales + 2 cover one octave plus the
+	*	levels needed by the DoG extrema. Level 0 of an octave is level scales
+	*	of the previous one (twice its sigma) taken every second pixel, every
+	*	other level is blurred from the level below by
+	*	sigma0 * sqrt(k^(2l) - k^(2(l - 1))), k = 2^(1 / scales), in the
+	*	pixels of the octave, instead of blurring the source by the whole sigma.
+	*
+	*	The levels are CV_32F (values of 8 bit images divided by 255) with the
+	*	channels of the source, and are built on demand: a query builds the
+	*	levels it needs and keeps them. The queries can be called from several
+	*	threads and the returned references stay valid while the object exists.
+	*/
+	class CScaleSpace final
+	{
+	public:
+
+		/*
+		*	octaves = 0 takes as many as the smaller side allows (down to about
+		*	8 pixels). The source is assumed to have a blur of 0.5; upsample
+		*	doubles it first (octave 0 at twice the resolution), which finds
+		*	the smallest blobs.
+		*/
+		explicit CScaleSpace(const Mat& img, int scales = 3, double sigma0 = 1.6, int octaves = 0, bool upsample = false);
+
+		int octaves() const { return n_octaves; };
+		int scales() const { return n_scales; };
+
+		// sigma of a level, in pixels of the source image
+		double sigma(int octave, int level) const;
+
+		// size of the pixels of an octave, in pixels of the source image
+		double pixelSize(int octave) const;
+
+		// Gaussian level, 0 <= level < scales + 3
+		const Mat& gaussian(int octave, int level);
+
+		// gaussian(octave, level + 1) - gaussian(octave, level), 0 <= level < scales + 2
+		const Mat& dog(int octave, int level);
+
+		/*
+		*	Scale normalized Laplacian sigma^2 * LoG at the level, from the DoG:
+		*	DoG = (k - 1) * sigma^2 * LoG
+		*/
+		Mat log(int octave, int level);
+
+		/*
+		*	The source blurred by sigma at its resolution: the nearest level
+		*	below sigma blurred by the rest and scaled up, for large sigmas at
+		*	the cost of a small image
+		*/
+		Mat blurAt(double sigma);
+
+		/*
+		*	Extrema of the DoG over their 26 neighbours in space and scale,
+		*	with |DoG| > contrast / scales and a ratio of principal curvatures
+		*	below edge_ratio (the edges are rejected). Points in the coordinates
+		*	of the source, size = 2 sigma, response = |DoG|, octave = o.
+		*	Single channel scale spaces only (none otherwise).
+		*/
+		std::vector<KeyPoint> detectBlobs(double contrast = 0.04, double edge_ratio = 10);
+
+	private:
+
+		void buildGaussian(int octave, int level);
+		void buildDog(int octave, int level);
+
+		Mat source;			// CV_32F, resolution of the image
+		int n_scales;
+		int n_octaves;
+		int first_octave;	// -1 when upsampled
+		double sigma0;
+
+		std::vector<std::vector<Mat> > levels;
+		std::vector<std::vector<Mat> > dogs;
+		std::recursive_mutex lock;
+	};
+
+	/*
+	*	Scale space of img shared through the preprocessing cache: every
+	*	algorithm that asks for the same image and parameters gets the same
+	*	object and the levels already built
+	*/
+	std::shared_ptr<CScaleSpace> get(const Mat& img, int scales = 3, double sigma0 = 1.6);
+}
@@ -0,0 +1,359 @@
+#include "shape_retrieval.h"
+#include "descriptor_io.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
+
+namespace shape_retrieval
+{
+    using ResultHeap = std::priority_queue<std::pair<double, int>>;
+
+    // weighted L1 or L-infinity distance over the stride values of one shape
+    inline double shapeDistance(    const float* q,
+                                    const float* w,
+                                    const float* x,
+                                    const float* v,
+                                    bool linf)
+    {
+        float d = 0;
+        if (linf)
+        {
+            for (int i = 0; i < 8; i++)
+            {
+                d = std::max(d, w[i] * v[i] * std::abs(q[i] - x[i]));
+            }
+        }
+        else
+        {
+            for (int i = 0; i < 8; i++)
+            {
+                d += w[i] * v[i] * std::abs(q[i] - x[i]);
+            }
+        }
+        return d;
+    }
+
+    void pushResult(ResultHeap& heap, int k, double d, int i)
+    {
+        if (static_cast<int>(heap.size()) < k)
+        {
+            heap.emplace(d, i);
+        }
+        else if (d < heap.top().first)
+        {
+            heap.pop();
+            heap.emplace(d, i);
+        }
+    }
+
+    std::vector<ShapeMatch> sortedResults(ResultHeap& heap)
+    {
+        std::vector<ShapeMatch> out(heap.size());
+        for (size_t i = out.size(); i > 0; i--)
+        {
+            out[i - 1] = ShapeMatch(heap.top().second, heap.top().first);
+            heap.pop();
+        }
+        return out;
+    }
+
+    void CHuShapeIndex::clear()
+    {
+        count = 0;
+        images.clear();
+        logs = Space();
+        reciprocals = Space();
+        log_tree = Tree();
+        reciprocal_tree = Tree();
+    }
+
+    void CHuShapeIndex::add(const double* huh)
+    {
+        for (int i = 0; i < stride; i++)
+        {
+            const double m = (i < dims) ? huh[i] : 0.0;
+            const bool ok = i < dims && std::isfinite(m);
+            logs.values.push_back(ok ? static_cast<float>(m) : 0.0f);
+            logs.valid.push_back(ok ? 1.0f : 0.0f);
+
+            const bool rok = ok && m != 0;
+            reciprocals.values.push_back(rok ? static_cast<float>(1.0 / m) : 0.0f);
+            reciprocals.valid.push_back(rok ? 1.0f : 0.0f);
+        }
+        count++;
+
+        log_tree.built = false;
+        reciprocal_tree.built = false;
+    }
+
+    int CHuShapeIndex::toImage(double v)
+    {
+        return (std::isfinite(v) && v >= 0 && v <= std::numeric_limits<int>::max()) ? static_cast<int>(v) : -1;
+    }
+
+    int CHuShapeIndex::image(int row) const
+    {
+        return (row >= 0 && static_cast<size_t>(row) < images.size()) ? images[row] : -1;
+    }
+
+    bool CHuShapeIndex::load(const std::string& path)
+    {
+        clear();
+
+        if (descriptor_io::isBinaryFile(path))
+        {
+            descriptor_io::CColumnarReader reader;
+            if (reader.open(path) == false)
+            {
+                return false;
+            }
+
+            const double* columns[dims];
+            for (int c = 0; c < dims; c++)
+            {
+                columns[c] = reader.column<double>(reader.findColumn("h" + std::to_string(c + 1)));
+                if (columns[c] == nullptr)
+                {
+                    return false;
+                }
+            }
+
+            // files written before the image column have none
+            const double* image = reader.column<double>(reader.findColumn("image"));
+            double huh[dims];
+            for (uint64_t r = 0; r < reader.rows(); r++)
+            {
+                for (int c = 0; c < dims; c++)
+                {
+                    huh[c] = columns[c][r];
+                }
+                add(huh);
+                images.push_back((image != nullptr) ? toImage(image[r]) : -1);
+            }
+            return true;
+        }
+
+        descriptor_io::CCsvParser parser;
+        // h1..h7 and the image, NaN when the file has no image column
+        const int fields = dims + 1;
+        if (parser.open(path, fields, false) == false)
+        {
+            return false;
+        }
+
+        std::vector<double> values;
+        parser.parse(values);
+        logs.values.reserve(parser.rows() * stride);
+        logs.valid.reserve(parser.rows() * stride);
+        reciprocals.values.reserve(parser.rows() * stride);
+        reciprocals.valid.reserve(parser.rows() * stride);
+        images.reserve(parser.rows());
+        for (size_t r = 0; r < parser.rows(); r++)
+        {
+            add(values.data() + r * fields);
+            images.push_back(toImage(values[r * fields + dims]));
+        }
+        return true;
+    }
+
+    std::vector<ShapeMatch> CHuShapeIndex::search(const double* huh, int k, int method) const
+    {
+        if (count == 0 || k <= 0)
+        {
+            return std::vector<ShapeMatch>();
+        }
+
+        const bool reciprocal = (method == CONTOURS_MATCH_I1);
+        const bool linf = (method == CONTOURS_MATCH_I3);
+        const Space& space = reciprocal ? reciprocals : logs;
+
+        // query in the same space, invalid moments get weight 0
+        float q[stride] = { 0 };
+        float w[stride] = { 0 };
+        for (int i = 0; i < dims; i++)
+        {
+            const double m = huh[i];
+            if (std::isfinite(m) == false || (m == 0 && (reciprocal || linf)))
+            {
+                continue;
+            }
+            q[i] = static_cast<float>(reciprocal ? 1.0 / m : m);
+            w[i] = static_cast<float>(linf ? 1.0 / std::abs(m) : 1.0);
+        }
+
+        if (count <= brute_force_limit)
+        {
+            return bruteForce(space, q, w, linf, k);
+        }
+
+        Tree& tree = reciprocal ? reciprocal_tree : log_tree;
+        if (tree.built == false)
+        {
+            buildTree(space, tree);
+        }
+        return treeSearch(space, tree, q, w, linf, k);
+    }
+
+    std::vector<ShapeMatch> CHuShapeIndex::bruteForce(  const Space& space,
+                                                        const float* q,
+                                                        const float* w,
+                                                        bool linf,
+                                                        int k) const
+    {
+        std::vector<float> distances(count);
+        cv::parallel_for_(cv::Range(0, static_cast<int>(count)), [&](const cv::Range& range)
+        {
+            for (int i = range.start; i < range.end; i++)
+            {
+                distances[i] = static_cast<float>(shapeDistance(q,
+                                                                w,
+                                                                space.values.data() + i * stride,
+                                                                space.valid.data() + i * stride,
+                                                                linf));
+            }
+        });
+
+        ResultHeap heap;
+        for (int i = 0; i < static_cast<int>(count); i++)
+        {
+            pushResult(heap, k, distances[i], i);
+        }
+        return sortedResults(heap);
+    }
+
+    void CHuShapeIndex::buildTree(const Space& space, Tree& tree) const
+    {
+        tree = Tree();
+
+        // rows with skipped moments have no position in the 7-D space
+        for (int i = 0; i < static_cast<int>(count); i++)
+        {
+            const float* v = space.valid.data() + i * stride;
+            if (std::count(v, v + dims, 1.0f) == dims)
+            {
+                tree.order.push_back(i);
+            }
+            else
+            {
+                tree.partial.push_back(i);
+            }
+        }
+
+        if (tree.order.empty() == false)
+        {
+            tree.nodes.reserve(2 * tree.order.size() / leaf_size + 1);
+            buildNode(space, tree, 0, static_cast<int>(tree.order.size()));
+        }
+        tree.built = true;
+    }
+
+    int CHuShapeIndex::buildNode(const Space& space, Tree& tree, int begin, int end) const
+    {
+        const int id = static_cast<int>(tree.nodes.size());
+        tree.nodes.push_back(Node{ begin, end, -1, 0.0f, -1, -1 });
+
+        if (end - begin <= leaf_size)
+        {
+            return id;
+        }
+
+        // split on the dimension of largest spread, at the median
+        int best = 0;
+        float spread = -1;
+        for (int d = 0; d < dims; d++)
+        {
+            float lo = std::numeric_limits<float>::max();
+            float hi = std::numeric_limits<float>::lowest();
+            for (int k = begin; k < end; k++)
+            {
+                const float x = space.values[tree.order[k] * stride + d];
+                lo = std::min(lo, x);
+                hi = std::max(hi, x);
+            }
+            if (hi - lo > spread)
+            {
+                spread = hi - lo;
+                best = d;
+            }
+        }
+
+        const int mid = begin + (end - begin) / 2;
+        std::nth_element(tree.order.begin() + begin, tree.order.begin() + mid, tree.order.begin() + end,
+            [&](int a, int b)
+            {
+                return space.values[a * stride + best] < space.values[b * stride + best];
+            });
+
+        const float split = space.values[tree.order[mid] * stride + best];
+        const int left = buildNode(space, tree, begin, mid);
+        const int right = buildNode(space, tree, mid, end);
+
+        Node& node = tree.nodes[id];
+        node.split_dim = best;
+        node.split = split;
+        node.left = left;
+        node.right = right;
+        return id;
+    }
+
+    std::vector<ShapeMatch> CHuShapeIndex::treeSearch(  const Space& space,
+                                                        const Tree& tree,
+                                                        const float* q,
+                                                        const float* w,
+                                                        bool linf,
+                                                        int k) const
+    {
+        ResultHeap heap;
+
+        for (int i : tree.partial)
+        {
+            pushResult(heap, k, shapeDistance(q, w, space.values.data() + i * stride, space.valid.data() + i * stride, linf), i);
+        }
+
+        if (tree.nodes.empty() == false)
+        {
+            // w_d |q_d - split| is a lower bound for both L1 and L-infinity
+            std::vector<int> stack;
+            std::vector<float> bounds;
+            stack.push_back(0);
+            bounds.push_back(0.0f);
+
+            while (stack.empty() == false)
+            {
+                const Node& node = tree.nodes[stack.back()];
+                const float bound = bounds.back();
+                stack.pop_back();
+                bounds.pop_back();
+
+                if (static_cast<int>(heap.size()) == k && bound >= heap.top().first)
+                {
+                    continue;
+                }
+
+                if (node.split_dim < 0)
+                {
+                    for (int j = node.begin; j < node.end; j++)
+                    {
+                        const int i = tree.order[j];
+                        pushResult(heap, k, shapeDistance(q, w, space.values.data() + i * stride, space.valid.data() + i * stride, linf), i);
+                    }
+                    continue;
+                }
+
+                const float diff = q[node.split_dim] - node.split;
+                const float far_bound = std::max(bound, w[node.split_dim] * std::abs(diff));
+                const int near_node = (diff < 0) ? node.left : node.right;
+                const int far_node = (diff < 0) ? node.right : node.left;
+
+                // the near child is popped first
+                stack.push_back(far_node);
+                bounds.push_back(far_bound);
+                stack.push_back(near_node);
+                bounds.push_back(bound);
+            }
+        }
+
+        return sortedResults(heap);
+    }
+}
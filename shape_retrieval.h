@@ -0,0 +1,124 @@
+//--------------------------------------------------------------------------------------------------
+// Shape retrieval over Hu moments descriptor files (descriptors.csv or .dvgc)
+// The distances are the ones of cv::matchShapes (CONTOURS_MATCH_I1, I2, I3)
+// https://docs.opencv.org/4.8.0/d3/dc0/group__imgproc__shape.html#gaadc90cb16e2362c9bd6e7363e6e4c317
+// author: Daniel Vasconcelos Gomes 2023
+// if an external code has been used I indicate the sources
+//--------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "opcvwrapper.h"
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace shape_retrieval
+{
+	/*
+	*	index, distance
+	*/
+	using ShapeMatch = std::pair<int, double>;
+
+	/*
+	*	Index of log scaled Hu moments (the values written by
+	*	image_info::getHuhMoments, -sign(h) log10|h|). matchShapes uses
+	*	m = sign(h) log10|h|, the sign flip does not change any of the
+	*	three distances:
+	*
+	*		I1 = sum |1/mA - 1/mB|		L1 in the space of the reciprocals
+	*		I2 = sum |mA - mB|			L1
+	*		I3 = max |mA - mB| / |mA|	L-infinity weighted by the query
+	*
+	*	Moments that are not finite (h == 0) are skipped, like matchShapes
+	*	does with the tiny ones. The moments are kept in compact float
+	*	arrays of 8 values per shape. Up to brute_force_limit shapes the
+	*	search is a plain scan, above that a 7-D k-d tree is built (once per
+	*	space) and rows with skipped moments are scanned on the side.
+	*/
+	class CHuShapeIndex final
+	{
+	public:
+
+		static constexpr size_t brute_force_limit = 4096;
+
+		CHuShapeIndex() = default;
+
+		/*
+		*	csv with 7 values per line or a columnar file with h1..h7,
+		*	the image column of createHuMomentsFile is read when present
+		*/
+		bool load(const std::string& path);
+
+		// image index of a loaded row, -1 if unknown
+		int image(int row) const;
+
+		void add(const double* huh);
+		void clear();
+		size_t size() const { return count; };
+
+		/*
+		*	k nearest shapes to huh using the distance of method
+		*	(CONTOURS_MATCH_I1, CONTOURS_MATCH_I2 or CONTOURS_MATCH_I3),
+		*	nearest first
+		*/
+		std::vector<ShapeMatch> search(const double* huh, int k, int method = CONTOURS_MATCH_I2) const;
+
+	private:
+		CHuShapeIndex(CHuShapeIndex&) = delete;
+		CHuShapeIndex& operator=(CHuShapeIndex&) = delete;
+
+		static constexpr int dims = 7;
+		static constexpr int stride = 8;
+		static constexpr int leaf_size = 16;
+
+		// values of one space, stride floats per shape and 1/0 validity weights
+		struct Space
+		{
+			std::vector<float> values;
+			std::vector<float> valid;
+		};
+
+		struct Node
+		{
+			int begin;
+			int end;
+			int split_dim;
+			float split;
+			int left;
+			int right;
+		};
+
+		struct Tree
+		{
+			bool built = false;
+			std::vector<int> order;
+			std::vector<Node> nodes;
+			std::vector<int> partial;
+		};
+
+		void buildTree(const Space& space, Tree& tree) const;
+		int buildNode(const Space& space, Tree& tree, int begin, int end) const;
+
+		std::vector<ShapeMatch> bruteForce(	const Space& space,
+											const float* q,
+											const float* w,
+											bool linf,
+											int k) const;
+
+		std::vector<ShapeMatch> treeSearch(	const Space& space,
+											const Tree& tree,
+											const float* q,
+											const float* w,
+											bool linf,
+											int k) const;
+
+		static int toImage(double v);
+
+		size_t count = 0;
+		std::vector<int> images;
+		Space logs;
+		Space reciprocals;
+		mutable Tree log_tree;
+		mutable Tree reciprocal_tree;
+	};
+}
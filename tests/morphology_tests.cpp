@@ -0,0 +1,153 @@
+#include "../morphology.h"
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*
+*   morphology::morphologyEx against cv::morphologyEx: every operation, the
+*   elements of the streamed path (rectangles and lines, odd and even sizes)
+*   and some of the composed one, several depths and channels, iterations
+*   above 1, images tall enough to be cut in several bands, in-place calls
+*   and a submatrix source. The results must be identical.
+*/
+
+namespace
+{
+    struct Case
+    {
+        morphology::Element element;
+        const char* name;
+    };
+
+    const std::vector<std::pair<morphology::Operation, int>> operations =
+    {
+        { morphology::Operation::Open, MORPH_OPEN },
+        { morphology::Operation::Close, MORPH_CLOSE },
+        { morphology::Operation::Gradient, MORPH_GRADIENT },
+        { morphology::Operation::TopHat, MORPH_TOPHAT },
+        { morphology::Operation::BlackHat, MORPH_BLACKHAT }
+    };
+
+    const char* operationName(morphology::Operation operation)
+    {
+        switch (operation)
+        {
+        case morphology::Operation::Open: return "Open";
+        case morphology::Operation::Close: return "Close";
+        case morphology::Operation::Gradient: return "Gradient";
+        case morphology::Operation::TopHat: return "TopHat";
+        default: return "BlackHat";
+        }
+    }
+
+    Mat randomImage(int rows, int cols, int type)
+    {
+        Mat img(rows, cols, type);
+        switch (CV_MAT_DEPTH(type))
+        {
+        case CV_8U: randu(img, Scalar::all(0), Scalar::all(256)); break;
+        case CV_16U: randu(img, Scalar::all(0), Scalar::all(65536)); break;
+        case CV_16S: randu(img, Scalar::all(-32768), Scalar::all(32768)); break;
+        default: randu(img, Scalar::all(-1000), Scalar::all(1000)); break;
+        }
+        return img;
+    }
+
+    bool identical(const Mat& a, const Mat& b)
+    {
+        return a.size() == b.size() && a.type() == b.type() && norm(a, b, NORM_INF) == 0;
+    }
+
+    int failures = 0;
+    int checks = 0;
+
+    void check(bool ok, const std::string& what)
+    {
+        checks++;
+        if (ok == false)
+        {
+            failures++;
+            std::cout << "FAILED " << what << std::endl;
+        }
+    }
+}
+
+int main()
+{
+    // several bands even on a machine with few cores
+    cv::setNumThreads(8);
+    cv::setRNGSeed(2023);
+
+    const std::vector<Case> cases =
+    {
+        { morphology::Element(morphology::Shape::Rect, Size(3, 3)), "rect 3x3" },
+        { morphology::Element(morphology::Shape::Rect, Size(7, 5)), "rect 7x5" },
+        { morphology::Element(morphology::Shape::Rect, Size(4, 6)), "rect 4x6" },
+        { morphology::Element(morphology::Shape::HorizontalLine, Size(9, 1)), "horizontal line 9" },
+        { morphology::Element(morphology::Shape::HorizontalLine, Size(8, 1)), "horizontal line 8" },
+        { morphology::Element(morphology::Shape::VerticalLine, Size(1, 11)), "vertical line 11" },
+        { morphology::Element(morphology::Shape::VerticalLine, Size(1, 6)), "vertical line 6" },
+        { morphology::Element(morphology::Shape::Cross, Size(5, 5)), "cross 5" },
+        { morphology::Element(morphology::Shape::Diamond, 5), "diamond 5" }
+    };
+
+    const std::vector<std::pair<int, const char*>> types =
+    {
+        { CV_8UC1, "8UC1" },
+        { CV_8UC3, "8UC3" },
+        { CV_16UC1, "16UC1" },
+        { CV_16SC1, "16SC1" },
+        { CV_32FC1, "32FC1" }
+    };
+
+    // 640 rows are cut in 8 bands of at least 64 rows for the small elements
+    const int rows = 640;
+    const int cols = 203;
+
+    for (const auto& type : types)
+    {
+        const Mat src = randomImage(rows, cols, type.first);
+        for (const Case& c : cases)
+        {
+            const Mat mask = morphology::getMask(c.element);
+            for (int iterations = 1; iterations <= 3; iterations++)
+            {
+                for (const auto& operation : operations)
+                {
+                    const std::string what =    std::string(operationName(operation.first)) + " " + c.name + " " +
+                                                type.second + " iterations " + std::to_string(iterations);
+
+                    Mat expected;
+                    cv::morphologyEx(src, expected, operation.second, mask, Point(-1, -1), iterations);
+
+                    Mat dst;
+                    morphology::morphologyEx(src, dst, operation.first, c.element, iterations);
+                    check(identical(dst, expected), what);
+
+                    Mat inplace = src.clone();
+                    morphology::morphologyEx(inplace, inplace, operation.first, c.element, iterations);
+                    check(identical(inplace, expected), what + " in place");
+                }
+            }
+        }
+    }
+
+    // a submatrix: rows that are not contiguous and values around the roi that must not be read
+    {
+        const Mat big = randomImage(rows + 40, cols + 30, CV_8UC1);
+        const Mat roi = big(Rect(13, 17, cols, rows));
+        const morphology::Element element(morphology::Shape::Rect, Size(5, 5));
+        for (const auto& operation : operations)
+        {
+            Mat expected;
+            cv::morphologyEx(roi, expected, operation.second, morphology::getMask(element), Point(-1, -1), 2);
+
+            Mat dst;
+            morphology::morphologyEx(roi, dst, operation.first, element, 2);
+            check(identical(dst, expected), std::string(operationName(operation.first)) + " submatrix");
+        }
+    }
+
+    std::cout << checks - failures << " of " << checks << " checks passed" << std::endl;
+    return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,210 @@
+#include "thresholding.h"
+#include "integral_image.h"
+#include "morphology.h"
+#include "preprocess_cache.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace thresholding
+{
+    /*
+    *   8 bit gray version of img. The gray image of the cache is kept as it
+    *   is, so its integral image is shared with the other algorithms.
+    */
+    Mat gray8(const Mat& img)
+    {
+        Mat gray = preprocess::cache().gray(img);
+        if (gray.depth() == CV_8U)
+        {
+            return gray;
+        }
+        Mat stretched;
+        normalize(gray, stretched, 0, 255, NORM_MINMAX, CV_8U);
+        return stretched;
+    }
+
+    Mat local(const Mat& img, Local method, int window, double k, double r)
+    {
+        if (img.empty())
+        {
+            return Mat();
+        }
+
+        const Mat gray = gray8(img);
+        const std::shared_ptr<const integral::CIntegralImage> table = integral::get(gray);
+        const Size size(std::max(1, window), std::max(1, window));
+        r = (r > 0) ? r : 128;
+
+        const int tiles_x = (gray.cols + tile_width - 1) / tile_width;
+        const int tiles_y = (gray.rows + tile_height - 1) / tile_height;
+        Mat dst(gray.size(), CV_8U);
+
+        cv::parallel_for_(cv::Range(0, tiles_x * tiles_y), [&](const cv::Range& range)
+        {
+            Mat mean;
+            Mat stddev;
+            for (int t = range.start; t < range.end; t++)
+            {
+                const Rect tile = Rect((t % tiles_x) * tile_width, (t / tiles_x) * tile_height, tile_width, tile_height) &
+                                  Rect(0, 0, gray.cols, gray.rows);
+                table->meanStdDev(mean, stddev, size, tile);
+
+                for (int i = 0; i < tile.height; i++)
+                {
+                    const uchar* p = gray.ptr<uchar>(tile.y + i) + tile.x;
+                    const float* m = mean.ptr<float>(i);
+                    const float* s = stddev.ptr<float>(i);
+                    uchar* out = dst.ptr<uchar>(tile.y + i) + tile.x;
+                    for (int j = 0; j < tile.width; j++)
+                    {
+                        double T = 0;
+                        switch (method)
+                        {
+                        case Local::Niblack: T = m[j] + k * s[j]; break;
+                        case Local::Sauvola: T = m[j] * (1 + k * (s[j] / r - 1)); break;
+                        default: T = m[j] * (1 - k); break;
+                        }
+                        out[j] = (p[j] > T) ? 255 : 0;
+                    }
+                }
+            }
+        });
+        return dst;
+    }
+
+    Mat niblack(const Mat& img, int window, double k)
+    {
+        return local(img, Local::Niblack, window, k);
+    }
+
+    Mat sauvola(const Mat& img, int window, double k, double r)
+    {
+        return local(img, Local::Sauvola, window, k, r);
+    }
+
+    Mat bradley(const Mat& img, int window, double k)
+    {
+        return local(img, Local::Bradley, window, k);
+    }
+
+    std::vector<int> multiOtsu(const Mat& img, int classes)
+    {
+        constexpr int levels = 256;
+        classes = std::max(2, std::min(max_classes, classes));
+        if (img.empty())
+        {
+            return std::vector<int>();
+        }
+
+        const Mat gray = gray8(img);
+        Mat hist;
+        const int channels[] = { 0 };
+        const int bins[] = { levels };
+        const float range[] = { 0, levels };
+        const float* ranges[] = { range };
+        calcHist(&gray, 1, channels, Mat(), hist, 1, bins, ranges);
+
+        // P[i] pixels and S[i] sum of the values of the bins [0, i)
+        std::vector<double> P(levels + 1, 0);
+        std::vector<double> S(levels + 1, 0);
+        for (int i = 0; i < levels; i++)
+        {
+            const double n = hist.at<float>(i);
+            P[i + 1] = P[i] + n;
+            S[i + 1] = S[i] + n * i;
+        }
+
+        /*
+        *   The variance between classes is the sum over the classes of
+        *   S^2 / P minus a constant, so it is additive: best[c][j] is the
+        *   best split of the bins [0, j) in c + 1 classes.
+        */
+        auto cost = [&](int a, int b)
+        {
+            const double n = P[b] - P[a];
+            const double s = S[b] - S[a];
+            return (n > 0) ? s * s / n : 0.0;
+        };
+
+        const double lowest = -std::numeric_limits<double>::infinity();
+        std::vector<std::vector<double>> best(classes, std::vector<double>(levels + 1, lowest));
+        std::vector<std::vector<int>> from(classes, std::vector<int>(levels + 1, 0));
+        for (int j = 1; j <= levels; j++)
+        {
+            best[0][j] = cost(0, j);
+        }
+        for (int c = 1; c < classes; c++)
+        {
+            for (int j = c + 1; j <= levels; j++)
+            {
+                for (int i = c; i < j; i++)
+                {
+                    const double v = best[c - 1][i] + cost(i, j);
+                    if (v > best[c][j])
+                    {
+                        best[c][j] = v;
+                        from[c][j] = i;
+                    }
+                }
+            }
+        }
+
+        // class c starts at bin from[c][end of class c]
+        std::vector<int> thresholds(classes - 1);
+        int end = levels;
+        for (int c = classes - 1; c > 0; c--)
+        {
+            end = from[c][end];
+            thresholds[c - 1] = end - 1;
+        }
+        return thresholds;
+    }
+
+    Mat quantize(const Mat& img, const std::vector<int>& thresholds)
+    {
+        if (img.empty())
+        {
+            return Mat();
+        }
+
+        const int classes = static_cast<int>(thresholds.size()) + 1;
+        Mat lut(1, 256, CV_8U);
+        int c = 0;
+        for (int v = 0; v < 256; v++)
+        {
+            while (c < classes - 1 && v > thresholds[c])
+            {
+                c++;
+            }
+            lut.at<uchar>(v) = (classes > 1) ? saturate_cast<uchar>(255.0 * c / (classes - 1)) : 0;
+        }
+
+        Mat dst;
+        LUT(gray8(img), lut, dst);
+        return dst;
+    }
+
+    Mat hysteresis(const Mat& img, double low, double high, int connectivity)
+    {
+        if (img.empty())
+        {
+            return Mat();
+        }
+        if (low > high)
+        {
+            std::swap(low, high);
+        }
+
+        const Mat gray = gray8(img);
+        Mat strong;
+        Mat weak;
+        compare(gray, high, strong, CMP_GE);
+        compare(gray, low, weak, CMP_GE);
+
+        // the weak pixels reached from the strong ones, a flood fill of the weak mask
+        Mat dst;
+        morphology::reconstructByDilation(strong, weak, dst, connectivity);
+        return dst;
+    }
+}
@@ -0,0 +1,70 @@
+//--------------------------------------------------------------------------------------------------
+// Thresholding engine: local thresholds from the shared integral image (Niblack, Sauvola,
+// Bradley), multi-level Otsu and hysteresis
+// W. Niblack, "An introduction to digital image processing", Prentice Hall (1986)
+// J. Sauvola, M. Pietikainen, "Adaptive document image binarization", Pattern Recognition 33 (2000)
+// D. Bradley, G. Roth, "Adaptive thresholding using the integral image", JGT 12 (2007)
+// P.S. Liao, T.S. Chen, P.C. Chung, "A fast algorithm for multilevel thresholding",
+// J. Inf. Sci. Eng. 17 (2001)
+// author: Daniel Vasconcelos Gomes 2023
+// if an external code has been used I indicate the sources
+//--------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "image_util.h"
+#include <vector>
+
+namespace thresholding
+{
+	// tiles of the local thresholds, processed in parallel
+	constexpr int tile_width = 256;
+	constexpr int tile_height = 64;
+
+	// most classes of multiOtsu
+	constexpr int max_classes = 8;
+
+	enum class Local
+	{
+		Niblack,	// T = m + k s, k ~ -0.2
+		Sauvola,	// T = m (1 + k (s / r - 1)), k ~ 0.34, r = 128
+		Bradley		// T = m (1 - k), k ~ 0.15
+	};
+
+	/*
+	*	All the functions work on the 8 bit gray version of img (from the
+	*	preprocessing cache, other depths are stretched to 0..255) and give
+	*	CV_8U images of 0 and 255.
+	*/
+
+	/*
+	*	Local threshold T of the window x window pixels around every pixel
+	*	(the mean m and standard deviation s come from the integral image
+	*	shared through the cache), pixels above T are 255. The image is
+	*	processed by tiles in parallel, each one holding the floats of its
+	*	own windows only. For scanned documents and uneven lighting.
+	*/
+	Mat local(const Mat& img, Local method, int window, double k, double r = 128);
+
+	Mat niblack(const Mat& img, int window, double k = -0.2);
+	Mat sauvola(const Mat& img, int window, double k = 0.34, double r = 128);
+	Mat bradley(const Mat& img, int window, double k = 0.15);
+
+	/*
+	*	classes - 1 thresholds maximizing the variance between the classes,
+	*	by dynamic programming on the histogram of the image: O(classes 256^2)
+	*	whatever the size of the image. The values <= thresholds[i] (and
+	*	above thresholds[i - 1]) are class i. classes = 2 is Otsu.
+	*/
+	std::vector<int> multiOtsu(const Mat& img, int classes);
+
+	/*
+	*	The classes of the thresholds as gray levels spread over 0..255
+	*/
+	Mat quantize(const Mat& img, const std::vector<int>& thresholds);
+
+	/*
+	*	Pixels >= high, and those >= low connected to them (through pixels
+	*	>= low), are 255, like the weak edges of Canny.
+	*/
+	Mat hysteresis(const Mat& img, double low, double high, int connectivity = 8);
+}